@@ -1,6 +1,7 @@
 #include "Acceptor.h"
 #include "Logger.h"
 #include "InetAddress.h"
+#include "EventLoop.h"
 
 #include <sys/types.h>         
 #include <sys/socket.h>
@@ -26,8 +27,22 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
     ,listenning_(false)
 {
     acceptSocket_.setReuseAddr(true);
-    acceptSocket_.setReusePort(true);
+    acceptSocket_.setReusePort(reuseport);
     acceptSocket_.bindAddress(listenAddr);// bind
+    init();
+}
+
+Acceptor::Acceptor(EventLoop *loop, int listenfd)
+    :loop_(loop)
+    ,acceptSocket_(listenfd)
+    ,acceptChannel_(loop,acceptSocket_.fd())
+    ,listenning_(false)
+{
+    init();
+}
+
+void Acceptor::init()
+{
     /**当我们TcpServer调用start方法时，就会启动Acceptor.listen()方法
      * 有新用户连接时，要执行一个回调，这个方法会将和用户连接的fd打包成Channel，wakeup subloop,
      * 然后交给subloop,下面就是注册包装了listenfd的Channel发生读事件后，需要执行的回调函数，
@@ -36,6 +51,7 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reusepor
    //在listenfd还没有发生事件的时候，我们就给他预先注册一个事件回调，当真正listenfd有客户端连接的话，
    //底层反应堆会帮我们调用这个回调，即event对应的事件处理器
     acceptChannel_.setReadCallBack(std::bind(&Acceptor::handleRead, this));
+    acceptChannel_.setWatchName("Acceptor");
 }
 
 Acceptor::~Acceptor()
@@ -56,23 +72,36 @@ void Acceptor::listen()
 }
 
 //listenfd有事件发生了，就是有新用户连接了
+//水平触发每次事件accept一个；边沿触发一直accept到EAGAIN，接满kAcceptBudget个就排到本轮末尾再接，不让连接风暴占住loop
 void Acceptor::handleRead()
 {
-    InetAddress peerAddr; //客户端地址
-    int connfd = acceptSocket_.accept(&peerAddr);
-    if(connfd >= 0)
+    const bool edge = acceptChannel_.edgeTriggered();
+    const int budget = edge ? kAcceptBudget : 1;
+    for(int i = 0; i < budget; ++i)
     {
-        if(newConnectionCallback_) // 轮询找到subloop，唤醒并分发当前新客户端connfd的Channel
+        InetAddress peerAddr; //客户端地址
+        int connfd = acceptSocket_.accept(&peerAddr);
+        if(connfd >= 0)
         {
-            newConnectionCallback_(connfd,peerAddr);
+            if(newConnectionCallback_) // 轮询找到subloop，唤醒并分发当前新客户端connfd的Channel
+            {
+                newConnectionCallback_(connfd,peerAddr);
+            }
+            else
+            {
+                ::close(connfd);// 如果没有设置新用户连接的回调操作，就关闭连接
+            }
+            continue;
         }
-        else
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
         {
-            ::close(connfd);// 如果没有设置新用户连接的回调操作，就关闭连接
+            return; // 全连接队列已经空了
         }
-    }
-    else //accept出错
-    {
+        if(errno == EINTR || errno == ECONNABORTED)
+        {
+            continue;
+        }
+        //accept出错
         LOG_ERROR("%s:%s:%d accept err:%d \n", __FILE__, __FUNCTION__, __LINE__,errno);
         if(errno == EMFILE)//当前进程没有可用的fd再分配
         {
@@ -82,5 +111,10 @@ void Acceptor::handleRead()
             **/
             LOG_ERROR("%s:%s:%d sockfd reached limit\n", __FILE__, __FUNCTION__, __LINE__);
         }
+        return;
+    }
+    if(edge)
+    {
+        loop_->queueInLoop(std::bind(&Acceptor::handleRead, this));
     }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "Channel.h"
 
 #include<functional>
+#include<vector>
 
 class EventLoop;
 class InetAddress;
@@ -13,6 +14,8 @@ class Acceptor : noncopyable
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
     Acceptor(EventLoop *loop, const InetAddress &listenAddr, bool reuseport);
+    //接管一个已经bind好的listenfd，比如另一个Acceptor的listenFd()复制出来的，多个loop共用一个监听socket
+    Acceptor(EventLoop *loop, int listenfd);
     ~Acceptor();
 
     void setNewConnectionCallback(const NewConnectionCallback &cb)
@@ -22,9 +25,22 @@ public:
 
     bool listenning()const { return listenning_; }
     void listen();
+    //listenfd改成边沿触发，handleRead一直accept到EAGAIN，一次最多kAcceptBudget个
+    void setEdgeTriggered(bool on) { acceptChannel_.setEdgeTriggered(on); }
+    //多个loop监听同一个socket时只唤醒其中一个，见Channel::setExclusive，listen之前设置
+    void setExclusive(bool on) { acceptChannel_.setExclusive(on); }
+    int listenFd() const { return acceptSocket_.fd(); }
+    EventLoop* getLoop() const { return loop_; }
+    //只调用::listen，不注册到loop，可以在别的线程按确定的顺序把socket加进SO_REUSEPORT组，之后listen()再调用一次也没关系
+    void listenSocket() { acceptSocket_.listen(); }
+    //按收包CPU在SO_REUSEPORT组里选socket，见Socket::attachCpuSteering
+    bool attachCpuSteering(const std::vector<int> &cpuOfIndex) { return acceptSocket_.attachCpuSteering(cpuOfIndex); }
 private:
+    void init();
     void handleRead();
 
+    static const int kAcceptBudget = 64;
+
     EventLoop *loop_; //Acceptor用的就是用户定义的baseLoop,也称作mainLoop
     Socket acceptSocket_;
     Channel acceptChannel_;
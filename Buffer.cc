@@ -1,8 +1,378 @@
 #include "Buffer.h"
+#include "BufferPool.h"
+#include "Logger.h"
 
 #include <errno.h>
 #include <sys/uio.h>
 #include <unistd.h>
+#include <stdlib.h>
+#include <memory>
+#include <sys/mman.h>
+
+const size_t Buffer::kBlockSize;
+
+Buffer::Buffer(size_t initialSize, std::shared_ptr<BufferPool> pool)
+    :pool_(std::move(pool))
+    ,buffer_(nullptr)
+    ,capacity_(0)
+    ,mirrored_(false)
+    ,ring_(false)
+    ,initialSize_(initialSize)
+    ,readerIndex_(kCheapPrepend)
+    ,writerIndex_(kCheapPrepend)
+    ,chained_(false)
+    ,chainBytes_(0)
+    ,spareBlock_(nullptr)
+{
+}
+
+Buffer::Buffer(const Buffer& other)
+    :buffer_(nullptr)
+    ,capacity_(0)
+    ,mirrored_(other.mirrored_)
+    ,ring_(false)
+    ,initialSize_(other.initialSize_)
+    ,readerIndex_(kCheapPrepend)
+    ,writerIndex_(kCheapPrepend)
+    ,chained_(other.chained_)
+    ,chainBytes_(0)
+    ,spareBlock_(nullptr)
+{
+    if(other.writerIndex_ > other.readerIndex_)
+    {
+        append(other.begin() + other.readerIndex_, other.writerIndex_ - other.readerIndex_);
+    }
+    for(const Block &block : other.chain_)
+    {
+        append(block.data + block.readerIndex, block.writerIndex - block.readerIndex);
+    }
+}
+
+Buffer::Buffer(Buffer&& other) noexcept
+    :pool_(other.pool_)
+    ,buffer_(other.buffer_)
+    ,capacity_(other.capacity_)
+    ,mirrored_(other.mirrored_)
+    ,ring_(other.ring_)
+    ,initialSize_(other.initialSize_)
+    ,readerIndex_(other.readerIndex_)
+    ,writerIndex_(other.writerIndex_)
+    ,chained_(other.chained_)
+    ,chain_(std::move(other.chain_))
+    ,chainBytes_(other.chainBytes_)
+    ,spareBlock_(other.spareBlock_)
+{
+    other.buffer_ = nullptr;
+    other.capacity_ = 0;
+    other.ring_ = false;
+    other.readerIndex_ = other.writerIndex_ = kCheapPrepend;
+    other.chain_.clear();
+    other.chainBytes_ = 0;
+    other.spareBlock_ = nullptr;
+}
+
+// 按值传参，拷贝赋值和移动赋值都是构造一个临时对象再交换
+Buffer& Buffer::operator=(Buffer other)
+{
+    swap(other);
+    return *this;
+}
+
+void Buffer::swap(Buffer& other)
+{
+    pool_.swap(other.pool_);
+    std::swap(buffer_, other.buffer_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(mirrored_, other.mirrored_);
+    std::swap(ring_, other.ring_);
+    std::swap(initialSize_, other.initialSize_);
+    std::swap(readerIndex_, other.readerIndex_);
+    std::swap(writerIndex_, other.writerIndex_);
+    std::swap(chained_, other.chained_);
+    chain_.swap(other.chain_);
+    std::swap(chainBytes_, other.chainBytes_);
+    std::swap(spareBlock_, other.spareBlock_);
+}
+
+Buffer::~Buffer()
+{
+    releaseChain();
+    deallocateBlock(spareBlock_);
+    releaseStorage();
+}
+
+bool Buffer::setMirrored(bool on)
+{
+    if(on == mirrored_)
+    {
+        return true;
+    }
+    if(readableBytes() > 0)
+    {
+        return false;
+    }
+    // 换了内存类型，原来的内存直接还掉，下次写数据时按新的类型分配
+    releaseStorage();
+    readerIndex_ = writerIndex_ = kCheapPrepend;
+    mirrored_ = on;
+    if(on)
+    {
+        chained_ = false;
+        deallocateBlock(spareBlock_);
+        spareBlock_ = nullptr;
+    }
+    return true;
+}
+
+/**
+ * 先占一段两倍大小的地址空间，再把同一个memfd用MAP_FIXED映射到前后两半，
+ * 映射完fd就可以关掉，内存跟着映射走。两份映射共享同样的物理页
+ */
+char* Buffer::allocateRing(size_t size, size_t* actual)
+{
+    const size_t pageSize = ::sysconf(_SC_PAGESIZE);
+    size_t len = (size + pageSize - 1) / pageSize * pageSize;
+    int fd = ::memfd_create("mymuduo-buffer", MFD_CLOEXEC);
+    if(fd < 0)
+    {
+        return nullptr;
+    }
+    if(::ftruncate(fd, len) < 0)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+    void* base = ::mmap(nullptr, 2 * len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED)
+    {
+        ::close(fd);
+        return nullptr;
+    }
+    char* p = static_cast<char*>(base);
+    void* first = ::mmap(p, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    void* second = ::mmap(p + len, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    ::close(fd);
+    if(first == MAP_FAILED || second == MAP_FAILED)
+    {
+        ::munmap(base, 2 * len);
+        return nullptr;
+    }
+    *actual = len;
+    return p;
+}
+
+void Buffer::deallocateRing(char* p, size_t size)
+{
+    ::munmap(p, 2 * size);
+}
+
+void Buffer::releaseStorage()
+{
+    if(buffer_ == nullptr)
+    {
+        return;
+    }
+    if(ring_)
+    {
+        deallocateRing(buffer_, capacity_);
+    }
+    else
+    {
+        deallocate(buffer_, capacity_);
+    }
+    buffer_ = nullptr;
+    capacity_ = 0;
+    ring_ = false;
+}
+
+char* Buffer::allocate(size_t size, size_t* actual)
+{
+    if(pool_ != nullptr && !pool_->inOwnerThread())
+    {
+        detachPool();
+    }
+    if(pool_ != nullptr)
+    {
+        return pool_->allocate(size, actual);
+    }
+    char* p = static_cast<char*>(::malloc(size));
+    if(p == nullptr)
+    {
+        LOG_FATAL("Buffer::allocate malloc %lu bytes failed \n", size);
+    }
+    *actual = size;
+    return p;
+}
+
+void Buffer::deallocate(char* p, size_t size)
+{
+    if(p == nullptr)
+    {
+        return;
+    }
+    if(pool_ != nullptr)
+    {
+        pool_->deallocate(p, size);
+    }
+    else
+    {
+        ::free(p);
+    }
+}
+
+/**
+ * 内存池只能在loop线程里分配，Buffer被拿到别的线程里接着写(比如loop退出以后用户还留着连接)时走这里
+ * 先把pool_置空，之后的allocate/deallocate都走malloc，再把手上从内存池拿的内存逐块换掉，
+ * 内存池的内存在别的线程释放是安全的，会挂到它的remote链表上
+ */
+void Buffer::detachPool()
+{
+    std::shared_ptr<BufferPool> pool;
+    pool.swap(pool_);
+    if(buffer_ != nullptr && !ring_)
+    {
+        size_t actual = 0;
+        char* p = allocate(capacity_, &actual);
+        std::copy(begin() + readerIndex_, begin() + writerIndex_, p + readerIndex_);
+        pool->deallocate(buffer_, capacity_);
+        buffer_ = p;
+    }
+    for(Block &block : chain_)
+    {
+        char* p = allocateBlock();
+        std::copy(block.data + block.readerIndex, block.data + block.writerIndex, p + block.readerIndex);
+        pool->deallocate(block.data, kBlockSize);
+        block.data = p;
+    }
+    if(spareBlock_ != nullptr)
+    {
+        pool->deallocate(spareBlock_, kBlockSize);
+        spareBlock_ = nullptr;
+    }
+}
+
+char* Buffer::allocateBlock()
+{
+    size_t actual = 0;
+    return allocate(kBlockSize, &actual);
+}
+
+void Buffer::deallocateBlock(char* p)
+{
+    deallocate(p, kBlockSize);
+}
+
+void Buffer::shrink(size_t reserve)
+{
+    deallocateBlock(spareBlock_);
+    spareBlock_ = nullptr;
+    if(readableBytes() == 0)
+    {
+        releaseStorage();
+        readerIndex_ = writerIndex_ = kCheapPrepend;
+        return;
+    }
+    if(ring_)
+    {
+        return; // 环形内存按页分配，还有数据的时候不换
+    }
+
+    linearize();
+    size_t readable = writerIndex_ - readerIndex_;
+    size_t size = kCheapPrepend + readable + reserve;
+    if(size >= capacity_)
+    {
+        return;
+    }
+    size_t actual = 0;
+    char* p = allocate(size, &actual);
+    if(actual >= capacity_)
+    {
+        deallocate(p, actual); // 内存池向上取整以后没有变小，不用换
+        return;
+    }
+    std::copy(begin() + readerIndex_, begin() + writerIndex_, p + kCheapPrepend);
+    deallocate(buffer_, capacity_);
+    buffer_ = p;
+    capacity_ = actual;
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend + readable;
+}
+
+void Buffer::prepend(const void* data, size_t len)
+{
+    if(len > prependableBytes())
+    {
+        LOG_FATAL("Buffer::prepend %lu bytes, only %lu prependable \n", len, prependableBytes());
+    }
+    if(buffer_ == nullptr)
+    {
+        grow(0); // 还没写过数据，先把预留区连同初始空间分配出来
+    }
+    if(ring_ && readerIndex_ < len)
+    {
+        // 往前绕到环的末尾，两个下标一起挪到第二份映射里，写的时候也是连续的
+        readerIndex_ += capacity_;
+        writerIndex_ += capacity_;
+    }
+    readerIndex_ -= len;
+    const char* d = static_cast<const char*>(data);
+    std::copy(d, d + len, begin() + readerIndex_);
+}
+
+void Buffer::grow(size_t len)
+{
+    size_t readable = writerIndex_ - readerIndex_;
+    size_t need = kCheapPrepend + readable + len;
+    //至少翻倍，避免一点点追加的时候反复拷贝；第一次分配按initialSize_来
+    size_t size = std::max(need, buffer_ == nullptr ? kCheapPrepend + initialSize_ : capacity_ * 2);
+    size_t actual = 0;
+    char* p = nullptr;
+    bool ring = false;
+    if(mirrored_)
+    {
+        p = allocateRing(size, &actual);
+        if(p == nullptr)
+        {
+            LOG_ERROR("Buffer::grow mirrored ring of %lu bytes failed, fall back to heap memory \n", size);
+            mirrored_ = false;
+        }
+        ring = p != nullptr;
+    }
+    if(p == nullptr)
+    {
+        p = allocate(size, &actual);
+    }
+    if(readable > 0)
+    {
+        std::copy(begin() + readerIndex_, begin() + writerIndex_, p + kCheapPrepend);
+    }
+    releaseStorage();
+    buffer_ = p;
+    capacity_ = actual;
+    ring_ = ring;
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend + readable;
+}
+
+namespace
+{
+const size_t kExtraBufSize = 65536;
+
+/**
+ * readFd溢出用的64K临时空间，每个线程一份，第一次用的时候new出来，线程退出时释放
+ * 放在栈上的话每次读事件都要把64K清零一遍，这里new char[]不做初始化，readv会覆盖要用的部分
+ */
+char* extraBuffer()
+{
+    static thread_local std::unique_ptr<char[]> t_extrabuf;
+    if(!t_extrabuf)
+    {
+        t_extrabuf.reset(new char[kExtraBufSize]);
+    }
+    return t_extrabuf.get();
+}
+}
 
 //从fd上读取数据，底层的Poller工作在LT模式，存放到writerIndex_，返回实际读取的数据大小 
 //底层的buffer缓冲区是有大小的，但是从fd上读数据的时候，却不知道tcp数据最终的大小
@@ -11,7 +381,12 @@
 //muduo库中使用readv方法，根据读取的数据多少开动态开辟缓冲区
 ssize_t Buffer::readFd(int fd, int* saveErrno)
 {
-    char extrabuf[65536] = {0}; // 64K栈空间，会随着函数栈帧回退，内存自动回收
+    if(chained_)
+    {
+        return readFdChained(fd, saveErrno);
+    }
+
+    char *extrabuf = extraBuffer(); // 本线程的64K临时空间，读完马上拷走，不会被别的Buffer同时用
     
     struct iovec vec[2];
     
@@ -27,17 +402,18 @@ ssize_t Buffer::readFd(int fd, int* saveErrno)
     vec[0].iov_len = writable; // iov_base缓冲区可写的大小
 
     vec[1].iov_base = extrabuf; // 第二块缓冲区
-    vec[1].iov_len = sizeof extrabuf;
+    vec[1].iov_len = kExtraBufSize;
 
     // 如果Buffer有65536字节的空闲空间，就不使用栈上的缓冲区
     //如果不够65536字节，就使用栈上的缓冲区，即readv一次最多读取65536字节数据
-    const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1; 
-    const ssize_t n = ::readv(fd, vec, iovcnt);
+    const int iovcnt = (writable < kExtraBufSize) ? 2 : 1; 
+    // 还没有分配内存的Buffer直接读到extrabuf，读到多少再按实际大小分配
+    const ssize_t n = (writable == 0) ? ::readv(fd, vec + 1, 1) : ::readv(fd, vec, iovcnt);
     if(n < 0)
     {
         *saveErrno = errno;
     }
-    else if(n <= writable)
+    else if(static_cast<size_t>(n) <= writable)
     {
          // 读取的数据n小于Buffer底层的可写空间，readv会直接把数据存放在begin() + writerIndex_
          writerIndex_ += n;
@@ -45,19 +421,227 @@ ssize_t Buffer::readFd(int fd, int* saveErrno)
     else
     {
         //extrabuf里面也写入了数据
-        writerIndex_ = buffer_.size();
+        writerIndex_ += writable;
         // 从extrabuff里读取 n - writable 字节的数据存入Buffer底层的缓冲区
         append(extrabuf, n - writable); 
     }
     return n;
 }
 
+//把buffer_和所有数据块的可读数据组装成iovec，一次writev写出去，不分段的时候就只有一个iovec
 ssize_t Buffer::writeFd(int fd,  int* saveErrno)
 {
-    ssize_t n = ::write(fd, peek(), readableBytes());
+    struct iovec vec[kMaxIovecs];
+    int iovcnt = readableIovecs(vec, kMaxIovecs);
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if(n < 0)
+    {
+        *saveErrno = errno;
+    }
+    return n;
+}
+
+int Buffer::readableIovecs(struct iovec* vec, int maxIovecs) const
+{
+    int iovcnt = 0;
+    if(writerIndex_ > readerIndex_ && iovcnt < maxIovecs)
+    {
+        vec[iovcnt].iov_base = const_cast<char*>(begin()) + readerIndex_;
+        vec[iovcnt].iov_len = writerIndex_ - readerIndex_;
+        ++iovcnt;
+    }
+    for(const Block &block : chain_)
+    {
+        if(iovcnt == maxIovecs)
+        {
+            break;
+        }
+        vec[iovcnt].iov_base = block.data + block.readerIndex;
+        vec[iovcnt].iov_len = block.writerIndex - block.readerIndex;
+        ++iovcnt;
+    }
+    return iovcnt;
+}
+
+//分段模式下追加数据：先填满buffer_剩余的可写空间，剩下的按顺序写进数据块，已有的数据一个字节都不动
+void Buffer::appendChained(const char* data, size_t len)
+{
+    if(chain_.empty())
+    {
+        size_t n = std::min(len, writableBytes());
+        std::copy(data, data + n, begin() + writerIndex_);
+        writerIndex_ += n;
+        data += n;
+        len -= n;
+    }
+    while(len > 0)
+    {
+        if(chain_.empty() || chain_.back().writerIndex == kBlockSize)
+        {
+            Block block;
+            block.data = spareBlock_ != nullptr ? spareBlock_ : allocateBlock();
+            spareBlock_ = nullptr;
+            block.readerIndex = block.writerIndex = 0;
+            chain_.push_back(std::move(block));
+        }
+        Block &tail = chain_.back();
+        size_t n = std::min(len, kBlockSize - tail.writerIndex);
+        std::copy(data, data + n, tail.data + tail.writerIndex);
+        tail.writerIndex += n;
+        chainBytes_ += n;
+        data += n;
+        len -= n;
+    }
+}
+
+//先消费buffer_里的数据，再从链表头开始消费数据块，读完的数据块直接丢掉
+void Buffer::retrieveChained(size_t len)
+{
+    size_t head = writerIndex_ - readerIndex_;
+    if(len < head)
+    {
+        readerIndex_ += len;
+        return;
+    }
+    len -= head;
+    readerIndex_ = writerIndex_ = kCheapPrepend;
+    while(len > 0 && !chain_.empty())
+    {
+        Block &front = chain_.front();
+        size_t avail = front.writerIndex - front.readerIndex;
+        if(len < avail)
+        {
+            front.readerIndex += len;
+            chainBytes_ -= len;
+            break;
+        }
+        len -= avail;
+        chainBytes_ -= avail;
+        if(spareBlock_ == nullptr)
+        {
+            spareBlock_ = front.data; // 留一块备用，避免反复分配释放
+        }
+        else
+        {
+            deallocateBlock(front.data);
+        }
+        chain_.pop_front();
+    }
+}
+
+void Buffer::releaseChain()
+{
+    for(const Block &block : chain_)
+    {
+        deallocateBlock(block.data);
+    }
+    chain_.clear();
+    chainBytes_ = 0;
+}
+
+void Buffer::peekBytes(void* dst, size_t len, size_t offset) const
+{
+    char* out = static_cast<char*>(dst);
+    size_t head = writerIndex_ - readerIndex_;
+    if(offset < head)
+    {
+        size_t n = std::min(len, head - offset);
+        ::memcpy(out, begin() + readerIndex_ + offset, n);
+        out += n;
+        len -= n;
+        offset = 0;
+    }
+    else
+    {
+        offset -= head;
+    }
+    for(std::deque<Block>::const_iterator it = chain_.begin(); len > 0 && it != chain_.end(); ++it)
+    {
+        size_t avail = it->writerIndex - it->readerIndex;
+        if(offset >= avail)
+        {
+            offset -= avail;
+            continue;
+        }
+        size_t n = std::min(len, avail - offset);
+        ::memcpy(out, it->data + it->readerIndex + offset, n);
+        out += n;
+        len -= n;
+        offset = 0;
+    }
+}
+
+void Buffer::linearize()
+{
+    if(chain_.empty())
+    {
+        return;
+    }
+    size_t head = writerIndex_ - readerIndex_;
+    size_t readable = readableBytes();
+    if(capacity_ < kCheapPrepend + readable)
+    {
+        grow(chainBytes_);
+    }
+    else
+    {
+        std::copy(begin() + readerIndex_, begin() + writerIndex_, begin() + kCheapPrepend);
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = kCheapPrepend + head;
+    }
+    for(const Block &block : chain_)
+    {
+        std::copy(block.data + block.readerIndex,
+                    block.data + block.writerIndex,
+                    begin() + writerIndex_);
+        writerIndex_ += block.writerIndex - block.readerIndex;
+    }
+    releaseChain();
+}
+
+//分段模式下先readv进最后一个数据块(或者buffer_)剩下的空间，放不下的部分和readFd一样先读进本线程的64K临时空间，
+//再按需要追加成新的数据块，尾部还有空间的时候不用预先准备一整块
+ssize_t Buffer::readFdChained(int fd, int* saveErrno)
+{
+    char *extrabuf = extraBuffer();
+
+    struct iovec vec[2];
+    size_t first = 0;
+    Block *tail = chain_.empty() ? nullptr : &chain_.back();
+    if(tail == nullptr)
+    {
+        first = writableBytes();
+        vec[0].iov_base = begin() + writerIndex_;
+    }
+    else
+    {
+        first = kBlockSize - tail->writerIndex;
+        vec[0].iov_base = tail->data + tail->writerIndex;
+    }
+    vec[0].iov_len = first;
+    vec[1].iov_base = extrabuf;
+    vec[1].iov_len = kExtraBufSize;
+
+    const ssize_t n = (first > 0) ? ::readv(fd, vec, 2) : ::readv(fd, vec + 1, 1);
     if(n < 0)
     {
         *saveErrno = errno;
+        return n;
+    }
+
+    size_t filled = std::min(static_cast<size_t>(n), first);
+    if(tail == nullptr)
+    {
+        writerIndex_ += filled;
+    }
+    else
+    {
+        tail->writerIndex += filled;
+        chainBytes_ += filled;
+    }
+    if(static_cast<size_t>(n) > first)
+    {
+        appendChained(extrabuf, n - first);
     }
     return n;
-}
\ No newline at end of file
+}
@@ -1,8 +1,18 @@
 #pragma once
 
-#include <vector>
+#include "ByteSearch.h"
+
+#include <deque>
+#include <memory>
 #include <string>
 #include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+class BufferPool;
 
 //网络库底层的缓冲区类型定义
 class Buffer
@@ -10,37 +20,102 @@ class Buffer
 public:
     static const size_t kCheapPrepend = 8;//数据包长度
     static const size_t kInitialSize = 1024; //缓冲区大小
+    static const size_t kBlockSize = 64 * 1024; //分段模式下每个数据块的大小
 
-    explicit Buffer(size_t initialSize = kInitialSize)
-        :buffer_(kCheapPrepend + initialSize)
-        ,readerIndex_(kCheapPrepend)
-        ,writerIndex_(kCheapPrepend)
-        {}
-    
-    //因为底层的内存资源是通过vector直接管理的，所以buffer_也不需要自己去析构资源，当前对象析构的时候成员对象析构，vector在析构的时候会自动释放外面堆内存管理的资源
+    /**
+     * 构造的时候不分配内存，第一次写数据才分配initialSize大小，空闲连接的Buffer不占内存
+     * 传了pool的Buffer从所属loop的内存池里拿内存，这样TcpConnection在mainloop里构造时不会碰subloop的内存池
+     * 内存池只能在loop线程里分配，在别的线程里要分配内存时(比如loop已经退出)，Buffer把手上的内存换成malloc的，不再用内存池
+     */
+    explicit Buffer(size_t initialSize = kInitialSize, std::shared_ptr<BufferPool> pool = nullptr);
+    //拷贝只拷可读数据和模式，新的Buffer不用内存池，拷贝出来的对象可以拿到任何线程里用
+    Buffer(const Buffer& other);
+    //移动直接接管底层内存，other变成刚构造时不占内存的状态
+    Buffer(Buffer&& other) noexcept;
+    Buffer& operator=(Buffer other);
+    //底层内存是从内存池或者malloc拿的，析构的时候要还回去
+    ~Buffer();
 
+    void swap(Buffer& other);
 
-    //可读数据长度
+
+    /**
+     * 分段模式：buffer_写满以后，后续数据追加到固定大小的数据块链表chain_上，
+     * 既不resize也不搬移已有数据，writeFd用writev把所有数据块一次写出。
+     * 适合发送几MB的大响应。可读数据不再保证连续：peek()只是第一段，按段访问用readableIovecs()，
+     * 需要整段连续内存的解析器自己调用linearize()
+     */
+    void setChained(bool on) { chained_ = on && !mirrored_; }
+    bool chained() const { return chained_; }
+
+    /**
+     * 镜像环形模式：底层是一个memfd，在连续的虚拟地址上映射两遍，
+     * 可读数据跨过环的末尾时在地址上仍然是连续的，peek()/beginWrite()不用搬移数据，
+     * retrieve只移动下标，不会再有makeSpace的整体前移。适合持续收发数据流的连接
+     * 只能在没有可读数据的时候切换，否则返回false；和分段模式互斥，开启以后setChained不起作用
+     * memfd或mmap失败时打日志，退回普通的连续内存
+     */
+    bool setMirrored(bool on);
+    bool mirrored() const { return mirrored_; }
+
+    //可读数据长度，包括数据块链表上的数据
     size_t readableBytes() const
     {
-        return writerIndex_ - readerIndex_;
+        return writerIndex_ - readerIndex_ + chainBytes_;
     }
 
-    //可写空间大小
+    //可写空间大小，数据块链表不为空时，buffer_后面不能再写，否则数据顺序就乱了
     size_t writableBytes() const
     {
-        return buffer_.size() - writerIndex_;
+        if(ring_)
+        {
+            return capacity_ - (writerIndex_ - readerIndex_);
+        }
+        return chain_.empty() && capacity_ > writerIndex_ ? capacity_ - writerIndex_ : 0;
     }
+    //环形模式下可读数据前后的空闲空间是同一块，都可以prepend
     size_t prependableBytes() const
     {
-        return readerIndex_;
+        return ring_ ? capacity_ - (writerIndex_ - readerIndex_) : readerIndex_;
+    }
+
+    //底层实际占用的内存大小，不包括分段模式的数据块，环形模式下是环的大小(虚拟地址占两倍)
+    size_t internalCapacity() const
+    {
+        return capacity_;
     }
 
-    //返回缓冲区中可读数据的起始地址
+    /**
+     * 突发流量过后把多余的内存还回去：没有可读数据就整个释放，回到刚构造时不占内存的状态，
+     * 否则换一块刚好装下可读数据再加reserve字节的内存
+     */
+    void shrink(size_t reserve);
+
+    /**
+     * 返回缓冲区中可读数据的起始地址
+     * 分段模式下可读数据可能分在buffer_和几个数据块里，这里只是第一段，连续的长度是contiguousBytes()
+     */
     const char* peek() const
     {
+        if(writerIndex_ == readerIndex_ && !chain_.empty())
+        {
+            return chain_.front().data + chain_.front().readerIndex;
+        }
         return begin() + readerIndex_; 
     }
+    //peek()开始有多少字节是连续的，不是分段模式时就是readableBytes()
+    size_t contiguousBytes() const
+    {
+        if(writerIndex_ == readerIndex_ && !chain_.empty())
+        {
+            return chain_.front().writerIndex - chain_.front().readerIndex;
+        }
+        return writerIndex_ - readerIndex_;
+    }
+    //把可读数据从第offset个字节开始的len字节拷到dst，不取走，可以跨数据块。offset + len不能超过readableBytes()
+    void peekBytes(void* dst, size_t len, size_t offset = 0) const;
+    //把数据块链表上的数据合并到buffer_，之后可读数据是连续的。会拷贝全部数据块，只在确实需要整段连续内存时调用
+    void linearize();
 
     /**
      *在底层相关connection有数据到来的时候，muduo库会注册回调onMessage 
@@ -51,12 +126,21 @@ public:
     {
         // len就是应用程序从Buffer缓冲区读取的数据长度
         // 必须要保证len <= readableBytes()
-        if(len < readableBytes())
+        if(!chain_.empty())
+        {
+            retrieveChained(len);
+        }
+        else if(len < readableBytes())
         {
             // 这里就是可读数据没有读完
             //应用只读取了可读缓冲区数据的一部分，就是len,还剩下readableIndex_ += len - writerIndex_
             readerIndex_ += len;
-
+            if(ring_ && readerIndex_ >= capacity_)
+            {
+                // 读到了第二份映射里，两个下标一起退回第一份，指向的还是同样的数据
+                readerIndex_ -= capacity_;
+                writerIndex_ -= capacity_;
+            }
         }
         else
         {
@@ -69,6 +153,10 @@ public:
     void retrieveAll()
     {
         readerIndex_ = writerIndex_ = kCheapPrepend;
+        if(!chain_.empty())
+        {
+            releaseChain();
+        }
     }
 
     //把onMessage函数上报的Buffer数据，转成string类型的数据返回
@@ -78,13 +166,26 @@ public:
     }
     std::string retrieveAsString(size_t len)
     {
-        std::string result(peek(), len);
+        std::string result;
+        if(len <= contiguousBytes())
+        {
+            result.assign(peek(), len);
+        }
+        else
+        {
+            result.resize(len);
+            peekBytes(&result[0], len);
+        }
         retrieve(len);//上面一句把缓冲区中可读的数据，已经读取出来，这里肯定要对缓冲区进行复位操作
         return result;
     }
 
     void ensureWritableBytes(size_t len)
     {
+        if(!chain_.empty())
+        {
+            linearize(); // beginWrite()必须接在全部可读数据后面
+        }
         if(writableBytes() < len)
         {
             makeSpace(len);//扩容函数
@@ -94,6 +195,11 @@ public:
     //不管是从fd上读数据写到缓冲区inputBuffer_，还是发数据要写入outputBuffer_，我们都要往writeable区间内添加数据
     void append(const char* data, size_t len)
     {
+        if(chained_ && (!chain_.empty() || writableBytes() < len))
+        {
+            appendChained(data, len);
+            return;
+        }
         // 确保可写空间不小于len
         ensureWritableBytes(len);
         // 把[data,data+len]内存上的数据，添加到writable缓冲区当中
@@ -101,6 +207,121 @@ public:
         writerIndex_ += len;
 
     }
+    /**
+     * 在可读数据里从第offset个字节开始找分隔符，返回指向可读数据内部的指针，找不到返回nullptr
+     * 解析器没找到完整的一行时记下已经扫过的长度，下次从那里接着找，不用每次从头扫
+     * (findCRLF要退回一个字节，上次的最后一个字节可能正好是'\r')
+     * 底层用SIMD实现，见ByteSearch。分段模式下只在peek()开始的连续部分里找，要找整个可读数据先linearize()
+     */
+    const char* findCRLF(size_t offset = 0) const
+    {
+        return offset < contiguousBytes() ? ByteSearch::findCRLF(peek() + offset, peek() + contiguousBytes()) : nullptr;
+    }
+    const char* findEOL(size_t offset = 0) const
+    {
+        return find('\n', offset);
+    }
+    const char* find(char c, size_t offset = 0) const
+    {
+        return offset < contiguousBytes() ? ByteSearch::findChar(peek() + offset, peek() + contiguousBytes(), c) : nullptr;
+    }
+
+    /**
+     * 网络字节序(大端)的整数读写，用来做长度头之类的帧格式
+     * appendInt写在可读数据末尾，peekInt读可读数据开头但不取走，readInt读完取走，
+     * prependInt写在可读数据前面，用的是kCheapPrepend预留的空间。peek/read之前必须保证可读数据够长
+     * 分段模式下整数跨了数据块也能读，不会合并数据块
+     */
+    void appendInt64(int64_t x)
+    {
+        int64_t be64 = htobe64(x);
+        append(reinterpret_cast<const char*>(&be64), sizeof be64);
+    }
+    void appendInt32(int32_t x)
+    {
+        int32_t be32 = htobe32(x);
+        append(reinterpret_cast<const char*>(&be32), sizeof be32);
+    }
+    void appendInt16(int16_t x)
+    {
+        int16_t be16 = htobe16(x);
+        append(reinterpret_cast<const char*>(&be16), sizeof be16);
+    }
+    void appendInt8(int8_t x)
+    {
+        append(reinterpret_cast<const char*>(&x), sizeof x);
+    }
+
+    int64_t peekInt64() const
+    {
+        int64_t be64 = 0;
+        peekBytes(&be64, sizeof be64);
+        return be64toh(be64);
+    }
+    int32_t peekInt32() const
+    {
+        int32_t be32 = 0;
+        peekBytes(&be32, sizeof be32);
+        return be32toh(be32);
+    }
+    int16_t peekInt16() const
+    {
+        int16_t be16 = 0;
+        peekBytes(&be16, sizeof be16);
+        return be16toh(be16);
+    }
+    int8_t peekInt8() const
+    {
+        return *peek(); // 可读数据不为空时第一段至少有一个字节
+    }
+
+    int64_t readInt64()
+    {
+        int64_t result = peekInt64();
+        retrieve(sizeof result);
+        return result;
+    }
+    int32_t readInt32()
+    {
+        int32_t result = peekInt32();
+        retrieve(sizeof result);
+        return result;
+    }
+    int16_t readInt16()
+    {
+        int16_t result = peekInt16();
+        retrieve(sizeof result);
+        return result;
+    }
+    int8_t readInt8()
+    {
+        int8_t result = peekInt8();
+        retrieve(sizeof result);
+        return result;
+    }
+
+    void prependInt64(int64_t x)
+    {
+        int64_t be64 = htobe64(x);
+        prepend(&be64, sizeof be64);
+    }
+    void prependInt32(int32_t x)
+    {
+        int32_t be32 = htobe32(x);
+        prepend(&be32, sizeof be32);
+    }
+    void prependInt16(int16_t x)
+    {
+        int16_t be16 = htobe16(x);
+        prepend(&be16, sizeof be16);
+    }
+    void prependInt8(int8_t x)
+    {
+        prepend(&x, sizeof x);
+    }
+    //把data写到可读数据前面，len不能超过prependableBytes()，一般就是先append消息体再prependInt32长度
+    void prepend(const void* data, size_t len);
+
     char* beginWrite()
     {
         return begin() + writerIndex_;
@@ -109,29 +330,66 @@ public:
     {
         return begin() + writerIndex_;
     }
+    //直接往beginWrite()写了len字节以后(比如io_uring异步recv)调用，len不能超过writableBytes()
+    void hasWritten(size_t len)
+    {
+        writerIndex_ += len;
+    }
     //从fd上读取数据，存放到writerIndex_，返回实际读取的数据大小 
     ssize_t readFd(int fd, int* saveErrno);
     ssize_t writeFd(int fd, int* saveErrno);
+    //把可读数据按顺序填进vec，最多maxIovecs个，返回用了几个。不会合并数据块，TcpConnection用它和别的数据一起writev
+    int readableIovecs(struct iovec* vec, int maxIovecs) const;
 private:
+    static const int kMaxIovecs = 64; //writeFd一次writev最多带的数据块个数
+
+    //分段模式下的数据块，[readerIndex, writerIndex)是可读数据
+    struct Block
+    {
+        char* data;
+        size_t readerIndex;
+        size_t writerIndex;
+    };
+
+    void appendChained(const char* data, size_t len);
+    void retrieveChained(size_t len);
+    void releaseChain();
+    ssize_t readFdChained(int fd, int* saveErrno);
+
+    //有pool就从pool拿，没有就malloc，*actual是实际拿到的大小
+    char* allocate(size_t size, size_t* actual);
+    //不在内存池的loop线程里时调用，把从内存池拿的内存都换成malloc的，之后不再用内存池
+    void detachPool();
+    void deallocate(char* p, size_t size);
+    char* allocateBlock();
+    void deallocateBlock(char* p);
+    //镜像环形内存，size按页向上取整，失败返回nullptr
+    static char* allocateRing(size_t size, size_t* actual);
+    static void deallocateRing(char* p, size_t size);
+    //释放buffer_，回到没有分配内存的状态
+    void releaseStorage();
+    //换一块能再写len字节的更大内存，只拷贝可读数据
+    void grow(size_t len);
+
     //返回buffer底层数组首元素的地址，也就是数组的起始地址
     char* begin()
     {
-        return &(*buffer_.begin());
+        return buffer_;
     }
     const char* begin() const
     {
-        return &(*buffer_.begin());
+        return buffer_;
     }
     /**
      *  
      */
     void makeSpace(size_t len)
     {
-        //如果需要写入缓冲区数据的长度要大于Buffer对象底层vector空闲的长度了，就需要扩容，其中len表示需要写入数据的长度
-        if(writableBytes() + prependableBytes() < len + kCheapPrepend)
+        //如果需要写入缓冲区数据的长度要大于Buffer对象底层内存空闲的长度了，就需要扩容，其中len表示需要写入数据的长度
+        if(ring_ || writableBytes() + prependableBytes() < len + kCheapPrepend)
         {
-            // 直接在writerIndex_后面再扩大len的空间
-            buffer_.resize(len + writerIndex_);
+            // 空间不够，换一块更大的内存。环形内存的空闲空间本来就是连续的，不够只能换更大的环
+            grow(len);
         }
         else // 如果是空闲空间足够存放len字节的数据，就把未读取的数据统一往前移，移到kCheapPrepend的位置
         {
@@ -144,7 +402,17 @@ private:
             writerIndex_ = readerIndex_ + readable;// writerIndex_指向待读取数据的末尾
         }
     }
-    std::vector<char> buffer_;
+    std::shared_ptr<BufferPool> pool_;
+    char* buffer_; //底层内存，还没写过数据的时候是nullptr
+    size_t capacity_;
+    bool mirrored_; //是否用镜像环形内存
+    bool ring_; //buffer_当前是不是镜像环形内存，环形模式下readerIndex_ < capacity_，writerIndex_可以越过capacity_
+    size_t initialSize_;
     size_t readerIndex_;
     size_t writerIndex_;
+
+    bool chained_; //是否开启分段模式
+    std::deque<Block> chain_; //buffer_之后的数据块，按顺序存放
+    size_t chainBytes_; //数据块链表上的可读数据总长度
+    char* spareBlock_; //readFd预备的空闲数据块，没用上就留着下次用
 }; 
\ No newline at end of file
@@ -0,0 +1,324 @@
+#include "BufferPool.h"
+#include "CurrentThread.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+const size_t BufferPool::kMaxChunkSize;
+const size_t BufferPool::kSlabSize;
+const size_t BufferPool::kHugePageSize;
+
+//计数只有loop线程在写，不需要lock前缀的原子加，读改写两步就够了
+template <typename T>
+static inline void bump(std::atomic<T> &counter, T delta)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+BufferPool::BufferPool()
+    :ownerTid_(CurrentThread::tid())
+    ,slabBytes_(0)
+    ,oversizeBytes_(0)
+    ,arena_(nullptr)
+    ,arenaBytes_(0)
+    ,arenaUsed_(0)
+    ,hugeTlb_(false)
+    ,remotePending_(false)
+    ,remoteFrees_(0)
+    ,trimmedBytes_(0)
+{
+    for(int i = 0; i < kNumClasses; ++i)
+    {
+        SizeClass &c = classes_[i];
+        c.remoteList = nullptr;
+        c.remoteCount = 0;
+        c.freedSinceTrim = 0;
+        c.inUse = 0;
+        c.freeChunks = 0;
+        c.allocs = 0;
+        c.refills = 0;
+    }
+}
+
+BufferPool::~BufferPool()
+{
+    for(char *slab : slabs_)
+    {
+        ::free(slab);
+    }
+    if(arena_ != nullptr)
+    {
+        ::munmap(arena_, arenaBytes_);
+    }
+}
+
+//返回能装下size的最小级别，调用前保证size <= kMaxChunkSize
+int BufferPool::classIndex(size_t size)
+{
+    int cls = 0;
+    size_t chunk = kMinChunkSize;
+    while(chunk < size)
+    {
+        chunk <<= 1;
+        ++cls;
+    }
+    return cls;
+}
+
+bool BufferPool::inOwnerThread() const
+{
+    return CurrentThread::tid() == ownerTid_;
+}
+
+char* BufferPool::allocate(size_t size, size_t *actual)
+{
+    if(size > kMaxChunkSize)
+    {
+        //大块内存用得少，直接malloc，malloc本身是线程安全的
+        char *p = static_cast<char*>(::malloc(size));
+        if(p == nullptr)
+        {
+            LOG_FATAL("BufferPool::allocate malloc %lu bytes failed \n", size);
+        }
+        oversizeBytes_.fetch_add(size, std::memory_order_relaxed);
+        *actual = size;
+        return p;
+    }
+
+    int cls = classIndex(size);
+    SizeClass &c = classes_[cls];
+    if(c.freeList.empty())
+    {
+        if(remotePending_.load(std::memory_order_acquire))
+        {
+            reclaimRemote();
+        }
+        if(c.freeList.empty())
+        {
+            refill(cls);
+        }
+    }
+
+    char *chunk = c.freeList.back();
+    c.freeList.pop_back();
+    bump(c.freeChunks, static_cast<size_t>(-1));
+    bump(c.inUse, static_cast<size_t>(1));
+    bump(c.allocs, static_cast<uint64_t>(1));
+    *actual = kMinChunkSize << cls;
+    return chunk;
+}
+
+void BufferPool::deallocate(char *p, size_t size)
+{
+    if(p == nullptr)
+    {
+        return;
+    }
+    if(size > kMaxChunkSize)
+    {
+        oversizeBytes_.fetch_sub(size, std::memory_order_relaxed);
+        ::free(p);
+        return;
+    }
+
+    int cls = classIndex(size);
+    SizeClass &c = classes_[cls];
+    if(CurrentThread::tid() == ownerTid_)
+    {
+        c.freeList.push_back(p);
+        ++c.freedSinceTrim;
+        bump(c.freeChunks, static_cast<size_t>(1));
+        bump(c.inUse, static_cast<size_t>(-1));
+    }
+    else
+    {
+        //比如用户在别的线程持有TcpConnectionPtr，最后一次引用在那个线程释放
+        FreeChunk *chunk = reinterpret_cast<FreeChunk*>(p);
+        std::unique_lock<std::mutex> lock(remoteMutex_);
+        chunk->next = c.remoteList;
+        c.remoteList = chunk;
+        ++c.remoteCount;
+        remotePending_.store(true, std::memory_order_release);
+        remoteFrees_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+//把其他线程释放的内存块收回到各自的空闲链表
+void BufferPool::reclaimRemote()
+{
+    std::unique_lock<std::mutex> lock(remoteMutex_);
+    for(int i = 0; i < kNumClasses; ++i)
+    {
+        SizeClass &c = classes_[i];
+        while(c.remoteList != nullptr)
+        {
+            FreeChunk *chunk = c.remoteList;
+            c.remoteList = chunk->next;
+            c.freeList.push_back(reinterpret_cast<char*>(chunk));
+        }
+        c.freedSinceTrim += c.remoteCount;
+        bump(c.freeChunks, c.remoteCount);
+        bump(c.inUse, static_cast<size_t>(0) - c.remoteCount);
+        c.remoteCount = 0;
+    }
+    remotePending_.store(false, std::memory_order_relaxed);
+}
+
+//切一个slab，优先从大页arena里拿
+char* BufferPool::newSlab()
+{
+    size_t used = arenaUsed_.load(std::memory_order_relaxed);
+    if(arena_ != nullptr && used + kSlabSize <= arenaBytes_)
+    {
+        arenaUsed_.store(used + kSlabSize, std::memory_order_relaxed);
+        return arena_ + used;
+    }
+    //按页对齐，trim的时候才能整页还给系统
+    void *slab = nullptr;
+    if(::posix_memalign(&slab, ::sysconf(_SC_PAGESIZE), kSlabSize) != 0)
+    {
+        LOG_FATAL("BufferPool::newSlab malloc %lu bytes failed \n", kSlabSize);
+    }
+    slabs_.push_back(static_cast<char*>(slab));
+    return static_cast<char*>(slab);
+}
+
+//空闲链表用完了，把一个slab切成这个级别大小的内存块挂上去
+void BufferPool::refill(int cls)
+{
+    SizeClass &c = classes_[cls];
+    const size_t chunkSize = kMinChunkSize << cls;
+    char *slab = newSlab();
+    bump(slabBytes_, kSlabSize);
+    bump(c.refills, static_cast<uint64_t>(1));
+
+    size_t count = kSlabSize / chunkSize;
+    //倒着压栈，先分配出去的是slab开头的内存块
+    for(size_t i = count; i > 0; --i)
+    {
+        c.freeList.push_back(slab + (i - 1) * chunkSize);
+    }
+    bump(c.freeChunks, count);
+}
+
+bool BufferPool::enableHugePageArena(size_t bytes)
+{
+    if(arena_ != nullptr)
+    {
+        return false;
+    }
+    size_t len = (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+    if(len == 0)
+    {
+        return false;
+    }
+
+    void *p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(p != MAP_FAILED)
+    {
+        hugeTlb_ = true;
+    }
+    else
+    {
+        //系统没有预留hugetlbfs大页，退回透明大页
+        p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(p == MAP_FAILED)
+        {
+            LOG_ERROR("BufferPool::enableHugePageArena mmap %lu bytes failed \n", len);
+            return false;
+        }
+        ::madvise(p, len, MADV_HUGEPAGE);
+    }
+    arena_ = static_cast<char*>(p);
+    arenaBytes_ = len;
+    LOG_INFO("BufferPool arena %lu bytes hugetlb=%d \n", len, hugeTlb_);
+    return true;
+}
+
+/**
+ * 把每个级别的空闲内存块按地址排序，找出完全被空闲内存块覆盖的整页，
+ * 连续的页合成一段，每段一次madvise。小于一页的级别要同一页上的内存块都空闲才能还
+ */
+void BufferPool::trim()
+{
+    if(remotePending_.load(std::memory_order_acquire))
+    {
+        reclaimRemote();
+    }
+
+    const uintptr_t pageSize = ::sysconf(_SC_PAGESIZE);
+    size_t trimmed = 0;
+    for(int i = 0; i < kNumClasses; ++i)
+    {
+        SizeClass &c = classes_[i];
+        if(c.freedSinceTrim == 0 || c.freeList.empty())
+        {
+            continue;
+        }
+        c.freedSinceTrim = 0;
+        const uintptr_t chunkSize = kMinChunkSize << i;
+
+        std::vector<char*> chunks(c.freeList);
+        std::sort(chunks.begin(), chunks.end());
+
+        //[runBegin, runEnd)是当前地址连续的一段空闲内存
+        uintptr_t runBegin = 0;
+        uintptr_t runEnd = 0;
+        for(size_t k = 0; k <= chunks.size(); ++k)
+        {
+            uintptr_t addr = k < chunks.size() ? reinterpret_cast<uintptr_t>(chunks[k]) : 0;
+            bool inArena = arena_ != nullptr
+                && addr >= reinterpret_cast<uintptr_t>(arena_)
+                && addr < reinterpret_cast<uintptr_t>(arena_) + arenaBytes_;
+            if(k < chunks.size() && !inArena && addr == runEnd)
+            {
+                runEnd += chunkSize;
+                continue;
+            }
+            //一段结束，把里面的整页还掉
+            uintptr_t first = (runBegin + pageSize - 1) & ~(pageSize - 1);
+            uintptr_t last = runEnd & ~(pageSize - 1);
+            if(last > first)
+            {
+                ::madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+                trimmed += last - first;
+            }
+            if(k < chunks.size() && !inArena)
+            {
+                runBegin = addr;
+                runEnd = addr + chunkSize;
+            }
+            else
+            {
+                runBegin = runEnd = 0;
+            }
+        }
+    }
+    trimmedBytes_.fetch_add(trimmed, std::memory_order_relaxed);
+}
+
+BufferPool::Stats BufferPool::stats() const
+{
+    Stats s;
+    for(int i = 0; i < kNumClasses; ++i)
+    {
+        const SizeClass &c = classes_[i];
+        s.classes[i].chunkSize = kMinChunkSize << i;
+        s.classes[i].inUse = c.inUse.load(std::memory_order_relaxed);
+        s.classes[i].freeChunks = c.freeChunks.load(std::memory_order_relaxed);
+        s.classes[i].allocs = c.allocs.load(std::memory_order_relaxed);
+        s.classes[i].refills = c.refills.load(std::memory_order_relaxed);
+    }
+    s.slabBytes = slabBytes_.load(std::memory_order_relaxed);
+    s.oversizeBytes = oversizeBytes_.load(std::memory_order_relaxed);
+    s.arenaBytes = arenaBytes_;
+    s.arenaUsed = arenaUsed_.load(std::memory_order_relaxed);
+    s.hugeTlb = hugeTlb_;
+    s.remoteFrees = remoteFrees_.load(std::memory_order_relaxed);
+    s.trimmedBytes = trimmedBytes_.load(std::memory_order_relaxed);
+    return s;
+}
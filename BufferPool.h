@@ -0,0 +1,111 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 每个EventLoop一个的Buffer内存池，按2的幂分成1K~64K七个大小级别
+ * 每个级别一个空闲栈，栈空了就从slab(256K)里切一批同样大小的内存块出来
+ * 大于64K的请求直接走malloc。空闲栈放在内存块外面，trim()把整页空闲的内存还给系统以后
+ * 内存块还能留在栈上继续用，再次使用时由缺页重新分配
+ *
+ * 内存池只在所属loop线程里分配，其他线程释放的内存块先挂到remote链表上(加锁)，
+ * loop线程下次分配时再收回来。统计信息可以在任何线程读取
+ * EventLoop和它的Buffer用shared_ptr共同持有内存池，loop析构以后还活着的Buffer照样能把内存还回来
+ */
+class BufferPool : noncopyable
+{
+public:
+    static const int kNumClasses = 7;
+    static const size_t kMinChunkSize = 1024;
+    static const size_t kMaxChunkSize = kMinChunkSize << (kNumClasses - 1); // 64K
+    static const size_t kSlabSize = 256 * 1024;
+    static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+    struct ClassStats
+    {
+        size_t chunkSize;   //内存块大小
+        size_t inUse;       //正在被Buffer使用的内存块个数
+        size_t freeChunks;  //空闲链表上的内存块个数
+        uint64_t allocs;    //累计分配次数
+        uint64_t refills;   //空闲链表为空、需要切新slab的次数
+    };
+
+    struct Stats
+    {
+        ClassStats classes[kNumClasses];
+        size_t slabBytes;       //从系统拿到的slab总字节数(含大页arena里切出来的)
+        size_t oversizeBytes;   //当前正在使用的、超过64K直接malloc的字节数
+        size_t arenaBytes;      //大页arena的大小，0表示没开启
+        size_t arenaUsed;       //arena已经切出去的字节数
+        bool hugeTlb;           //arena是否真的拿到了MAP_HUGETLB大页，否则是透明大页
+        uint64_t remoteFrees;   //其他线程释放的内存块个数
+        uint64_t trimmedBytes;  //trim()累计还给系统的字节数
+    };
+
+    BufferPool();
+    ~BufferPool();
+
+    //当前线程是不是创建内存池的loop线程，只有这个线程能allocate
+    bool inOwnerThread() const;
+    //分配至少size字节的内存，*actual返回实际可用的大小(向上取整到级别大小)
+    char* allocate(size_t size, size_t *actual);
+    //size必须是allocate返回的*actual
+    void deallocate(char *p, size_t size);
+
+    //预留bytes字节(按2M取整)的大页内存，之后的slab优先从这里切，减少TLB miss
+    //MAP_HUGETLB失败时退回普通mmap+MADV_HUGEPAGE，需要在loop线程分配内存之前调用
+    bool enableHugePageArena(size_t bytes);
+
+    //把空闲内存块里整页空闲的部分madvise(MADV_DONTNEED)还给系统，只能在loop线程调用
+    //空闲连接回收Buffer以后调用，RSS才会真的降下来。大页arena里的内存不处理
+    void trim();
+
+    Stats stats() const;
+
+private:
+    struct FreeChunk
+    {
+        FreeChunk *next;
+    };
+
+    struct SizeClass
+    {
+        std::vector<char*> freeList;
+        FreeChunk *remoteList;  //其他线程释放的，受remoteMutex_保护
+        size_t remoteCount;
+        size_t freedSinceTrim;  //上次trim以后释放的个数，为0就不用再trim
+        //下面的计数只有loop线程写，用relaxed原子变量是为了其他线程能读
+        std::atomic<size_t> inUse;
+        std::atomic<size_t> freeChunks;
+        std::atomic<uint64_t> allocs;
+        std::atomic<uint64_t> refills;
+    };
+
+    static int classIndex(size_t size);
+    void refill(int cls);
+    void reclaimRemote();
+    char* newSlab();
+
+    const int ownerTid_;
+    SizeClass classes_[kNumClasses];
+
+    std::vector<char*> slabs_;  //malloc出来的slab，析构时释放
+    std::atomic<size_t> slabBytes_;
+    std::atomic<size_t> oversizeBytes_;
+
+    char *arena_;
+    size_t arenaBytes_;
+    std::atomic<size_t> arenaUsed_;
+    bool hugeTlb_;
+
+    std::mutex remoteMutex_;
+    std::atomic_bool remotePending_;
+    std::atomic<uint64_t> remoteFrees_;
+    std::atomic<uint64_t> trimmedBytes_;
+};
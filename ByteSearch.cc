@@ -0,0 +1,210 @@
+#include "ByteSearch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BYTESEARCH_X86 1
+#endif
+
+namespace
+{
+typedef const char* (*FindCharFunc)(const char*, const char*, char);
+typedef const char* (*FindCRLFFunc)(const char*, const char*);
+
+const char* findCharScalar(const char* begin, const char* end, char c)
+{
+    for(const char* p = begin; p < end; ++p)
+    {
+        if(*p == c)
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+const char* findCRLFScalar(const char* begin, const char* end)
+{
+    for(const char* p = begin; p + 1 < end; ++p)
+    {
+        if(p[0] == '\r' && p[1] == '\n')
+        {
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+#ifdef BYTESEARCH_X86
+/**
+ * 一次比较16/32个字节，比较结果压成位掩码，最低的置位就是第一个匹配的位置
+ * 找CRLF时把p和p+1各加载一次，'\r'的掩码和'\n'的掩码按位与，
+ * 所以要保证p+1开始的那次加载不越界，剩下不足一个向量的尾巴交给逐字节实现
+ */
+const char* findCharSSE2(const char* begin, const char* end, char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    const char* p = begin;
+    for(; p + 16 <= end; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+        if(mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findCharScalar(p, end, c);
+}
+
+const char* findCRLFSSE2(const char* begin, const char* end)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const char* p = begin;
+    for(; p + 17 <= end; p += 16)
+    {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(v0, cr), _mm_cmpeq_epi8(v1, lf)));
+        if(mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findCRLFScalar(p, end);
+}
+
+__attribute__((target("avx2")))
+const char* findCharAVX2(const char* begin, const char* end, char c)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+    const char* p = begin;
+    for(; p + 32 <= end; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+        if(mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findCharSSE2(p, end, c);
+}
+
+__attribute__((target("avx2")))
+const char* findCRLFAVX2(const char* begin, const char* end)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const char* p = begin;
+    for(; p + 33 <= end; p += 32)
+    {
+        __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(v0, cr), _mm256_cmpeq_epi8(v1, lf))));
+        if(mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return findCRLFSSE2(p, end);
+}
+#endif
+
+bool isaSupported(ByteSearch::Isa isa)
+{
+    switch(isa)
+    {
+    case ByteSearch::kScalar:
+        return true;
+#ifdef BYTESEARCH_X86
+    case ByteSearch::kSSE2:
+        return __builtin_cpu_supports("sse2");
+    case ByteSearch::kAVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+struct Kernels
+{
+    ByteSearch::Isa isa;
+    FindCharFunc findChar;
+    FindCRLFFunc findCRLF;
+};
+
+Kernels makeKernels(ByteSearch::Isa isa)
+{
+    Kernels k;
+    k.isa = isa;
+    k.findChar = findCharScalar;
+    k.findCRLF = findCRLFScalar;
+#ifdef BYTESEARCH_X86
+    if(isa == ByteSearch::kSSE2)
+    {
+        k.findChar = findCharSSE2;
+        k.findCRLF = findCRLFSSE2;
+    }
+    else if(isa == ByteSearch::kAVX2)
+    {
+        k.findChar = findCharAVX2;
+        k.findCRLF = findCRLFAVX2;
+    }
+#endif
+    return k;
+}
+
+//函数内的静态变量第一次调用时初始化，不依赖全局对象的构造顺序
+Kernels& kernels()
+{
+    static Kernels k = makeKernels(
+        isaSupported(ByteSearch::kAVX2) ? ByteSearch::kAVX2
+        : isaSupported(ByteSearch::kSSE2) ? ByteSearch::kSSE2
+        : ByteSearch::kScalar);
+    return k;
+}
+}
+
+namespace ByteSearch
+{
+    const char* findChar(const char* begin, const char* end, char c)
+    {
+        return kernels().findChar(begin, end, c);
+    }
+
+    const char* findCRLF(const char* begin, const char* end)
+    {
+        return kernels().findCRLF(begin, end);
+    }
+
+    Isa activeIsa()
+    {
+        return kernels().isa;
+    }
+
+    const char* isaName(Isa isa)
+    {
+        switch(isa)
+        {
+        case kSSE2:
+            return "sse2";
+        case kAVX2:
+            return "avx2";
+        default:
+            return "scalar";
+        }
+    }
+
+    bool setIsa(Isa isa)
+    {
+        if(!isaSupported(isa))
+        {
+            return false;
+        }
+        kernels() = makeKernels(isa);
+        return true;
+    }
+}
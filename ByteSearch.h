@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Buffer里查找分隔符用的字节搜索，x86上有SSE2和AVX2两套实现，
+ * 第一次使用时按CPU支持的指令集选最快的一套，其他平台用逐字节的实现
+ * 所有函数在[begin, end)里找，找不到返回nullptr
+ */
+namespace ByteSearch
+{
+    enum Isa
+    {
+        kScalar,
+        kSSE2,
+        kAVX2,
+    };
+
+    const char* findChar(const char* begin, const char* end, char c);
+    //找"\r\n"，返回'\r'的位置
+    const char* findCRLF(const char* begin, const char* end);
+
+    Isa activeIsa();
+    const char* isaName(Isa isa);
+    //强制换成某一套实现，给测试和benchmark用，CPU不支持返回false。切换时不能有其他线程在搜索
+    bool setIsa(Isa isa);
+}
@@ -23,4 +23,5 @@ using MessageCallback = std::function<void(const TcpConnectionPtr&,
  * 这样数据发送出错的概率是非常小的，所以这里有个高水位控制，
  * 到达水位线了就会暂停发送
  */
-using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
\ No newline at end of file
+using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
+using TimerCallback = std::function<void()>;
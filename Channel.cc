@@ -2,6 +2,7 @@
 #include "EventLoop.h"
 #include "Logger.h"
 #include "Poller.h"
+#include "LoopWatchdog.h"
 
 #include <sys/epoll.h>
 
@@ -11,7 +12,9 @@ const int Channel::kWriteEvent = EPOLLOUT;   //epoll的表示
 
 //EventLoop底层: ChannelList  Poller 每个channel属于1个loop 
 Channel::Channel(EventLoop *loop,int fd)
-    :loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false)
+    :loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1)
+    , edgeTriggered_(false), exclusive_(false), updatePending_(false), asyncDone_(0), recvResult_(0), sendResult_(0)
+    , watchOwner_("Channel"), watchName_(nullptr), tied_(false)
 {}
 
 //析构函数
@@ -57,29 +60,51 @@ void Channel::handleEvent(Timestamp receiveTime){
 //根据poller通知的channel发生的具体事件， 由channel负责调用具体的回调操作
 void Channel::handleEventWithGuard(Timestamp receiveTime){
     LOG_INFO("channel handleEvent revent:%d\n",revents_);
+    //每个回调前后更新一次心跳，LoopWatchdog据此发现卡在哪个回调里
+    LoopHeartbeat &heartbeat = *loop_->heartbeat();
 
     if((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN)){
         if(closeCallback_){
+            LoopHeartbeat::Scope watch(heartbeat, watchOwner_, "close", watchName_);
             closeCallback_();
         }
     }
 
     if(revents_ & EPOLLERR){
         if(errorCallback_){
+            LoopHeartbeat::Scope watch(heartbeat, watchOwner_, "error", watchName_);
             errorCallback_();
         }
     }
 
     if(revents_ & (EPOLLIN|EPOLLPRI)){
         if(readCallback_){
+            LoopHeartbeat::Scope watch(heartbeat, watchOwner_, "read", watchName_);
             readCallback_(receiveTime);
         }
     }
     
     if(revents_ & EPOLLOUT){
         if(writeCallback_){
+            LoopHeartbeat::Scope watch(heartbeat, watchOwner_, "write", watchName_);
             writeCallback_();
         }
     }
+
+    //回调里可能马上提交下一次请求，先清掉标志
+    if(asyncDone_ & kRecvDone){
+        asyncDone_ &= ~kRecvDone;
+        if(asyncRecvCallback_){
+            LoopHeartbeat::Scope watch(heartbeat, watchOwner_, "asyncRecv", watchName_);
+            asyncRecvCallback_(recvResult_, receiveTime);
+        }
+    }
+    if(asyncDone_ & kSendDone){
+        asyncDone_ &= ~kSendDone;
+        if(asyncSendCallback_){
+            LoopHeartbeat::Scope watch(heartbeat, watchOwner_, "asyncSend", watchName_);
+            asyncSendCallback_(sendResult_, receiveTime);
+        }
+    }
 }
 
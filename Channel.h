@@ -2,9 +2,12 @@
 
 #include "noncopyable.h"
 #include "Timestamp.h"
+#include "Task.h"
 
 #include<functional>
 #include<memory>
+#include<string>
+#include<sys/types.h>
 
 class EventLoop;
 
@@ -16,8 +19,10 @@ channel理解为通道，封装了sockfd和其感兴趣的event,如EPOLLIN、EPO
 class Channel : noncopyable
 {
 public:
-    using EventCallback = std::function<void()>;    //事件回调
-    using ReadEventCallback = std::function<void(Timestamp)>;   //只读事件回调
+    //回调只能移动，bind成员函数和this放在Task内部，每个Channel设置回调不用分配内存
+    using EventCallback = Task<void()>;    //事件回调
+    using ReadEventCallback = Task<void(Timestamp)>;   //只读事件回调
+    using AsyncIoCallback = Task<void(ssize_t, Timestamp)>;  //异步recv/send完成回调，参数是字节数或者-errno
     
     Channel(EventLoop *loop,int fd);
     ~Channel();
@@ -37,13 +42,27 @@ public:
     void setWriteCallBack(EventCallback cb) { writeCallback_ = std::move(cb); }
     void setCloseCallBack(EventCallback cb) { closeCallback_ = std::move(cb); }
     void setErrorCallBack(EventCallback cb) { errorCallback_ = std::move(cb); }
+    void setAsyncRecvCallBack(AsyncIoCallback cb) { asyncRecvCallback_ = std::move(cb); }
+    void setAsyncSendCallBack(AsyncIoCallback cb) { asyncSendCallback_ = std::move(cb); }
+
+    //LoopWatchdog报告卡住的回调时用的名字，owner是字符串字面量，name一般指向TcpConnection::name_，要比Channel活得久
+    void setWatchName(const char *owner, const std::string *name = nullptr)
+    {
+        watchOwner_ = owner;
+        watchName_ = name;
+    }
 
     //防止当channel被手动remove掉，channel还在执行回调操作
     void tie(const std::shared_ptr<void>&);
+    //绑定的对象，已经析构或者没有绑定返回空，异步IO在内核里的时候Poller用它保活
+    std::shared_ptr<void> tiedObject() const { return tie_.lock(); }
 
     int fd() const { return fd_; }
     int events() const { return events_; } //fd所感兴趣的事件
     void set_events(int revt) { revents_ = revt; } //poller监听事件，设置了channel的fd相应事件 
+    //poller带回异步recv/send的结果，和revents_一起在handleEvent里处理
+    void set_recvResult(ssize_t res) { recvResult_ = res; asyncDone_ |= kRecvDone; }
+    void set_sendResult(ssize_t res) { sendResult_ = res; asyncDone_ |= kSendDone; }
 
     //设置fd相应的事件状态，要让fd对这个事件感兴趣 
     //update就是调用epoll_ctrl，通知poller把fd感兴趣的事件添加到fd上
@@ -52,6 +71,26 @@ public:
     void enableWriting() { events_ |= kWriteEvent; update(); }
     void disableWriting() { events_ &= ~kWriteEvent; update(); }
     void disableAll() {events_ = kNoneEvent; update(); }
+    /**
+     * 边沿触发：fd状态变化时才通知一次，回调必须一直读写到EAGAIN，否则剩下的数据不会再有事件
+     * 数据一直读不完或者EPOLLOUT一直关注着的fd，不会每一轮epoll_wait都把loop唤醒
+     */
+    void setEdgeTriggered(bool on)
+    {
+        edgeTriggered_ = on;
+        if(!isNoneEvent())
+        {
+            update();
+        }
+    }
+    bool edgeTriggered() const { return edgeTriggered_; }
+    /**
+     * EPOLLEXCLUSIVE：同一个fd加到多个epoll里时，事件到来只唤醒其中一个(或几个)，不会所有loop一起被叫醒
+     * 只在EPOLL_CTL_ADD时生效，注册以后再改事件EPollPoller会先删再加；io_uring的Poller忽略这个标志
+     * 在注册到Poller之前设置
+     */
+    void setExclusive(bool on) { exclusive_ = on; }
+    bool exclusive() const { return exclusive_; }
     
 
     //返回fd当前的事件状态
@@ -62,6 +101,10 @@ public:
     int index() { return index_; }
     void set_index(int idx) { index_ = idx; }
 
+    //EventLoop攒着还没交给Poller的事件修改，见EventLoop::updateChannel
+    bool updatePending() const { return updatePending_; }
+    void set_updatePending(bool on) { updatePending_ = on; }
+
     //one loop per thread
     EventLoop* ownerLoop() { return loop_; }//当前channel属于哪个eventloop 
     void remove();//删除channel
@@ -76,11 +119,23 @@ private:
     static const int kReadEvent;    //读事件
     static const int kWriteEvent;   //写事件
 
+    //asyncDone_的位
+    static const int kRecvDone = 1;
+    static const int kSendDone = 2;
+
     EventLoop *loop_;   //事件循环
     const int fd_;  //fd,poller监听的对象
     int events_;    //注册fd感兴趣的事件
     int revents_;   //poller返回的具体发生的事件
     int index_; //初始化为-1，用于标识channel的状态
+    bool edgeTriggered_;
+    bool exclusive_;
+    bool updatePending_;
+    int asyncDone_; //哪些异步IO有结果了
+    ssize_t recvResult_;
+    ssize_t sendResult_;
+    const char *watchOwner_;
+    const std::string *watchName_;
 
     /*
     防止手动调用removeChannel，Channel被手动remove以后我们还在使用Channel，
@@ -95,4 +150,6 @@ private:
     EventCallback writeCallback_;
     EventCallback closeCallback_;
     EventCallback errorCallback_;
+    AsyncIoCallback asyncRecvCallback_;
+    AsyncIoCallback asyncSendCallback_;
 };
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "CpuAffinity.h"
+#include "Logger.h"
+#include "CurrentThread.h"
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+static const char kCpuRoot[] = "/sys/devices/system/cpu";
+static const char kNodeRoot[] = "/sys/devices/system/node";
+
+//读一行，文件不存在返回空串
+static std::string readLine(const std::string &path)
+{
+    std::ifstream in(path.c_str());
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+std::vector<int> CpuAffinity::parseCpuList(const std::string &list)
+{
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while(pos < list.size())
+    {
+        size_t end = list.find(',', pos);
+        if(end == std::string::npos)
+        {
+            end = list.size();
+        }
+        std::string item = list.substr(pos, end - pos);
+        pos = end + 1;
+
+        int first = 0;
+        int last = 0;
+        int n = ::sscanf(item.c_str(), "%d-%d", &first, &last);
+        if(n == 1)
+        {
+            last = first;
+        }
+        else if(n != 2)
+        {
+            continue;
+        }
+        if(first < 0 || last >= CPU_SETSIZE)
+        {
+            //cpu_set_t只放得下CPU_SETSIZE个CPU，超出的编号CPU_SET会写越界
+            LOG_ERROR("CpuAffinity cpu list item \"%s\" out of range [0, %d) \n", item.c_str(), CPU_SETSIZE);
+            continue;
+        }
+        for(int cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+int CpuAffinity::numaNodeOf(int cpu)
+{
+    std::vector<int> nodes = parseCpuList(readLine(std::string(kNodeRoot) + "/online"));
+    for(int node : nodes)
+    {
+        char path[128];
+        ::snprintf(path, sizeof path, "%s/node%d/cpulist", kNodeRoot, node);
+        std::vector<int> cpus = parseCpuList(readLine(path));
+        if(std::find(cpus.begin(), cpus.end(), cpu) != cpus.end())
+        {
+            return node;
+        }
+    }
+    return -1;
+}
+
+std::vector<int> CpuAffinity::autoPlacement(int count)
+{
+    std::vector<int> placement;
+    if(count <= 0)
+    {
+        return placement;
+    }
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(::sched_getaffinity(0, sizeof allowed, &allowed) < 0)
+    {
+        LOG_ERROR("sched_getaffinity errno=%d \n", errno);
+        return placement;
+    }
+    std::vector<int> isolated = parseCpuList(readLine(std::string(kCpuRoot) + "/isolated"));
+    std::set<int> skip(isolated.begin(), isolated.end());
+
+    //每个NUMA节点一个列表，先放物理核(超线程里编号最小的)，剩下的超线程放到spare里
+    std::vector<std::vector<int>> cores;
+    std::vector<int> spare;
+    std::vector<int> nodeIndex;  //NUMA节点号 -> cores的下标
+    for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if(!CPU_ISSET(cpu, &allowed) || skip.count(cpu) > 0)
+        {
+            continue;
+        }
+        char path[128];
+        ::snprintf(path, sizeof path, "%s/cpu%d/topology/thread_siblings_list", kCpuRoot, cpu);
+        std::vector<int> siblings = parseCpuList(readLine(path));
+        bool primary = true;
+        for(int sibling : siblings)
+        {
+            if(sibling < cpu && CPU_ISSET(sibling, &allowed) && skip.count(sibling) == 0)
+            {
+                primary = false;
+                break;
+            }
+        }
+        if(!primary)
+        {
+            spare.push_back(cpu);
+            continue;
+        }
+        int node = std::max(numaNodeOf(cpu), 0);
+        if(node >= static_cast<int>(nodeIndex.size()))
+        {
+            nodeIndex.resize(node + 1, -1);
+        }
+        if(nodeIndex[node] < 0)
+        {
+            nodeIndex[node] = static_cast<int>(cores.size());
+            cores.push_back(std::vector<int>());
+        }
+        cores[nodeIndex[node]].push_back(cpu);
+    }
+
+    //各个节点轮流取一个物理核
+    std::vector<int> order;
+    for(size_t i = 0; ; ++i)
+    {
+        bool any = false;
+        for(const std::vector<int> &node : cores)
+        {
+            if(i < node.size())
+            {
+                order.push_back(node[i]);
+                any = true;
+            }
+        }
+        if(!any)
+        {
+            break;
+        }
+    }
+    order.insert(order.end(), spare.begin(), spare.end());
+    if(order.empty())
+    {
+        return placement;
+    }
+    for(int i = 0; i < count; ++i)
+    {
+        placement.push_back(order[i % order.size()]);
+    }
+    return placement;
+}
+
+bool CpuAffinity::bindCurrentThread(int cpu)
+{
+    if(cpu < 0 || cpu >= CPU_SETSIZE)
+    {
+        LOG_ERROR("CpuAffinity::bindCurrentThread cpu=%d out of range [0, %d) \n", cpu, CPU_SETSIZE);
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if(::sched_setaffinity(0, sizeof set, &set) < 0)
+    {
+        LOG_ERROR("sched_setaffinity cpu=%d errno=%d \n", cpu, errno);
+        return false;
+    }
+
+    //只有一个节点的机器上没必要
+    std::vector<int> nodes = parseCpuList(readLine(std::string(kNodeRoot) + "/online"));
+    int node = numaNodeOf(cpu);
+    if(nodes.size() > 1 && node >= 0)
+    {
+        unsigned long mask[16] = {0};
+        const int bitsPerWord = 8 * sizeof(unsigned long);
+        if(node < static_cast<int>(sizeof mask * 8))
+        {
+            mask[node / bitsPerWord] |= 1UL << (node % bitsPerWord);
+            if(::syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof mask * 8) < 0)
+            {
+                LOG_ERROR("set_mempolicy node=%d errno=%d \n", node, errno);
+            }
+        }
+    }
+    LOG_INFO("thread %d bound to cpu %d numa node %d \n", CurrentThread::tid(), cpu, node);
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * loop线程绑核和NUMA就近分配内存的辅助函数，拓扑从/sys/devices/system下读，不依赖libnuma
+ *
+ * 线程先绑核、再把内存策略设成优先用本节点，之后再构造EventLoop：Poller的数组、BufferPool的slab、
+ * 线程自己的malloc arena都是这个线程第一次访问的，页面会落在本节点上
+ */
+class CpuAffinity
+{
+public:
+    //解析"0-3,8,10-11"这种CPU列表，格式不对的、超出[0, CPU_SETSIZE)的部分打日志跳过
+    static std::vector<int> parseCpuList(const std::string &list);
+
+    //cpu所在的NUMA节点，没有NUMA信息的时候返回-1
+    static int numaNodeOf(int cpu);
+
+    /**
+     * auto策略，返回count个CPU：
+     * 从进程允许使用的CPU(sched_getaffinity，taskset/cgroup限制的)里去掉isolcpus，
+     * 每个物理核只取编号最小的一个超线程，NUMA节点之间轮流取，把loop分散到各个节点的物理核上
+     * 物理核不够用再用剩下的超线程，还不够就从头循环
+     */
+    static std::vector<int> autoPlacement(int count);
+
+    //当前线程绑到cpu上，多NUMA节点的机器上再把内存分配策略设成优先本节点(MPOL_PREFERRED)，cpu超出范围返回false
+    static bool bindCurrentThread(int cpu);
+};
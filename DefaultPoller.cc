@@ -1,13 +1,38 @@
 #include "Poller.h"
 #include "EPollPoller.h"
+#include "UringPoller.h"
+#include "EventLoop.h"
+#include "Logger.h"
 
 #include<stdlib.h>
+#include<string.h>
 
-Poller* Poller::newDefaultPoller(EventLoop *loop){
-    if(::getenv("MUDUO_USE_POLL")){
-        return nullptr; //生成poll的实例
+/**
+ * 环境变量MUDUO_USE_URING选择io_uring：
+ *   "1"或"poll"  只用io_uring代替epoll等待事件
+ *   "rw"         TcpConnection的recv/send也通过io_uring提交
+ * EventLoop构造时明确指定了类型的话以构造参数为准
+ */
+Poller* Poller::newDefaultPoller(EventLoop *loop, int type){
+    if(type == EventLoop::kDefaultPoller){
+        const char *uring = ::getenv("MUDUO_USE_URING");
+        if(uring && ::strcmp(uring, "rw") == 0){
+            type = EventLoop::kUringReadWritePoller;
+        }
+        else if(uring && (::strcmp(uring, "1") == 0 || ::strcmp(uring, "poll") == 0)){
+            type = EventLoop::kUringPoller;
+        }
+        else if(::getenv("MUDUO_USE_POLL")){
+            LOG_INFO("MUDUO_USE_POLL: poll(2) is not implemented, using epoll \n");
+        }
     }
-    else{
-        return new EPollPoller(loop); //生成epoll实例
+
+    if(type == EventLoop::kUringPoller || type == EventLoop::kUringReadWritePoller){
+        Poller *poller = UringPoller::create(loop, type == EventLoop::kUringReadWritePoller);
+        if(poller){
+            return poller;
+        }
+        LOG_ERROR("io_uring is not available, falling back to epoll \n");
     }
-}
\ No newline at end of file
+    return new EPollPoller(loop); //生成epoll实例
+}
@@ -29,7 +29,10 @@ EPollPoller::~EPollPoller()
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
     //实际上应该用LOG_DEBUG输出日志更合理,可以设置开启或者不开启 
-    LOG_INFO("func=%s fd total count:%ld\n",__FUNCTION__,channels_.size());
+    if(timeoutMs != 0) //忙轮询的时候一秒钟要转几十万次，只在会阻塞的poll上打
+    {
+        LOG_INFO("func=%s fd total count:%ld\n",__FUNCTION__,channels_.size());
+    }
     //对poll的执行效率有所影响
     int numEvents = ::epoll_wait(epollfd_,&*events_.begin(),static_cast<int>(events_.size()),timeoutMs);
     //events_.begin()返回首元素的迭代器（数组），也就是首元素的地址，是面向对象的，要解引用，就是首元素的值，然后取地址 
@@ -82,23 +85,36 @@ void EPollPoller::updateChannel(Channel* channel)
         if(index == kNew) //未添加，键值对写入map中 
         {
             int fd = channel->fd();
-            channels_[fd] = channel;
+            channels_.set(fd, channel);
+        }
+        if(channel->isNoneEvent()) //修改合并以后什么事件都不关注，先不加到epoll里
+        {
+            channel->set_index(kDeleted);
+            return;
         }
         channel->set_index(kAdded);
         update(EPOLL_CTL_ADD,channel); //相当于调用epoll_ctl，添加1个channel到epoll中 
     }
     else //channel已经在poller上注册过了
     {
-        int fd = channel->fd();
-        if(channels_[fd]->isNoneEvent()) //已经对任何事件不感兴趣，不需要poller帮忙监听了 
+        if(channel->isNoneEvent()) //已经对任何事件不感兴趣，不需要poller帮忙监听了 
         {
             channel->set_index(kDeleted);
             update(EPOLL_CTL_DEL,channel);
         }
-        else
+        else if(epollEvents(channel) != registered_[channel->fd()])
         {
-            update(EPOLL_CTL_MOD,channel); //包含了fd的事件，感兴趣 
+            if(channel->exclusive()) //带EPOLLEXCLUSIVE的fd不能EPOLL_CTL_MOD，只能删了重新加
+            {
+                update(EPOLL_CTL_DEL,channel);
+                update(EPOLL_CTL_ADD,channel);
+            }
+            else
+            {
+                update(EPOLL_CTL_MOD,channel); //包含了fd的事件，感兴趣 
+            }
         }
+        //感兴趣的事件和内核里登记的一样，不用epoll_ctl
     }
 }
 //从Poller中删除Channel
@@ -132,10 +148,16 @@ void EPollPoller::update(int operation,Channel *channel)
     epoll_event event;
     bzero(&event,sizeof event);
     int fd = channel->fd();
-    event.events = channel->events(); //返回的就是fd所感兴趣的事件 
+    event.events = epollEvents(channel); //返回的就是fd所感兴趣的事件 
     event.data.fd = fd;
     event.data.ptr = channel;//绑定的参数
     
+    if(static_cast<size_t>(fd) >= registered_.size())
+    {
+        registered_.resize(fd + 1, 0);
+    }
+    registered_[fd] = operation == EPOLL_CTL_DEL ? 0 : event.events;
+
     if(::epoll_ctl(epollfd_,operation,fd,&event) < 0) //把fd相关事件更改 
     {
         if(operation == EPOLL_CTL_DEL) //没有删掉
@@ -148,3 +170,18 @@ void EPollPoller::update(int operation,Channel *channel)
         }
     }
 }
+
+uint32_t EPollPoller::epollEvents(Channel *channel)
+{
+    uint32_t events = channel->events();
+    if(channel->edgeTriggered())
+    {
+        events |= EPOLLET;
+    }
+    if(channel->exclusive())
+    {
+        //EPOLLEXCLUSIVE只能和EPOLLIN/EPOLLOUT/EPOLLET这些一起用，带着EPOLLPRI会EINVAL
+        events = (events & ~EPOLLPRI) | EPOLLEXCLUSIVE;
+    }
+    return events;
+}
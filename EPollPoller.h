@@ -36,7 +36,10 @@ private:
     void fillActiveChannels(int numEvents,ChannelList *activeChannels) const;
     //更新Channel通道
     void update(int operation,Channel *channel);
+    //Channel交给epoll的事件(包括EPOLLET、EPOLLEXCLUSIVE)
+    static uint32_t epollEvents(Channel *channel);
 
     int epollfd_;
     EventList events_;//epoll_wait的第二个参数 
+    std::vector<uint32_t> registered_; //按fd下标记录内核里现在登记的事件，没变就不用EPOLL_CTL_MOD
 };
\ No newline at end of file
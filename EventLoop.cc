@@ -3,19 +3,26 @@
 #include<fcntl.h>
 #include<errno.h>
 #include<memory.h>
+#include<algorithm>
 
 #include "EventLoop.h"
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "BufferPool.h"
+#include "TimerQueue.h"
+#include "TimingWheel.h"
+#include "LoopWatchdog.h"
 
 //防止一个线程创建多个eventloop   
 //__thread：就是thread_local机制，如果不加就是全局变量，所有线程所共享，我们要一个线程就有一个eventloop
 //当一个eventloop创建起来它就指向那个对象，在一个线程里再去创建一个对象，由于这个指针为空，就不创建 
 __thread EventLoop *t_loopInThisThread = nullptr;
 
-//定义默认的Poller IO复用接口的超时时间
+//定义默认的Poller IO复用接口的超时时间，定时器走timerfd，不靠这个超时
 const int kPollTimeMs = 10000;//10s
+//定期维护操作的间隔
+const double kHousekeepingSeconds = 1.0;
 
 //创建wakeupfd，用notify唤醒subReactor处理新来的channel
 int createEventfd()
@@ -29,14 +36,22 @@ int createEventfd()
     return evtfd;
 }
 
-EventLoop::EventLoop()
+EventLoop::EventLoop(PollerType type)
     :looping_(false)
     ,quit_(false)
-    ,callingPendingFunctors_(false)
     ,threadId_(CurrentThread::tid())
-    ,poller_(Poller::newDefaultPoller(this))
+    ,bufferPool_(new BufferPool())
+    ,poller_(Poller::newDefaultPoller(this, type))
     ,wakeupFd_(createEventfd())
     ,wakeupChannel_(new Channel(this,wakeupFd_))
+    ,timerQueue_(new TimerQueue(this))
+    ,callingPendingFunctors_(false)
+    ,wakeupPending_(false)
+    ,busyPollWindowUs_(0)
+    ,socketBusyPollUs_(0)
+    ,spinning_(false)
+    ,numConnections_(0)
+    ,heartbeat_(new LoopHeartbeat(this, threadId_))
 {
     LOG_DEBUG("EventLoop created %p in thread %d \n", this,threadId_);
     if(t_loopInThisThread)//这个线程已经有loop了，就不创建了 
@@ -50,6 +65,7 @@ EventLoop::EventLoop()
 
     //设置wakeup的事件类型以及发生事件后的回调操作
     wakeupChannel_->setReadCallBack(std::bind(&EventLoop::handleRead,this));
+    wakeupChannel_->setWatchName("EventLoop");
     //每一个eventloop都将监听wakeupchannel的Epollin读事件了
     wakeupChannel_->enableReading();
 }
@@ -68,16 +84,35 @@ void EventLoop::loop()
     quit_ = false;
     LOG_INFO("EventLoop %p start looping \n", this);
 
+#ifdef MUDUO_LOOP_PROFILING
+    int64_t iterationEnd = 0; //上一轮统计结束的时间直接当这一轮的开始，每轮少取一次时间
+#endif
     while(!quit_)
     {
+#ifdef MUDUO_LOOP_PROFILING
+        //poll的时间里包括把攒下的Channel修改交给Poller(epoll_ctl)
+        const bool profiling = profiler_.enabled();
+        int64_t pollStart = iterationEnd;
+        if(profiling && pollStart == 0)
+        {
+            pollStart = LoopProfiler::now();
+        }
+#endif
         activeChannels_.clear();
+        applyChannelUpdates();
         //监听两类fd，一种是client的fd,一种是wakeup的fd
-        pollReturnTime_ = poller_->poll(kPollTimeMs,&activeChannels_);
+        pollReturnTime_ = poller_->poll(pollTimeoutMs(), &activeChannels_);
+#ifdef MUDUO_LOOP_PROFILING
+        int64_t dispatchStart = profiling ? LoopProfiler::now() : 0;
+#endif
         for(Channel* channel : activeChannels_)
         {
             //Poller可以监听哪些channel发生事件了，然后上报给EventLoop,EventLoop通知channel处理相应的事件
             channel->handleEvent(pollReturnTime_);
         }
+#ifdef MUDUO_LOOP_PROFILING
+        int64_t functorStart = profiling ? LoopProfiler::now() : 0;
+#endif
         //执行当前EventLoop需要处理的回调操作
         /**
          * IO线程就是mainLoop(mainreactor)，主要做的是accept接收新用户的连接，接收新用户的连接以后，accept会返回和客户端专门通信用的fd
@@ -88,8 +123,22 @@ void EventLoop::loop()
          * subloop唤醒)，要执行回调，回调都在pendingFunctors_里写的，回调就是谁唤醒你让你做事情的，做什么事情呢，mainloop要事先注册一个回调cb
          * 所以mainloop唤醒subloop以后，执行下面的方法，执行之前mainloop注册的cb
          */
-        doPendingFunctors();
+        size_t numFunctors = doPendingFunctors();
+#ifdef MUDUO_LOOP_PROFILING
+        iterationEnd = 0;
+        if(profiling)
+        {
+            iterationEnd = LoopProfiler::now();
+            profiler_.record(dispatchStart - pollStart, functorStart - dispatchStart, iterationEnd - functorStart,
+                             activeChannels_.size(), numFunctors);
+        }
+#endif
+        if(busyPollWindowUs_ > 0 && (!activeChannels_.empty() || numFunctors > 0))
+        {
+            lastBusyTime_ = pollReturnTime_;
+        }
     }
+    spinning_ = false;
     LOG_INFO("EventLoop %p stop looping. \n", this);
     looping_ = false;
 }
@@ -121,24 +170,24 @@ void EventLoop::runInLoop(Functor cb)
     }
     else //在非当前loop线程中执行cb，那就需要唤醒loop所在线程执行cb
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 }
 //把cb放入队列中，唤醒loop所在的线程，执行cb
 void EventLoop::queueInLoop(Functor cb)
 {
-    //因为多个loop可能同时去调用另一个loop让它执行回调，所以vector涉及了并发访问，需要通过锁控制
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        //push_back是拷贝构造，emplace_back是直接构造
-        pendingFunctors_.emplace_back(cb);
-    }
+    //多个loop可能同时让另一个loop执行回调，pendingFunctors_是无锁的多生产者队列
+    pendingFunctors_.push(std::move(cb));
     //唤醒相应的，需要执行上面回调操作的loop线程了
     //|| callingPendingFunctors_的意思是：当前loop正在执行回调，但是loop又有了新的回调，
     if(!isInLoopThread() || callingPendingFunctors_)
     {
-        //唤醒loop所在线程
-        wakeup();
+        //loop在忙轮询，下一圈自己会来取；loop开始执行回调之前已经有人唤醒过了，也不用再写eventfd
+        //先load一次，已经有唤醒在路上的时候不去抢这个cache line
+        if(!spinning_.load() && !wakeupPending_.load() && !wakeupPending_.exchange(true))
+        {
+            wakeup();
+        }
     }
 }
 
@@ -164,36 +213,145 @@ void EventLoop::wakeup()
     }
 }
 
+TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::runAfter(double delay, TimerCallback cb)
+{
+    return runAt(addTime(Timestamp::now(), delay), std::move(cb));
+}
+
+TimerId EventLoop::runEvery(double interval, TimerCallback cb)
+{
+    return timerQueue_->addTimer(std::move(cb), addTime(Timestamp::now(), interval), interval);
+}
+
+void EventLoop::cancel(TimerId timerId)
+{
+    timerQueue_->cancel(timerId);
+}
+
+void EventLoop::addHousekeeping(TimerCallback cb)
+{
+    runEvery(kHousekeepingSeconds, std::move(cb));
+}
+
+void EventLoop::setBusyPoll(int windowMicroseconds, int socketBusyPollMicroseconds)
+{
+    busyPollWindowUs_ = windowMicroseconds > 0 ? windowMicroseconds : 0;
+    socketBusyPollUs_ = socketBusyPollMicroseconds > 0 ? socketBusyPollMicroseconds : 0;
+    //刚打开就先转一个窗口
+    lastBusyTime_ = Timestamp::now();
+}
+
+int EventLoop::pollTimeoutMs()
+{
+    if(busyPollWindowUs_ == 0)
+    {
+        return kPollTimeMs;
+    }
+    int64_t idleUs = Timestamp::now().microSecondsSinceEpoch() - lastBusyTime_.microSecondsSinceEpoch();
+    if(idleUs < busyPollWindowUs_)
+    {
+        if(!spinning_.load(std::memory_order_relaxed))
+        {
+            spinning_ = true;
+        }
+        return 0;
+    }
+    //窗口过了，准备阻塞。先清掉标志，之后的生产者都会写eventfd；清之前放进来的回调可能没有唤醒，再看一眼队列
+    //和queueInLoop里先push再读spinning_对应，都是seq_cst，两边至少有一边能看到对方
+    if(spinning_.load(std::memory_order_relaxed))
+    {
+        spinning_ = false;
+        if(!pendingFunctors_.empty())
+        {
+            return 0;
+        }
+    }
+    return kPollTimeMs;
+}
+
+void EventLoop::abortNotInLoopThread() const
+{
+    LOG_FATAL("EventLoop %p was created in thread %d, current thread %d \n", this, threadId_, CurrentThread::tid());
+}
+
+TimingWheel* EventLoop::timingWheel()
+{
+    if(!timingWheel_)
+    {
+        timingWheel_.reset(new TimingWheel(this));
+    }
+    return timingWheel_.get();
+}
+
 //eventloop的方法=》Poller的方法
 void EventLoop::updateChannel(Channel* channel)
 {
-    poller_->updateChannel(channel);
+    // Poller和pendingUpdates_都只能在loop线程里动
+    assertInLoopThread();
+    if(!channel->updatePending())
+    {
+        channel->set_updatePending(true);
+        pendingUpdates_.push_back(channel);
+    }
 }
 void EventLoop::removeChannel(Channel* channel)
 {
+    assertInLoopThread();
+    // Channel马上就要析构了，还没交给Poller的修改直接丢掉
+    if(channel->updatePending())
+    {
+        channel->set_updatePending(false);
+        pendingUpdates_.erase(std::find(pendingUpdates_.begin(), pendingUpdates_.end(), channel));
+    }
     poller_->removeChannel(channel);
 }
-bool EventLoop::hasChannel(Channel* channel)
+// 攒着还没交给Poller的Channel，下一轮poll之前就会加进去，也算在Poller里
+bool EventLoop::hasChannel(Channel* channel) const
 {
-    return poller_->hasChannel(channel);
+    return channel->updatePending() || poller_->hasChannel(channel);
+}
+void EventLoop::applyChannelUpdates()
+{
+    for(Channel *channel : pendingUpdates_)
+    {
+        channel->set_updatePending(false);
+        poller_->updateChannel(channel);
+    }
+    pendingUpdates_.clear();
+}
+bool EventLoop::asyncIoEnabled() const
+{
+    return poller_->asyncIoEnabled();
+}
+void EventLoop::submitRecv(Channel* channel, char* buf, size_t len)
+{
+    poller_->submitRecv(channel, buf, len);
+}
+void EventLoop::submitSend(Channel* channel, const char* buf, size_t len)
+{
+    poller_->submitSend(channel, buf, len);
 }
 
 //执行回调
-void EventLoop::doPendingFunctors()
+size_t EventLoop::doPendingFunctors()
 {
-    std::vector<Functor> functors;
     callingPendingFunctors_ = true;
+    //先清掉标志再取队列：清掉之后放进来的回调，要么这次取得到，要么生产者会重新写eventfd
+    //两边都是seq_cst，不会出现生产者看到旧标志、这里又没取到它的回调的情况
+    wakeupPending_.store(false);
 
-    {
-        std::unique_lock<std::mutex> lock(mutex_);
-        functors.swap(pendingFunctors_);//资源交换，把pendingFunctors_ 置为空
-		//不需要pendingFunctors_了  不妨碍 mainloop向 pendingFunctors_写回调操作cb 
-    }
-
-    for(const Functor &functor : functors)
-    {
+    //只执行现在已经在队列里的回调，执行过程中新放进来的留到下一轮，不会把loop一直占住
+    LoopHeartbeat &heartbeat = *heartbeat_;
+    size_t count = pendingFunctors_.consume([&heartbeat](Functor &functor) {
+        LoopHeartbeat::Scope watch(heartbeat, "EventLoop", "pendingFunctor", nullptr);
         functor(); // 执行当前loop需要执行的回调操作
-    }
+    });
     callingPendingFunctors_ = false;
+    return count;
 }
 
@@ -4,22 +4,40 @@
 #include<vector>
 #include<atomic>
 #include<memory>
-#include<mutex>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "MpscQueue.h"
+#include "Task.h"
+#include "LoopProfiler.h"
 //事件循环类，主要包含了两大模块Channel和Poller(epoll的抽象)
 
 class Channel;
 class Poller;
+class BufferPool;
+class TimerQueue;
+class TimingWheel;
+class LoopHeartbeat;
 
 class EventLoop
 {
 public:
-    using Functor = std::function<void()>;//相当于定义了一个回调的类型
-
-    EventLoop();
+    //回调的类型，只能移动，bind出来的对象一般放在Task内部，放进队列不分配内存
+    using Functor = Task<void()>;
+
+    //底层IO复用的实现
+    enum PollerType
+    {
+        kDefaultPoller,         //epoll，环境变量MUDUO_USE_URING可以改成io_uring
+        kEpollPoller,
+        kUringPoller,           //io_uring multishot poll代替epoll_wait/epoll_ctl
+        kUringReadWritePoller,  //在kUringPoller基础上，TcpConnection的读写也通过io_uring提交
+    };
+
+    explicit EventLoop(PollerType type = kDefaultPoller);
     ~EventLoop();
 
     //开启事件循环
@@ -29,7 +47,7 @@ public:
 
     Timestamp pollReturnTime()const { return pollReturnTime_; }
 
-    //在当前loop中执行cb
+    //在当前loop中执行cb，cb一路移动进队列，不会拷贝
     void runInLoop(Functor cb);
     //把cb放入队列中，唤醒loop所在的线程，执行cb
     void queueInLoop(Functor cb);
@@ -37,17 +55,83 @@ public:
     //用来唤醒loop所在的线程
     void wakeup();
 
+    //定时器，可以在任何线程调用，cb都在loop线程里执行
+    //在time时刻执行cb，time是墙上时间，调用时换算成离现在还有多久，之后系统时间被调整也按原来的间隔到期
+    TimerId runAt(Timestamp time, TimerCallback cb);
+    //delay秒以后执行cb
+    TimerId runAfter(double delay, TimerCallback cb);
+    //每隔interval秒执行一次cb
+    TimerId runEvery(double interval, TimerCallback cb);
+    //取消定时器，已经执行过或者取消过的也可以再调用
+    void cancel(TimerId timerId);
+
+    //每隔1秒在loop线程里执行一次cb，用于回收空闲连接缓冲区这类不需要精确定时的维护工作
+    void addHousekeeping(TimerCallback cb);
+    //本loop的时间轮，管理连接的空闲超时，第一次调用时创建，只能在loop线程调用
+    TimingWheel* timingWheel();
+
+    /**
+     * 忙轮询：最近一次有IO事件或者回调以后的windowMicroseconds微秒内，poll用0超时一直转，
+     * 不阻塞在epoll_wait里，这期间queueInLoop也不写eventfd，下一圈直接从队列里取。窗口过了才回到阻塞
+     * socketBusyPollMicroseconds大于0时，本loop上的连接都设置SO_BUSY_POLL(见Socket::setBusyPoll)
+     * windowMicroseconds为0关闭，默认关闭。会占满一个CPU，只给对延迟敏感、独占CPU的loop用
+     * 在loop线程里或者loop()开始之前调用
+     */
+    void setBusyPoll(int windowMicroseconds, int socketBusyPollMicroseconds = 0);
+    int busyPollWindow() const { return busyPollWindowUs_; }
+    int socketBusyPoll() const { return socketBusyPollUs_; }
+
+    //每一轮poll、分发IO事件、执行回调的耗时统计，默认关闭，可以在任何线程打开/读取，见LoopProfiler
+    //编译时没有定义MUDUO_LOOP_PROFILING的话统计一直是0
+    void setProfiling(bool on) { profiler_.setEnabled(on); }
+    LoopProfiler::Stats profileStats() const { return profiler_.stats(); }
+    //打开统计以后累计的忙碌时间(分发IO事件+执行回调)，可以在任何线程读
+    uint64_t busyNs() const { return profiler_.busyNs(); }
+    //本loop上的TcpConnection个数，构造时加一、connectDestroyed时减一，可以在任何线程读，见LoopPlacementPolicy
+    int numConnections() const { return numConnections_.load(std::memory_order_relaxed); }
+    void connectionAdded() { numConnections_.fetch_add(1, std::memory_order_relaxed); }
+    void connectionRemoved() { numConnections_.fetch_sub(1, std::memory_order_relaxed); }
+    //卡死检测用的心跳，Channel和doPendingFunctors在回调前后更新，LoopWatchdog在别的线程读，见LoopWatchdog::watch
+    const std::shared_ptr<LoopHeartbeat>& heartbeat() const { return heartbeat_; }
+
     //eventloop的方法=》Poller的方法
+    /**
+     * loop线程里的修改先记下来，下一次poll之前每个Channel只按最终感兴趣的事件更新一次，
+     * 同一轮里先打开又关掉EPOLLOUT这类修改互相抵消，不产生epoll_ctl
+     * update/remove只能在loop线程里调用，其他线程要改Channel先用runInLoop转过来，不是的话直接LOG_FATAL
+     * hasChannel不会提前把修改交给Poller，记下来还没交的Channel也算
+     */
     void updateChannel(Channel* channel);
     void removeChannel(Channel* channel);
-    bool hasChannel(Channel* channel);
+    bool hasChannel(Channel* channel) const;
+
+    //io_uring读写模式：TcpConnection不再自己read/write，而是把recv/send交给Poller异步提交
+    bool asyncIoEnabled() const;
+    void submitRecv(Channel* channel, char* buf, size_t len);
+    void submitSend(Channel* channel, const char* buf, size_t len);
+
+    //本loop的Buffer内存池，只能在loop线程里分配，统计信息stats()可以在任何线程读
+    const std::shared_ptr<BufferPool>& bufferPool() const { return bufferPool_; }
 
     //判断eventloop对象是否在自己的线程里面
     bool isInLoopThread()const { return threadId_ == CurrentThread::tid(); }
+    //只能在loop线程里调用的函数，在其他线程调用就直接LOG_FATAL
+    void assertInLoopThread() const
+    {
+        if(!isInLoopThread())
+        {
+            abortNotInLoopThread();
+        }
+    }
 
 private:
+    void abortNotInLoopThread() const;
     void handleRead();//处理wake up唤醒相关的逻辑
-    void doPendingFunctors();//执行回调
+    size_t doPendingFunctors();//执行回调，返回执行了几个
+    //这一轮poll的超时，忙轮询窗口内是0
+    int pollTimeoutMs();
+    //把攒下的Channel修改交给Poller
+    void applyChannelUpdates();
 
     using ChannelList = std::vector<Channel*>;
 
@@ -56,6 +140,10 @@ private:
     std::atomic_bool quit_; //标志退出loop循环
     
     const pid_t threadId_;  //记录当前loop所在的线程id，会用于和执行的线程id比较
+
+    //要比pendingFunctors_后析构，pendingFunctors_里可能还有TcpConnectionPtr，它的Buffer要把内存还回来
+    //和本loop的Buffer共同持有，比loop活得久的Buffer(比如用户留着的TcpConnectionPtr)析构时内存池还在
+    std::shared_ptr<BufferPool> bufferPool_;
    
     //和poller有关
     Timestamp pollReturnTime_;  //poller返回发生事件channels的时间点
@@ -67,11 +155,26 @@ private:
     //存储eventloop下所有的channel相关的
     ChannelList activeChannels_;//EventLoop中有事件发生的Channel
     Channel *currentActiveChannel_;
+    ChannelList pendingUpdates_; //事件有修改、还没交给Poller的Channel
+
+    //构造的时候要注册timerfd的Channel，放在pendingUpdates_后面
+    std::unique_ptr<TimerQueue> timerQueue_;
+    std::unique_ptr<TimingWheel> timingWheel_; //转动靠timerQueue_，要比它先析构
 
     //loop上需要执行的回调操作
     std::atomic_bool callingPendingFunctors_;   //标识当前Loop是否有需要执行的回调操作
-    std::vector<Functor> pendingFunctors_; //存储loop需要执行的所有的回调操作
-    std::mutex mutex_; //互斥锁，用来保护上面vector容器的线程安全的操作
-
+    MpscQueue<Functor> pendingFunctors_; //存储loop需要执行的所有的回调操作，其他线程无锁地往里放
+    //已经写过eventfd、loop还没开始执行回调，这期间再queueInLoop不用重复唤醒
+    std::atomic_bool wakeupPending_;
+
+    //忙轮询
+    int busyPollWindowUs_;
+    int socketBusyPollUs_;
+    Timestamp lastBusyTime_;        //最近一次有事件或者回调的poll返回时间
+    std::atomic_bool spinning_;     //loop正在0超时地转，生产者不用写eventfd
+
+    LoopProfiler profiler_;
+    std::atomic_int numConnections_;
+    std::shared_ptr<LoopHeartbeat> heartbeat_;
 
 };
\ No newline at end of file
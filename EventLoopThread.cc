@@ -1,13 +1,16 @@
 #include "EventLoopThread.h"
 #include "EventLoop.h"
+#include "CpuAffinity.h"
 
-EventLoopThread::EventLoopThread(const ThreadInitCallback& cb,const std::string& name)
+EventLoopThread::EventLoopThread(const ThreadInitCallback& cb,const std::string& name,EventLoop::PollerType pollerType,int cpu)
     :loop_(nullptr)
     ,exiting_(false)
     ,thread_(std::bind(&EventLoopThread::threadFunc,this),name)//绑定回调函数
     ,mutex_()
     ,cond_()
     ,callback_(cb)
+    ,pollerType_(pollerType)
+    ,cpu_(cpu)
 {
 
 }
@@ -40,8 +43,13 @@ EventLoop* EventLoopThread::startLoop()
 //下面这个方法是在单独的新线程里面运行的
 void EventLoopThread::threadFunc()
 {
+    //先绑核再创建loop，loop的内存都由这个线程第一次访问，落在本地NUMA节点上
+    if(cpu_ >= 0)
+    {
+        CpuAffinity::bindCurrentThread(cpu_);
+    }
     //创建一个独立的EventLoop和上面的线程是一一对应的，one loop per thread
-    EventLoop loop;
+    EventLoop loop(pollerType_);
 
     //ThreadInitCallback就是在底层起一个新线程去绑定一个loop的时候，什么事情还没做
     //如果传递过ThreadInitCallback，在这里就会调用这个回调，可以把当前这个线程绑定的
@@ -2,20 +2,21 @@
 
 #include "noncopyable.h"
 #include "Thread.h"
+#include "EventLoop.h"
 
 #include<functional>
 #include<mutex>
 #include<condition_variable>
 #include<string>
 
-class EventLoop;
-
 class EventLoopThread : noncopyable
 {
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
 
-    EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(),const std::string& name = std::string());//线程初始化的回调 
+    //cpu不小于0时，线程先绑到这个CPU上再构造EventLoop，见CpuAffinity::bindCurrentThread
+    EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(),const std::string& name = std::string(),
+                    EventLoop::PollerType pollerType = EventLoop::kDefaultPoller, int cpu = -1);//线程初始化的回调 
     ~EventLoopThread();
 
     EventLoop* startLoop();//开启循环 
@@ -29,4 +30,6 @@ private:
     std::mutex mutex_;
     std::condition_variable cond_;
     ThreadInitCallback callback_;//启动一个新线程绑定EventLoop是调用，进行初始化操作 
+    EventLoop::PollerType pollerType_;
+    int cpu_;
 };
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
+#include "CpuAffinity.h"
 
 #include<memory>
+#include<utility>
 
 EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, const std::string &nameArg)
     :baseLoop_(baseLoop)
@@ -9,6 +11,8 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, const std::string
     ,started_(false)
     ,numThreads_(0)
     ,next_(0)
+    ,pollerType_(EventLoop::kDefaultPoller)
+    ,autoCpus_(false)
 {}
 
 //析构的时候不需要关注vector析构的时候里面存的EventLoop指针执行的外部资源是否需要单独delete，
@@ -22,16 +26,29 @@ EventLoopThreadPool::~EventLoopThreadPool()
 void EventLoopThreadPool::start(const ThreadInitCallback &cb)
 {
     started_ = true;
+    std::vector<int> cpus = autoCpus_ ? CpuAffinity::autoPlacement(numThreads_ + 1) : cpus_;
+    if(!cpus.empty())
+    {
+        //baseloop已经构造好了，只能绑线程，它的内存不一定在本地节点上
+        CpuAffinity::bindCurrentThread(cpus[0]);
+    }
     //用户通过setThreadNum设置了线程数就会进入循环
     for(int i = 0; i < numThreads_; ++i)
     {
         char buf[name_.size() + 32];
         snprintf(buf, sizeof buf, "%s%d", name_.c_str(), i); //底层线程名字 = 线程池名字+循环下标
-        EventLoopThread *t = new EventLoopThread(cb, buf);
+        int cpu = cpus.empty() ? -1 : cpus[(i + 1) % cpus.size()];
+        loopCpus_.push_back(cpu);
+        EventLoopThread *t = new EventLoopThread(cb, buf, pollerType_, cpu);
         threads_.push_back(std::unique_ptr<EventLoopThread>(t)); // 用unique_ptr管理堆上的EventLoopThread对象，以免我们手动释放
         loops_.push_back(t->startLoop()); //底层创建线程，绑定一个新的EventLoop,并返回该loop的地址
     }
 
+    if(placement_ && !loops_.empty())
+    {
+        placement_->attach(loops_);
+    }
+
     //整个服务端只有一个线程，运行着baseloop
     if(numThreads_ == 0 && cb)
     {
@@ -56,6 +73,24 @@ EventLoop* EventLoopThreadPool::getNextLoop()
     return loop;
 }
 
+void EventLoopThreadPool::setPlacementPolicy(std::unique_ptr<LoopPlacementPolicy> policy)
+{
+    placement_ = std::move(policy);
+    if(placement_ && started_ && !loops_.empty())
+    {
+        placement_->attach(loops_);
+    }
+}
+
+EventLoop* EventLoopThreadPool::getLoopForConnection(const InetAddress &peerAddr)
+{
+    if(!placement_ || loops_.empty())
+    {
+        return getNextLoop();
+    }
+    return loops_[placement_->select(loops_, peerAddr) % loops_.size()];
+}
+
 //返回事件循环池所有的EventLoop,就是loops_
 std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
 {
@@ -1,12 +1,13 @@
 #pragma once
 #include "noncopyable.h"
+#include "EventLoop.h"
+#include "LoopPlacement.h"
 
 #include<functional>
 #include<string>
 #include<vector>
 #include<memory>
 
-class EventLoop;
 class EventLoopThread;
 
 class EventLoopThreadPool : noncopyable
@@ -19,12 +20,32 @@ public:
 
     //设置底层线程的数量，TcpServer::setThreadNum底层调用的就是EventLoopThreadPool::setThreadNum
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    //subloop使用的IO复用实现，start之前设置
+    void setPollerType(EventLoop::PollerType type) { pollerType_ = type; }
+    /**
+     * loop线程绑核，start之前设置：cpus[0]给baseloop(start所在的线程)，cpus[1]开始依次给subloop，不够就循环
+     * 空的列表表示不绑核(默认)
+     * 注意baseloop一般跑在用户的main线程里，start会把调用线程永久绑到cpus[0]上，不会恢复，
+     * 这个线程之后创建的线程也继承这个绑定。main线程还要做别的事的话，baseloop放到单独的线程里再start
+     */
+    void setCpuAffinity(const std::vector<int> &cpus) { cpus_ = cpus; autoCpus_ = false; }
+    //按CpuAffinity::autoPlacement给baseloop和所有subloop选CPU
+    void setAutoCpuAffinity() { cpus_.clear(); autoCpus_ = true; }
+    bool hasCpuAffinity() const { return autoCpus_ || !cpus_.empty(); }
+    //start以后第i个subloop绑在哪个CPU上，没绑核的是-1
+    const std::vector<int>& loopCpus() const { return loopCpus_; }
     //根据指定的线程数量在池里面创建numThread_个数的事件线程
     void start(const ThreadInitCallback &cb = ThreadInitCallback());
 
     //如果工作在多线程中，baseLoop_会默认以轮询的方式分配channel给subloop
     EventLoop* getNextLoop();
 
+    //新连接分配给subloop的策略，不设置就是getNextLoop的轮询；start之后设置的话马上attach到已有的subloop上
+    //只能在baseloop线程调用
+    void setPlacementPolicy(std::unique_ptr<LoopPlacementPolicy> policy);
+    //给对端是peerAddr的新连接选一个loop，在baseloop线程调用
+    EventLoop* getLoopForConnection(const InetAddress &peerAddr);
+
     //返回事件循环池所有的EventLoop,就是loops_
     std::vector<EventLoop*> getAllLoops();
 
@@ -36,6 +57,11 @@ private:
     bool started_;
     int numThreads_;
     int next_; //轮询的下标
+    EventLoop::PollerType pollerType_;
+    std::vector<int> cpus_;
+    bool autoCpus_;
+    std::vector<int> loopCpus_;
+    std::unique_ptr<LoopPlacementPolicy> placement_;
     std::vector<std::unique_ptr<EventLoopThread>> threads_; //包含了创建的所有事件subloop的线程，和loops_一一对应
     std::vector<EventLoop*> loops_; // 包含了所有创建的subLoop的指针，这些EventLoop对象都是栈上的（见EventLoopThread::threadFunc）
 };
@@ -0,0 +1,48 @@
+#include "LengthHeaderCodec.h"
+#include "TcpConnection.h"
+#include "Buffer.h"
+#include "Logger.h"
+
+#include <vector>
+#include <endian.h>
+
+const size_t LengthHeaderCodec::kHeaderLen;
+const size_t LengthHeaderCodec::kDefaultMaxFrameSize;
+
+void LengthHeaderCodec::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+{
+    while (buf->readableBytes() >= kHeaderLen)
+    {
+        const size_t len = static_cast<uint32_t>(buf->peekInt32());
+        if (len > maxFrameSize_)
+        {
+            LOG_ERROR("LengthHeaderCodec frame length %lu from %s exceeds max %lu \n",
+                      len, conn->name().c_str(), maxFrameSize_);
+            buf->retrieveAll();
+            conn->shutdown();
+            break;
+        }
+        if (buf->readableBytes() < kHeaderLen + len)
+        {
+            break; // 帧还没收全
+        }
+        buf->retrieve(kHeaderLen);
+        if (buf->contiguousBytes() < len)
+        {
+            buf->linearize(); // 分段模式下消息体跨了数据块，Slice要连续内存
+        }
+        // 回调期间消息体还在Buffer里，回调返回以后才取走
+        frameCallback_(conn, Slice(buf->peek(), len), receiveTime);
+        buf->retrieve(len);
+    }
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr& conn, const void* data, size_t len)
+{
+    int32_t be32 = htobe32(static_cast<int32_t>(len));
+    std::vector<Slice> frame;
+    frame.reserve(2);
+    frame.push_back(Slice(&be32, sizeof be32));
+    frame.push_back(Slice(data, len));
+    conn->send(frame);
+}
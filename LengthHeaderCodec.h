@@ -0,0 +1,48 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Slice.h"
+#include "Timestamp.h"
+
+#include <functional>
+#include <string>
+#include <stddef.h>
+
+/**
+ * 长度头编解码：每帧前面是4字节网络字节序的消息体长度，后面跟消息体
+ * 把onMessage绑定给TcpServer，收到的字节流按帧切开，每个完整的帧调用一次frameCallback，
+ * 一次onMessage里可能有好几帧，不完整的帧留在Buffer里等后面的数据
+ *
+ * 回调拿到的Slice直接指向inputBuffer_里的数据，不拷贝，只在回调期间有效，要保留就自己拷贝一份
+ * 长度超过maxFrameSize的帧当作非法数据，打日志以后丢掉Buffer里的数据并关闭连接
+ */
+class LengthHeaderCodec : noncopyable
+{
+public:
+    using FrameCallback = std::function<void(const TcpConnectionPtr&, const Slice&, Timestamp)>;
+
+    static const size_t kHeaderLen = sizeof(int32_t);
+    static const size_t kDefaultMaxFrameSize = 16 * 1024 * 1024;
+
+    explicit LengthHeaderCodec(const FrameCallback& cb, size_t maxFrameSize = kDefaultMaxFrameSize)
+        :frameCallback_(cb)
+        ,maxFrameSize_(maxFrameSize)
+    {}
+
+    //给TcpServer::setMessageCallback用
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+
+    //长度头和消息体用一次writev发出去，消息体不拷贝(跨线程调用时TcpConnection会拷贝一份)
+    void send(const TcpConnectionPtr& conn, const void* data, size_t len);
+    void send(const TcpConnectionPtr& conn, const std::string& message)
+    {
+        send(conn, message.data(), message.size());
+    }
+
+    size_t maxFrameSize() const { return maxFrameSize_; }
+
+private:
+    FrameCallback frameCallback_;
+    const size_t maxFrameSize_;
+};
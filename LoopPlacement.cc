@@ -0,0 +1,154 @@
+#include "LoopPlacement.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <algorithm>
+
+//splitmix64的混合函数，相近的输入(连续的IP、连续的虚拟节点编号)也能打散到整个64位空间
+static uint64_t mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+size_t RoundRobinPlacement::select(const std::vector<EventLoop*> &loops, const InetAddress &)
+{
+    size_t index = next_ % loops.size();
+    next_ = index + 1;
+    return index;
+}
+
+size_t LeastConnectionsPlacement::select(const std::vector<EventLoop*> &loops, const InetAddress &)
+{
+    size_t best = next_ % loops.size();
+    int bestCount = loops[best]->numConnections();
+    for(size_t i = 1; i < loops.size(); ++i)
+    {
+        size_t index = (next_ + i) % loops.size();
+        int count = loops[index]->numConnections();
+        if(count < bestCount)
+        {
+            best = index;
+            bestCount = count;
+        }
+    }
+    next_ = best + 1;
+    return best;
+}
+
+LeastBusyPlacement::LeastBusyPlacement(double sampleSeconds)
+    :sampleNs_(static_cast<int64_t>(sampleSeconds * 1000 * 1000 * 1000))
+    ,lastSampleNs_(0)
+    ,costPerConnection_(0)
+{
+}
+
+void LeastBusyPlacement::attach(const std::vector<EventLoop*> &loops)
+{
+    loads_.assign(loops.size(), LoopLoad());
+    for(size_t i = 0; i < loops.size(); ++i)
+    {
+        loops[i]->setProfiling(true);
+        loads_[i].lastBusyNs = loops[i]->busyNs();
+    }
+    lastSampleNs_ = LoopProfiler::now();
+}
+
+void LeastBusyPlacement::sample(const std::vector<EventLoop*> &loops, int64_t now)
+{
+    double elapsed = static_cast<double>(now - lastSampleNs_);
+    double cost = 0;
+    for(size_t i = 0; i < loops.size(); ++i)
+    {
+        LoopLoad &load = loads_[i];
+        uint64_t busyNs = loops[i]->busyNs();
+        double fraction = std::min((busyNs - load.lastBusyNs) / elapsed, 1.0);
+        load.busy = (load.busy + fraction) / 2;
+        load.lastBusyNs = busyNs;
+        load.assigned = 0;
+        //新连接按最轻的那个loop上平均每条连接的负载估计，少数几条重负载的连接不会把估计拉高
+        int connections = loops[i]->numConnections();
+        if(connections > 0 && (cost == 0 || load.busy / connections < cost))
+        {
+            cost = load.busy / connections;
+        }
+    }
+    //一条连接至少算一点负载，全都空闲的时候也能轮流分
+    costPerConnection_ = std::max(cost, 0.001);
+    lastSampleNs_ = now;
+}
+
+size_t LeastBusyPlacement::select(const std::vector<EventLoop*> &loops, const InetAddress &)
+{
+    if(loads_.size() != loops.size())
+    {
+        attach(loops);
+    }
+    int64_t now = LoopProfiler::now();
+    if(now - lastSampleNs_ >= sampleNs_)
+    {
+        sample(loops, now);
+    }
+    size_t best = 0;
+    double bestScore = 0;
+    for(size_t i = 0; i < loops.size(); ++i)
+    {
+        double score = loads_[i].busy + loads_[i].assigned * costPerConnection_;
+        if(i == 0 || score < bestScore)
+        {
+            best = i;
+            bestScore = score;
+        }
+    }
+    ++loads_[best].assigned;
+    return best;
+}
+
+ConsistentHashPlacement::ConsistentHashPlacement(int virtualNodes)
+    :virtualNodes_(std::max(virtualNodes, 1))
+    ,numLoops_(0)
+{
+}
+
+void ConsistentHashPlacement::attach(const std::vector<EventLoop*> &loops)
+{
+    buildRing(loops.size());
+}
+
+void ConsistentHashPlacement::buildRing(size_t numLoops)
+{
+    ring_.clear();
+    ring_.reserve(numLoops * virtualNodes_);
+    for(size_t loop = 0; loop < numLoops; ++loop)
+    {
+        for(int v = 0; v < virtualNodes_; ++v)
+        {
+            Point point;
+            point.hash = mix((static_cast<uint64_t>(loop) << 32) | static_cast<uint32_t>(v));
+            point.loop = loop;
+            ring_.push_back(point);
+        }
+    }
+    std::sort(ring_.begin(), ring_.end());
+    numLoops_ = numLoops;
+}
+
+size_t ConsistentHashPlacement::select(const std::vector<EventLoop*> &loops, const InetAddress &peerAddr)
+{
+    if(numLoops_ != loops.size())
+    {
+        buildRing(loops.size());
+    }
+    //只用IP，同一台主机不同端口的连接落在一起
+    Point key;
+    key.hash = mix(peerAddr.getSockAddr()->sin_addr.s_addr);
+    key.loop = 0;
+    std::vector<Point>::const_iterator it = std::lower_bound(ring_.begin(), ring_.end(), key);
+    if(it == ring_.end())
+    {
+        it = ring_.begin();
+    }
+    return it->loop;
+}
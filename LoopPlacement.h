@@ -0,0 +1,101 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+class EventLoop;
+class InetAddress;
+
+/**
+ * 新连接分给哪个subloop，TcpServer::newConnection在baseloop线程里调用select，实现里不需要加锁
+ * loops是线程池里所有的subloop，启动以后顺序不变，select返回其中一个的下标
+ * 没有subloop的时候不会调用，连接都在baseloop上
+ */
+class LoopPlacementPolicy : noncopyable
+{
+public:
+    virtual ~LoopPlacementPolicy() {}
+
+    //线程池启动以后调用一次，策略需要loop上的统计的话在这里打开
+    virtual void attach(const std::vector<EventLoop*> &/*loops*/) {}
+    virtual size_t select(const std::vector<EventLoop*> &loops, const InetAddress &peerAddr) = 0;
+};
+
+//轮询，和不设置策略时一样
+class RoundRobinPlacement : public LoopPlacementPolicy
+{
+public:
+    RoundRobinPlacement() : next_(0) {}
+    size_t select(const std::vector<EventLoop*> &loops, const InetAddress &peerAddr) override;
+
+private:
+    size_t next_;
+};
+
+//当前连接数(EventLoop::numConnections)最少的loop，一样多的时候从上次选中的下一个开始找，不会总落在第一个上
+class LeastConnectionsPlacement : public LoopPlacementPolicy
+{
+public:
+    LeastConnectionsPlacement() : next_(0) {}
+    size_t select(const std::vector<EventLoop*> &loops, const InetAddress &peerAddr) override;
+
+private:
+    size_t next_;
+};
+
+/**
+ * 最近一段时间最闲的loop：每隔sampleSeconds用EventLoop::busyNs算一次各个loop忙碌时间的占比(做指数平滑)
+ * 两次采样之间分出去的连接按最轻的loop上每条连接的负载预估进去，一批连接同时到来时不会全挤到同一个loop上
+ * attach时会打开各个loop的LoopProfiler；编译时去掉了MUDUO_LOOP_PROFILING的话忙碌时间一直是0，退化成按预估轮流分
+ */
+class LeastBusyPlacement : public LoopPlacementPolicy
+{
+public:
+    explicit LeastBusyPlacement(double sampleSeconds = 0.1);
+    void attach(const std::vector<EventLoop*> &loops) override;
+    size_t select(const std::vector<EventLoop*> &loops, const InetAddress &peerAddr) override;
+
+private:
+    void sample(const std::vector<EventLoop*> &loops, int64_t now);
+
+    struct LoopLoad
+    {
+        uint64_t lastBusyNs;
+        double busy;        //平滑以后的忙碌占比，0~1
+        int assigned;       //上次采样以后分过来的连接数
+    };
+
+    const int64_t sampleNs_;
+    int64_t lastSampleNs_;
+    double costPerConnection_;  //预估一条新连接带来的忙碌占比
+    std::vector<LoopLoad> loads_;
+};
+
+/**
+ * 按对端IP做一致性哈希，同一台客户端主机的连接总落在同一个loop上(这台主机相关的状态留在同一个CPU的缓存里)
+ * 每个loop在环上有virtualNodes个虚拟节点，loop个数变化时只有一部分客户端换loop
+ */
+class ConsistentHashPlacement : public LoopPlacementPolicy
+{
+public:
+    explicit ConsistentHashPlacement(int virtualNodes = 64);
+    void attach(const std::vector<EventLoop*> &loops) override;
+    size_t select(const std::vector<EventLoop*> &loops, const InetAddress &peerAddr) override;
+
+private:
+    void buildRing(size_t numLoops);
+
+    struct Point
+    {
+        uint64_t hash;
+        size_t loop;
+        bool operator<(const Point &other) const { return hash < other.hash; }
+    };
+
+    const int virtualNodes_;
+    size_t numLoops_;
+    std::vector<Point> ring_;   //按hash排好序
+};
@@ -0,0 +1,148 @@
+#include "LoopProfiler.h"
+
+#include <time.h>
+
+//只有loop线程写，不需要原子加，和BufferPool一样load+store就够了
+static inline void bump(std::atomic<uint64_t> &counter, uint64_t delta)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+static inline void bumpMax(std::atomic<uint64_t> &counter, uint64_t value)
+{
+    if(value > counter.load(std::memory_order_relaxed))
+    {
+        counter.store(value, std::memory_order_relaxed);
+    }
+}
+
+uint64_t LoopProfiler::Histogram::total() const
+{
+    uint64_t sum = 0;
+    for(int i = 0; i < kNumBuckets; ++i)
+    {
+        sum += counts[i];
+    }
+    return sum;
+}
+
+uint64_t LoopProfiler::Histogram::percentile(double p) const
+{
+    uint64_t sum = total();
+    if(sum == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p * sum);
+    if(rank >= sum)
+    {
+        rank = sum - 1;
+    }
+    uint64_t seen = 0;
+    for(int i = 0; i < kNumBuckets; ++i)
+    {
+        seen += counts[i];
+        if(seen > rank)
+        {
+            return i == 0 ? 0 : (static_cast<uint64_t>(1) << i) - 1;
+        }
+    }
+    return (static_cast<uint64_t>(1) << (kNumBuckets - 1)) - 1;
+}
+
+LoopProfiler::LoopProfiler()
+    :enabled_(false)
+{
+    reset();
+}
+
+int64_t LoopProfiler::now()
+{
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+int LoopProfiler::bucketOf(uint64_t value)
+{
+    if(value == 0)
+    {
+        return 0;
+    }
+    int bucket = 64 - __builtin_clzll(value);
+    return bucket < kNumBuckets ? bucket : kNumBuckets - 1;
+}
+
+void LoopProfiler::add(AtomicHistogram &histogram, uint64_t value)
+{
+    bump(histogram.counts[bucketOf(value)], 1);
+}
+
+void LoopProfiler::load(const AtomicHistogram &histogram, Histogram *out)
+{
+    for(int i = 0; i < kNumBuckets; ++i)
+    {
+        out->counts[i] = histogram.counts[i].load(std::memory_order_relaxed);
+    }
+}
+
+void LoopProfiler::clear(AtomicHistogram &histogram)
+{
+    for(int i = 0; i < kNumBuckets; ++i)
+    {
+        histogram.counts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void LoopProfiler::record(int64_t pollNs, int64_t dispatchNs, int64_t functorNs, size_t activeChannels, size_t functors)
+{
+    bump(iterations_, 1);
+    bump(pollNs_, pollNs);
+    bump(dispatchNs_, dispatchNs);
+    bump(functorNs_, functorNs);
+    bump(activeChannels_, activeChannels);
+    bump(functors_, functors);
+    bumpMax(maxActiveChannels_, activeChannels);
+    bumpMax(maxFunctors_, functors);
+    add(pollUs_, pollNs / 1000);
+    add(dispatchUs_, dispatchNs / 1000);
+    add(functorUs_, functorNs / 1000);
+    add(activeChannelsHist_, activeChannels);
+    add(functorsHist_, functors);
+}
+
+LoopProfiler::Stats LoopProfiler::stats() const
+{
+    Stats s;
+    s.iterations = iterations_.load(std::memory_order_relaxed);
+    s.pollNs = pollNs_.load(std::memory_order_relaxed);
+    s.dispatchNs = dispatchNs_.load(std::memory_order_relaxed);
+    s.functorNs = functorNs_.load(std::memory_order_relaxed);
+    s.activeChannels = activeChannels_.load(std::memory_order_relaxed);
+    s.functors = functors_.load(std::memory_order_relaxed);
+    s.maxActiveChannels = maxActiveChannels_.load(std::memory_order_relaxed);
+    s.maxFunctors = maxFunctors_.load(std::memory_order_relaxed);
+    load(pollUs_, &s.pollUs);
+    load(dispatchUs_, &s.dispatchUs);
+    load(functorUs_, &s.functorUs);
+    load(activeChannelsHist_, &s.activeChannelsPerIteration);
+    load(functorsHist_, &s.functorsPerIteration);
+    return s;
+}
+
+void LoopProfiler::reset()
+{
+    iterations_.store(0, std::memory_order_relaxed);
+    pollNs_.store(0, std::memory_order_relaxed);
+    dispatchNs_.store(0, std::memory_order_relaxed);
+    functorNs_.store(0, std::memory_order_relaxed);
+    activeChannels_.store(0, std::memory_order_relaxed);
+    functors_.store(0, std::memory_order_relaxed);
+    maxActiveChannels_.store(0, std::memory_order_relaxed);
+    maxFunctors_.store(0, std::memory_order_relaxed);
+    clear(pollUs_);
+    clear(dispatchUs_);
+    clear(functorUs_);
+    clear(activeChannelsHist_);
+    clear(functorsHist_);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * EventLoop每一轮的耗时统计：阻塞在poll里的时间、分发IO事件(Channel::handleEvent)的时间、执行pendingFunctors的时间，
+ * 以及这一轮有几个活跃Channel、执行了几个回调。累计值之外每一项还有一个按2的幂分桶的直方图
+ * 能看出一个subloop是忙在IO回调上、忙在跨线程回调上，还是大部分时间在poll里闲着
+ *
+ * 只有loop线程写，计数器是relaxed原子变量，stats()可以在任何线程读，各个计数器之间不保证是同一时刻的
+ * 编译时不定义MUDUO_LOOP_PROFILING(cmake -DMUDUO_LOOP_PROFILING=OFF)，EventLoop::loop里不会有任何统计代码
+ */
+class LoopProfiler : noncopyable
+{
+public:
+    //第0个桶是0，第i个桶是[2^(i-1), 2^i)，最后一个桶收下所有更大的值。时间以微秒为单位分桶
+    static const int kNumBuckets = 24;
+
+    struct Histogram
+    {
+        uint64_t counts[kNumBuckets];
+
+        uint64_t total() const;
+        //第p(0~1)分位数落在的桶的上界，没有数据时返回0
+        uint64_t percentile(double p) const;
+    };
+
+    struct Stats
+    {
+        uint64_t iterations;        //统计了多少轮
+        uint64_t pollNs;            //累计阻塞在poll里的时间
+        uint64_t dispatchNs;        //累计分发IO事件的时间
+        uint64_t functorNs;         //累计执行pendingFunctors的时间
+        uint64_t activeChannels;    //累计活跃Channel个数
+        uint64_t functors;          //累计执行的回调个数
+        uint64_t maxActiveChannels; //一轮里最多的活跃Channel个数
+        uint64_t maxFunctors;       //一轮里最多执行的回调个数
+        Histogram pollUs;
+        Histogram dispatchUs;
+        Histogram functorUs;
+        Histogram activeChannelsPerIteration;
+        Histogram functorsPerIteration;
+    };
+
+    LoopProfiler();
+
+    //可以在任何线程调用，loop下一轮开始生效
+    void setEnabled(bool on) { enabled_.store(on, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    //CLOCK_MONOTONIC的纳秒数，走vDSO，不进内核
+    static int64_t now();
+    //value落在Histogram的哪个桶里
+    static int bucketOf(uint64_t value);
+
+    //loop线程每一轮调用一次
+    void record(int64_t pollNs, int64_t dispatchNs, int64_t functorNs, size_t activeChannels, size_t functors);
+
+    Stats stats() const;
+    //累计的分发IO事件+执行回调的时间，比stats()便宜，给LeastBusyPlacement采样用
+    uint64_t busyNs() const
+    {
+        return dispatchNs_.load(std::memory_order_relaxed) + functorNs_.load(std::memory_order_relaxed);
+    }
+    //清零，只能在loop线程调用
+    void reset();
+
+private:
+    struct AtomicHistogram
+    {
+        std::atomic<uint64_t> counts[kNumBuckets];
+    };
+
+    static void add(AtomicHistogram &histogram, uint64_t value);
+    static void load(const AtomicHistogram &histogram, Histogram *out);
+    static void clear(AtomicHistogram &histogram);
+
+    std::atomic_bool enabled_;
+    std::atomic<uint64_t> iterations_;
+    std::atomic<uint64_t> pollNs_;
+    std::atomic<uint64_t> dispatchNs_;
+    std::atomic<uint64_t> functorNs_;
+    std::atomic<uint64_t> activeChannels_;
+    std::atomic<uint64_t> functors_;
+    std::atomic<uint64_t> maxActiveChannels_;
+    std::atomic<uint64_t> maxFunctors_;
+    AtomicHistogram pollUs_;
+    AtomicHistogram dispatchUs_;
+    AtomicHistogram functorUs_;
+    AtomicHistogram activeChannelsHist_;
+    AtomicHistogram functorsHist_;
+};
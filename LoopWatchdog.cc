@@ -0,0 +1,246 @@
+#include "LoopWatchdog.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+LoopHeartbeat::LoopHeartbeat(EventLoop *loop, pid_t tid)
+    :loop_(loop)
+    ,tid_(tid)
+    ,watched_(false)
+    ,seq_(0)
+    ,owner_(nullptr)
+    ,tag_(nullptr)
+{
+    for(size_t i = 0; i < kNameWords; ++i)
+    {
+        name_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void LoopHeartbeat::enter(const char *owner, const char *tag, const std::string *name)
+{
+    //上一次leave已经把seq_改成偶数，看门狗看到新名字的时候一定也能看到那个偶数，不会把新名字当成旧回调的
+    std::atomic_thread_fence(std::memory_order_release);
+    owner_.store(owner, std::memory_order_relaxed);
+    tag_.store(tag, std::memory_order_relaxed);
+    uint64_t words[kNameWords] = {0};
+    if(name != nullptr)
+    {
+        ::memcpy(words, name->data(), std::min(name->size(), kNameSize - 1));
+    }
+    for(size_t i = 0; i < kNameWords; ++i)
+    {
+        name_[i].store(words[i], std::memory_order_relaxed);
+    }
+    seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+//在卡住的loop线程里执行，只能用异步信号安全的函数
+static void stackSampleHandler(int)
+{
+    int savedErrno = errno;
+    static const char header[] = "LoopWatchdog: stack of the stalled loop thread:\n";
+    void *frames[64];
+    int n = ::backtrace(frames, 64);
+    ssize_t unused = ::write(STDERR_FILENO, header, sizeof header - 1);
+    (void)unused;
+    ::backtrace_symbols_fd(frames, n, STDERR_FILENO);
+    errno = savedErrno;
+}
+
+static int64_t nowMs()
+{
+    return LoopProfiler::now() / (1000 * 1000);
+}
+
+LoopWatchdog::LoopWatchdog(double thresholdSeconds)
+    :thresholdMs_(std::max<int64_t>(static_cast<int64_t>(thresholdSeconds * 1000), 1))
+    ,intervalMs_(std::max<int64_t>(thresholdMs_ / 4, 1))
+    ,stackSignal_(0)
+    ,running_(false)
+    ,thread_(std::bind(&LoopWatchdog::threadFunc, this), "LoopWatchdog")
+{
+}
+
+LoopWatchdog::~LoopWatchdog()
+{
+    stop();
+    std::unique_lock<std::mutex> lock(mutex_);
+    for(Watched &watched : loops_)
+    {
+        watched.heartbeat->watched_.store(false, std::memory_order_relaxed);
+    }
+}
+
+void LoopWatchdog::watch(EventLoop *loop)
+{
+    std::shared_ptr<LoopHeartbeat> heartbeat = loop->heartbeat();
+    heartbeat->watched_.store(true, std::memory_order_relaxed);
+
+    Watched watched = Watched();
+    watched.heartbeat = heartbeat;
+    watched.lastSeq = heartbeat->seq_.load(std::memory_order_acquire);
+    watched.firstSeenMs = nowMs();
+    std::unique_lock<std::mutex> lock(mutex_);
+    loops_.push_back(watched);
+}
+
+void LoopWatchdog::enableStackSampling(int signo)
+{
+    //backtrace第一次调用要加载libgcc，会分配内存，不能放到信号处理函数里第一次做
+    void *frames[4];
+    ::backtrace(frames, 4);
+
+    struct sigaction sa;
+    ::memset(&sa, 0, sizeof sa);
+    sa.sa_handler = stackSampleHandler;
+    sa.sa_flags = SA_RESTART;
+    ::sigemptyset(&sa.sa_mask);
+    if(::sigaction(signo, &sa, nullptr) < 0)
+    {
+        LOG_ERROR("LoopWatchdog sigaction %d errno=%d \n", signo, errno);
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    stackSignal_ = signo;
+}
+
+void LoopWatchdog::start()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(running_)
+        {
+            return;
+        }
+        running_ = true;
+    }
+    thread_.start();
+}
+
+void LoopWatchdog::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(!running_)
+        {
+            return;
+        }
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_.join();
+}
+
+void LoopWatchdog::threadFunc()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(running_)
+    {
+        cond_.wait_for(lock, std::chrono::milliseconds(intervalMs_));
+        int64_t now = nowMs();
+        for(Watched &watched : loops_)
+        {
+            check(watched, now);
+        }
+    }
+}
+
+void LoopWatchdog::check(Watched &watched, int64_t now)
+{
+    uint64_t seq = watched.heartbeat->seq_.load(std::memory_order_acquire);
+    if(seq != watched.lastSeq)
+    {
+        if(watched.reported)
+        {
+            int64_t stalledMs = now - watched.firstSeenMs;
+            ++watched.stats.stallMs.counts[LoopProfiler::bucketOf(stalledMs)];
+            LOG_INFO("EventLoop %p tid %d recovered after %lld ms \n", watched.heartbeat->loop_,
+                     watched.heartbeat->tid_, static_cast<long long>(stalledMs));
+        }
+        watched.lastSeq = seq;
+        watched.firstSeenMs = now;
+        watched.reported = false;
+        return;
+    }
+    if((seq & 1) == 0 || watched.reported)
+    {
+        return;
+    }
+    int64_t stalledMs = now - watched.firstSeenMs;
+    if(stalledMs >= thresholdMs_)
+    {
+        report(watched, stalledMs);
+    }
+}
+
+void LoopWatchdog::report(Watched &watched, int64_t stalledMs)
+{
+    LoopHeartbeat &heartbeat = *watched.heartbeat;
+    const char *owner = heartbeat.owner_.load(std::memory_order_relaxed);
+    const char *tag = heartbeat.tag_.load(std::memory_order_relaxed);
+    uint64_t words[LoopHeartbeat::kNameWords];
+    for(size_t i = 0; i < LoopHeartbeat::kNameWords; ++i)
+    {
+        words[i] = heartbeat.name_[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(heartbeat.seq_.load(std::memory_order_relaxed) != watched.lastSeq)
+    {
+        return; //刚好执行完了，下一次检查按没卡住处理
+    }
+    char name[LoopHeartbeat::kNameSize];
+    ::memcpy(name, words, sizeof name);
+    name[sizeof name - 1] = '\0';
+
+    watched.reported = true;
+    ++watched.stats.stalls;
+    LOG_ERROR("EventLoop %p tid %d stuck in %s %s callback for %lld ms, connection [%s] \n",
+              heartbeat.loop_, heartbeat.tid_, owner, tag, static_cast<long long>(stalledMs), name);
+    if(stackSignal_ != 0)
+    {
+        ::syscall(SYS_tgkill, ::getpid(), heartbeat.tid_, stackSignal_);
+    }
+}
+
+void LoopWatchdog::addStats(Stats *to, const Stats &from)
+{
+    to->stalls += from.stalls;
+    for(int i = 0; i < LoopProfiler::kNumBuckets; ++i)
+    {
+        to->stallMs.counts[i] += from.stallMs.counts[i];
+    }
+}
+
+LoopWatchdog::Stats LoopWatchdog::stats() const
+{
+    Stats s = Stats();
+    std::unique_lock<std::mutex> lock(mutex_);
+    for(const Watched &watched : loops_)
+    {
+        addStats(&s, watched.stats);
+    }
+    return s;
+}
+
+LoopWatchdog::Stats LoopWatchdog::stats(EventLoop *loop) const
+{
+    Stats s = Stats();
+    std::unique_lock<std::mutex> lock(mutex_);
+    for(const Watched &watched : loops_)
+    {
+        if(watched.heartbeat->loop_ == loop)
+        {
+            addStats(&s, watched.stats);
+        }
+    }
+    return s;
+}
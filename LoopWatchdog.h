@@ -0,0 +1,138 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+#include "LoopProfiler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+
+class EventLoop;
+
+/**
+ * 每个EventLoop一个的心跳，loop线程进入、离开一个回调(Channel的读写回调、pendingFunctors里的一个回调)时各写一次
+ * seq_是奇数表示正在回调里。进入回调时顺便记下回调的标签和连接名字，LoopWatchdog发现卡住的时候拿来报告
+ * 名字拷贝到这里而不是存指针：看门狗线程读的时候连接可能已经析构了。seq_兼做seqlock，读到的名字前后seq_不变才算数
+ *
+ * 没有被LoopWatchdog看守的loop，每个回调只多读一次watched_
+ */
+class LoopHeartbeat : noncopyable
+{
+public:
+    static const size_t kNameSize = 48;  //连接名字最多记这么多字节(含结尾的0)
+
+    //loop线程在回调前后用的，没被看守或者已经在别的回调里(嵌套)就什么也不做
+    class Scope : noncopyable
+    {
+    public:
+        Scope(LoopHeartbeat &heartbeat, const char *owner, const char *tag, const std::string *name)
+            :heartbeat_(heartbeat.watched() && !heartbeat.inCallback() ? &heartbeat : nullptr)
+        {
+            if(heartbeat_ != nullptr)
+            {
+                heartbeat_->enter(owner, tag, name);
+            }
+        }
+        ~Scope()
+        {
+            if(heartbeat_ != nullptr)
+            {
+                heartbeat_->leave();
+            }
+        }
+
+    private:
+        LoopHeartbeat *heartbeat_;
+    };
+
+    LoopHeartbeat(EventLoop *loop, pid_t tid);
+
+    bool watched() const { return watched_.load(std::memory_order_relaxed); }
+    bool inCallback() const { return seq_.load(std::memory_order_relaxed) & 1; }
+
+    //owner、tag必须是字符串字面量这种一直有效的字符串，name可以为空
+    void enter(const char *owner, const char *tag, const std::string *name);
+    void leave() { seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+
+private:
+    friend class LoopWatchdog;
+    static const size_t kNameWords = kNameSize / sizeof(uint64_t);
+
+    EventLoop *loop_;   //只用来打印，loop析构以后心跳还可能被看门狗持有
+    const pid_t tid_;
+    std::atomic_bool watched_;
+    std::atomic<uint64_t> seq_;
+    std::atomic<const char*> owner_;
+    std::atomic<const char*> tag_;
+    std::atomic<uint64_t> name_[kNameWords];
+};
+
+/**
+ * loop卡死检测：一个看门狗线程每隔threshold/4看一眼所有被看守loop的心跳，
+ * 同一个回调(seq_没变、还是奇数)持续超过threshold，就报告是哪个loop、哪条连接、哪个回调卡住了，
+ * 可选再给卡住的线程发一个信号，信号处理函数在那个线程里把调用栈打到stderr
+ * 回调结束以后把卡住的时长记进直方图
+ *
+ * loop线程上没有取时间的操作，卡住的时长是看门狗按检查周期量出来的，误差在一个检查周期以内
+ * 心跳用shared_ptr共享，被看守的loop可以比看门狗先析构
+ */
+class LoopWatchdog : noncopyable
+{
+public:
+    struct Stats
+    {
+        uint64_t stalls;                    //超过阈值的回调个数
+        LoopProfiler::Histogram stallMs;    //卡住的时长，毫秒，按2的幂分桶，同LoopProfiler
+    };
+
+    explicit LoopWatchdog(double thresholdSeconds = 0.1);
+    ~LoopWatchdog();
+
+    //开始看守loop，可以在任何线程调用，start前后都可以
+    void watch(EventLoop *loop);
+
+    /**
+     * 发现卡住的时候给那个loop线程发signo，信号处理函数用backtrace把调用栈打到stderr
+     * 会覆盖signo原来的处理函数，不要选程序自己用到的信号。函数名要链接时加-rdynamic才打得出来
+     */
+    void enableStackSampling(int signo);
+
+    void start();
+    void stop();
+
+    //所有loop合在一起的统计，可以在任何线程调用
+    Stats stats() const;
+    //一个loop的统计，没看守过这个loop返回全0
+    Stats stats(EventLoop *loop) const;
+
+private:
+    struct Watched
+    {
+        std::shared_ptr<LoopHeartbeat> heartbeat;
+        uint64_t lastSeq;       //上次检查看到的seq
+        int64_t firstSeenMs;    //第一次看到这个回调还在执行的时间
+        bool reported;
+        Stats stats;
+    };
+
+    void threadFunc();
+    void check(Watched &watched, int64_t nowMs);
+    void report(Watched &watched, int64_t stalledMs);
+    static void addStats(Stats *to, const Stats &from);
+
+    const int64_t thresholdMs_;
+    const int64_t intervalMs_;
+    int stackSignal_;   //0表示不采样调用栈
+
+    mutable std::mutex mutex_;
+    std::condition_variable cond_;
+    std::vector<Watched> loops_;
+    bool running_;
+    Thread thread_;
+};
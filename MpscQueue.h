@@ -0,0 +1,136 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <stddef.h>
+
+/**
+ * 多生产者单消费者的无锁队列(Vyukov的链表队列)，链表指针和数据放在同一个节点里
+ * push可以在任何线程调用，只用一次原子交换，不加锁；consume只能由消费者线程(loop线程)调用
+ *
+ * 链表头上总有一个哑节点，消费者取走一个元素以后，这个元素的节点就成了新的哑节点
+ *
+ * 节点循环使用：消费者把用完的节点压到freeList_上，生产者一次把整条freeList_换到自己线程的缓存里，
+ * 之后从缓存里取，稳定以后push不再分配内存。生产者只会整条取走，不会单个弹出，所以没有ABA问题
+ */
+template <typename T>
+class MpscQueue : noncopyable
+{
+public:
+    MpscQueue()
+        :head_(new Node)
+        ,freeList_(nullptr)
+        ,tail_(head_)
+    {}
+    ~MpscQueue()
+    {
+        deleteList(head_);
+        deleteList(freeList_.load());
+    }
+
+    void push(T value)
+    {
+        Node *node = allocateNode();
+        node->value = std::move(value);
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node *prev = tail_.exchange(node);
+        //交换完到这里之间，消费者能看到tail_但是还走不到node，consume会等这一步完成
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    /**
+     * 按顺序对调用时已经在队列里的元素执行f，执行过程中新push进来的留到下一次
+     * 返回处理了多少个元素
+     */
+    template <typename Func>
+    size_t consume(Func f)
+    {
+        Node *last = tail_.load();
+        size_t count = 0;
+        while(head_ != last)
+        {
+            Node *next = head_->next.load(std::memory_order_acquire);
+            if(next == nullptr)
+            {
+                //生产者交换完tail_还没来得及链上，让它先跑
+                std::this_thread::yield();
+                continue;
+            }
+            recycleNode(head_);
+            head_ = next;
+            f(next->value);
+            next->value = T();  //哑节点不再持有数据，里面的shared_ptr之类现在就释放
+            ++count;
+        }
+        return count;
+    }
+
+    //只有消费者调用，生产者交换完tail_还没链上的也算非空
+    bool empty() const { return tail_.load() == head_; }
+
+private:
+    struct Node
+    {
+        Node() : next(nullptr) {}
+        std::atomic<Node*> next;
+        T value;
+    };
+
+    //每个生产者线程一份的空闲节点缓存，节点可以在不同队列之间流动
+    struct NodeCache
+    {
+        Node *head = nullptr;
+        ~NodeCache() { deleteList(head); }
+    };
+
+    static NodeCache& localCache()
+    {
+        static thread_local NodeCache cache;
+        return cache;
+    }
+
+    Node* allocateNode()
+    {
+        NodeCache &cache = localCache();
+        if(cache.head == nullptr)
+        {
+            cache.head = freeList_.exchange(nullptr, std::memory_order_acquire);
+        }
+        Node *node = cache.head;
+        if(node == nullptr)
+        {
+            return new Node;
+        }
+        cache.head = node->next.load(std::memory_order_relaxed);
+        return node;
+    }
+
+    //只有消费者调用
+    void recycleNode(Node *node)
+    {
+        Node *head = freeList_.load(std::memory_order_relaxed);
+        do
+        {
+            node->next.store(head, std::memory_order_relaxed);
+        } while(!freeList_.compare_exchange_weak(head, node,
+                    std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    static void deleteList(Node *node)
+    {
+        while(node != nullptr)
+        {
+            Node *next = node->next.load(std::memory_order_relaxed);
+            delete node;
+            node = next;
+        }
+    }
+
+    Node *head_;                    //消费者独占，总是指向哑节点
+    std::atomic<Node*> freeList_;   //消费者用完的节点
+    char pad_[64 - 2 * sizeof(Node*)];  //消费者用的和生产者抢的不放在同一个cache line上
+    std::atomic<Node*> tail_;       //生产者在这里交换
+};
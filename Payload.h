@@ -0,0 +1,39 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <string>
+#include <stddef.h>
+
+class Payload;
+using PayloadPtr = std::shared_ptr<const Payload>;
+
+/**
+ * 不可变的共享消息体，广播的时候同一份消息挂到很多连接的发送队列上，只保存引用不拷贝，
+ * 发送时直接从这块内存writev出去。每个还没发完它的连接持有一个引用，
+ * 最后一个连接发完(或者连接断开)时内存释放。引用计数是原子的，可以在任意线程send
+ */
+class Payload : noncopyable
+{
+public:
+    static PayloadPtr create(const void* data, size_t len)
+    {
+        return std::make_shared<const Payload>(std::string(static_cast<const char*>(data), len));
+    }
+    static PayloadPtr create(std::string&& data)
+    {
+        return std::make_shared<const Payload>(std::move(data));
+    }
+
+    //用create创建，make_shared要求构造函数是public的
+    explicit Payload(std::string&& data)
+        :data_(std::move(data))
+    {}
+
+    const char* data() const { return data_.data(); }
+    size_t size() const { return data_.size(); }
+
+private:
+    const std::string data_;
+};
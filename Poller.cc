@@ -8,6 +8,5 @@ Poller::Poller(EventLoop *loop)
 Poller::~Poller() = default;
 
 bool Poller::hasChannel(Channel *channel) const{
-    auto it = channels_.find(channel->fd());
-    return it != channels_.end() && it->second == channel;
+    return channels_.get(channel->fd()) == channel;
 }
\ No newline at end of file
@@ -4,7 +4,7 @@
 #include "Timestamp.h"
 
 #include<vector>
-#include<unordered_map>
+#include<stddef.h>
 
 //只用到指针类型 
 class Channel;
@@ -26,12 +26,58 @@ public:
     //判断当前Channel是否在Poller当中
     bool hasChannel(Channel *channel) const;
 
+    //Poller能否替TcpConnection异步提交recv/send(io_uring读写模式)，其他实现都不支持
+    //提交的结果通过Channel::set_recvResult/set_sendResult带回，在Channel::handleEvent里回调
+    virtual bool asyncIoEnabled() const { return false; }
+    virtual void submitRecv(Channel* /*channel*/, char* /*buf*/, size_t /*len*/) {}
+    virtual void submitSend(Channel* /*channel*/, const char* /*buf*/, size_t /*len*/) {}
+
     //EventLoop可以通过该接口获取默认的IO复用的具体实现 
-    static Poller* newDefaultPoller(EventLoop *loop);
+    //type是EventLoop::PollerType，kDefaultPoller时看环境变量MUDUO_USE_URING
+    static Poller* newDefaultPoller(EventLoop *loop, int type);
 
 protected:
-    //map的key：sockfd  value：sockfd所属的channel通道类型
-    using ChannelMap = std::unordered_map<int,Channel*>;
+    /**
+     * sockfd => sockfd所属的channel通道类型
+     * fd是内核从小往大分配的小整数，直接用fd做vector下标，查找和删除都是O(1)的数组访问，
+     * 不用算哈希，也不用每个连接分配一个哈希表节点
+     */
+    class ChannelMap
+    {
+    public:
+        ChannelMap() : size_(0) {}
+
+        //fd没有对应的Channel返回nullptr
+        Channel* get(int fd) const
+        {
+            return static_cast<size_t>(fd) < slots_.size() ? slots_[fd] : nullptr;
+        }
+        void set(int fd, Channel *channel)
+        {
+            if(static_cast<size_t>(fd) >= slots_.size())
+            {
+                slots_.resize(fd + 1, nullptr);
+            }
+            if(slots_[fd] == nullptr)
+            {
+                ++size_;
+            }
+            slots_[fd] = channel;
+        }
+        void erase(int fd)
+        {
+            if(static_cast<size_t>(fd) < slots_.size() && slots_[fd] != nullptr)
+            {
+                slots_[fd] = nullptr;
+                --size_;
+            }
+        }
+        size_t size() const { return size_; }
+
+    private:
+        std::vector<Channel*> slots_;
+        size_t size_;
+    };
     ChannelMap channels_;
 private:
     EventLoop *ownerLoop_; // 定义Poller所属的事件循环EventLoop
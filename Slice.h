@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <stddef.h>
+
+/**
+ * 一段不拥有所有权的内存，用来描述header、body、trailer这样分散在多处的数据，
+ * TcpConnection::send(const std::vector<Slice>&)用一次writev把它们发出去，不用先拼接
+ * Slice只是引用，调用send期间指向的内存必须有效
+ */
+struct Slice
+{
+    Slice(const void* d, size_t n)
+        :data(d)
+        ,len(n)
+    {}
+    Slice(const std::string& s)
+        :data(s.data())
+        ,len(s.size())
+    {}
+
+    const void* data;
+    size_t len;
+};
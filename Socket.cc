@@ -8,6 +8,8 @@
 #include<strings.h>
 #include <netinet/tcp.h>
 #include <netinet/in.h>
+#include <errno.h>
+#include <linux/filter.h>
 
 Socket::~Socket()
 {
@@ -72,4 +74,52 @@ void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
-}
\ No newline at end of file
+}
+void Socket::setBusyPoll(int microseconds)
+{
+    if(::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &microseconds, sizeof microseconds) < 0)
+    {
+        LOG_ERROR("setsockopt SO_BUSY_POLL fd=%d usec=%d errno=%d \n", sockfd_, microseconds, errno);
+    }
+}
+int Socket::incomingCpu() const
+{
+    int cpu = -1;
+    socklen_t len = sizeof cpu;
+    if(::getsockopt(sockfd_, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0)
+    {
+        return -1;
+    }
+    return cpu;
+}
+bool Socket::attachCpuSteering(const std::vector<int> &cpuOfIndex)
+{
+    if(cpuOfIndex.empty())
+    {
+        return false;
+    }
+    //A = 收包CPU；逐个比较，命中就返回下标；都不是就返回 A % 组里的socket数
+    std::vector<sock_filter> code;
+    code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)));
+    for(size_t i = 0; i < cpuOfIndex.size(); ++i)
+    {
+        if(cpuOfIndex[i] < 0)
+        {
+            continue;
+        }
+        code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(cpuOfIndex[i]), 0, 1));
+        code.push_back(BPF_STMT(BPF_RET | BPF_K, static_cast<uint32_t>(i)));
+    }
+    code.push_back(BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, static_cast<uint32_t>(cpuOfIndex.size())));
+    code.push_back(BPF_STMT(BPF_RET | BPF_A, 0));
+
+    sock_fprog prog;
+    prog.len = static_cast<unsigned short>(code.size());
+    prog.filter = code.data();
+    if(::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof prog) < 0)
+    {
+        LOG_ERROR("setsockopt SO_ATTACH_REUSEPORT_CBPF fd=%d errno=%d \n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
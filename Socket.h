@@ -1,6 +1,8 @@
 #pragma once
 #include "noncopyable.h"
 
+#include <vector>
+
 class InetAddress;
 
 //封装Socket fd
@@ -24,6 +26,15 @@ public:
     void setReuseAddr(bool on);
     void setReusePort(bool on);
     void setKeepAlive(bool on);
+    //SO_BUSY_POLL，阻塞读没有数据时在网卡队列上忙等microseconds微秒，超过net.core.busy_read要CAP_NET_ADMIN
+    void setBusyPoll(int microseconds);
+    //SO_INCOMING_CPU，最近一次处理这个连接收包的CPU，内核不支持或者还没收过包返回-1
+    int incomingCpu() const;
+    /**
+     * 给这个socket所在的SO_REUSEPORT组挂一个cBPF程序(SO_ATTACH_REUSEPORT_CBPF)，按收包的CPU选组里的socket：
+     * 在CPU cpuOfIndex[i]上收到的SYN交给组里第i个listen的socket，别的CPU按CPU号取模，cpuOfIndex里小于0的跳过
+     */
+    bool attachCpuSteering(const std::vector<int> &cpuOfIndex);
 private:
     const int sockfd_;
 };
\ No newline at end of file
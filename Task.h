@@ -0,0 +1,178 @@
+#pragma once
+
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+
+template <typename Signature>
+class Task;
+
+/**
+ * 只能移动、不能拷贝的可调用对象，用在EventLoop的回调队列和Channel的回调上，代替std::function
+ * std::function要求可拷贝，内部缓冲区只有16字节，bind一个成员函数指针加this就要在堆上分配一次
+ * Task内部有kInlineSize字节的缓冲区，bind成员函数指针、一个shared_ptr再加一个std::string也放得下，
+ * 放不下的(或者移动构造可能抛异常的)才分配到堆上
+ */
+template <typename R, typename... Args>
+class Task<R(Args...)>
+{
+public:
+    static const size_t kInlineSize = 64;
+
+    Task() : ops_(nullptr) {}
+    Task(std::nullptr_t) : ops_(nullptr) {}
+
+    template <typename F,
+              typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F &&f) : ops_(nullptr)
+    {
+        typedef typename std::decay<F>::type Func;
+        construct<Func>(std::forward<F>(f), FitsInline<Func>());
+    }
+
+    Task(Task &&other) : ops_(other.ops_)
+    {
+        if(ops_ != nullptr)
+        {
+            ops_->move(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task &&other)
+    {
+        if(this != &other)
+        {
+            reset();
+            if(other.ops_ != nullptr)
+            {
+                other.ops_->move(&storage_, &other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    Task& operator=(std::nullptr_t)
+    {
+        reset();
+        return *this;
+    }
+
+    template <typename F,
+              typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task& operator=(F &&f)
+    {
+        *this = Task(std::forward<F>(f));
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+
+    R operator()(Args... args) const
+    {
+        if(ops_ == nullptr)
+        {
+            throw std::bad_function_call();
+        }
+        return ops_->invoke(&storage_, std::forward<Args>(args)...);
+    }
+
+private:
+    typedef typename std::aligned_storage<kInlineSize, alignof(std::max_align_t)>::type Storage;
+
+    //每种可调用对象一张函数表，Task里只存一个指针
+    struct Ops
+    {
+        R (*invoke)(void *storage, Args&&... args);
+        void (*move)(void *dst, void *src);  //移动到dst，并析构src
+        void (*destroy)(void *storage);
+    };
+
+    template <typename F>
+    struct FitsInline : std::integral_constant<bool,
+        sizeof(F) <= kInlineSize && alignof(Storage) % alignof(F) == 0
+        && std::is_nothrow_move_constructible<F>::value> {};
+
+    //可调用对象直接放在storage_里
+    template <typename F>
+    struct InlineOps
+    {
+        static R invoke(void *storage, Args&&... args)
+        {
+            return (*static_cast<F*>(storage))(std::forward<Args>(args)...);
+        }
+        static void move(void *dst, void *src)
+        {
+            F *f = static_cast<F*>(src);
+            ::new (dst) F(std::move(*f));
+            f->~F();
+        }
+        static void destroy(void *storage)
+        {
+            static_cast<F*>(storage)->~F();
+        }
+        static const Ops* get()
+        {
+            static const Ops ops = { &invoke, &move, &destroy };
+            return &ops;
+        }
+    };
+
+    //storage_里只放一个指向堆上对象的指针，移动的时候只挪指针
+    template <typename F>
+    struct HeapOps
+    {
+        static R invoke(void *storage, Args&&... args)
+        {
+            return (**static_cast<F**>(storage))(std::forward<Args>(args)...);
+        }
+        static void move(void *dst, void *src)
+        {
+            *static_cast<F**>(dst) = *static_cast<F**>(src);
+        }
+        static void destroy(void *storage)
+        {
+            delete *static_cast<F**>(storage);
+        }
+        static const Ops* get()
+        {
+            static const Ops ops = { &invoke, &move, &destroy };
+            return &ops;
+        }
+    };
+
+    template <typename F, typename G>
+    void construct(G &&f, std::true_type)
+    {
+        ::new (static_cast<void*>(&storage_)) F(std::forward<G>(f));
+        ops_ = InlineOps<F>::get();
+    }
+
+    template <typename F, typename G>
+    void construct(G &&f, std::false_type)
+    {
+        *reinterpret_cast<F**>(&storage_) = new F(std::forward<G>(f));
+        ops_ = HeapOps<F>::get();
+    }
+
+    void reset()
+    {
+        if(ops_ != nullptr)
+        {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    mutable Storage storage_;   //operator()是const的，和std::function一样，可调用对象本身可以改自己的状态
+    const Ops *ops_;
+};
@@ -3,16 +3,41 @@
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "BufferPool.h"
+#include "TimingWheel.h"
 
 #include <functional>
 #include <errno.h>
 #include <memory>
+#include <map>
 #include <sys/types.h>         
 #include <sys/socket.h>
 #include<strings.h>
 #include <netinet/tcp.h>
 #include <netinet/in.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <limits.h>
+
+namespace
+{
+/**
+ * 每个loop线程按回收时间(setBufferIdleRelease的秒数)分成几条链表，同一条链表里的连接超时时间一样，
+ * 按最近活跃时间排序就是按到期时间排序，最久没有读写的连接在最前面。不同连接的回收时间不一样也不会互相挡住
+ * 实际用到的回收时间一般只有一两种，map里的链表不删，节点地址不变，连接里直接存链表指针
+ */
+struct IdleBufferLists
+{
+    std::map<int, std::list<TcpConnection*>> lists;
+    bool registered;
+};
+thread_local IdleBufferLists t_idleBuffers = { std::map<int, std::list<TcpConnection*>>(), false };
+}
+
+//边沿触发时一次事件默认最多读写的字节数
+const size_t kEdgeTriggeredBudget = 1024 * 1024;
 
 static EventLoop* CheckLoopNotNull(EventLoop* loop)
 {
@@ -37,9 +62,24 @@ TcpConnection::TcpConnection(EventLoop *loop,
                 ,localAddr_(localAddr)
                 ,peerAddr_(peerAddr)
                 ,highWaterMark_(64*1024*1024)
+                ,inputBuffer_(Buffer::kInitialSize, loop->bufferPool())
+                ,outputBuffer_(Buffer::kInitialSize, loop->bufferPool())
+                ,queuedBytes_(0)
+                ,bufferIdleSeconds_(0)
+                ,readDrainBudget_(0)
+                ,lastActive_(0)
+                ,idleList_(nullptr)
+                ,idleTimeoutSeconds_(0)
+                ,idleForceClose_(false)
+                ,asyncIo_(false)
+                ,recvInFlight_(false)
+                ,sendInFlight_(false)
+                ,asyncSendOffset_(0)
 {
     // 我们muduo用户把这些操作注册给TcpServer，TcpServer传递给TcpConnection，
     // TcpConnection给Channel设置回调函数，这些方法都是Poller监听到事件后，Channel需要调用的函数
+    loop_->connectionAdded();
+    channel_->setWatchName("TcpConnection", &name_);
     channel_->setReadCallBack(
         std::bind(&TcpConnection::handleRead, this, std::placeholders::_1)
     );
@@ -59,7 +99,14 @@ TcpConnection::TcpConnection(EventLoop *loop,
 }
 TcpConnection::~TcpConnection()
 {
-    // 析构函数不需要做什么，只有socket_、channel_是new出来的，这俩用智能指针管理会自动释放
+    // socket_、channel_是new出来的，这俩用智能指针管理会自动释放，只有还没发完的文件fd需要自己关
+    for (const OutputChunk &chunk : outputQueue_)
+    {
+        if (chunk.fd >= 0)
+        {
+            ::close(chunk.fd);
+        }
+    }
     LOG_INFO("TcpConnection::dtor[%s] at fd=%d state=%d\n", name_.c_str(), socket_->fd(), (int)state_);
 }
 
@@ -87,16 +134,150 @@ void TcpConnection::send(const std::string& buf)
             sendInLoop(buf.c_str(),buf.size());
         }
         else
+        {
+            // 不能只传buf.c_str()，loop线程执行的时候调用方的buf可能已经析构了
+            loop_->runInLoop(std::bind(
+                &TcpConnection::sendStringInLoop,
+                shared_from_this(),
+                buf
+                ));
+        }
+    }
+}
+
+void TcpConnection::send(std::string&& buf)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(buf.data(), buf.size());
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(
+                &TcpConnection::sendStringInLoop,
+                shared_from_this(),
+                std::move(buf)
+                ));
+        }
+    }
+}
+
+void TcpConnection::send(const std::vector<Slice>& slices)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendInLoop(slices.data(), slices.size());
+        }
+        else
+        {
+            std::string message;
+            for (const Slice &slice : slices)
+            {
+                message.append(static_cast<const char*>(slice.data), slice.len);
+            }
+            loop_->runInLoop(std::bind(
+                &TcpConnection::sendStringInLoop,
+                shared_from_this(),
+                std::move(message)
+                ));
+        }
+    }
+}
+
+void TcpConnection::sendStringInLoop(const std::string& message)
+{
+    sendInLoop(message.data(), message.size());
+}
+
+void TcpConnection::send(const PayloadPtr& payload)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendPayloadInLoop(payload);
+        }
+        else
         {
             loop_->runInLoop(std::bind(
-                &TcpConnection::sendInLoop,
-                this,
-                buf.c_str(),
-                buf.size()
+                &TcpConnection::sendPayloadInLoop,
+                shared_from_this(),
+                payload
                 ));
         }
     }
 }
+
+/**
+ * 前面没有待发送数据时直接从payload写socket，写不完的部分把payload的引用挂到outputQueue_上，
+ * 记下已经发送的偏移，不拷贝数据
+ */
+void TcpConnection::sendPayloadInLoop(const PayloadPtr& payload)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+    size_t len = payload->size();
+    if (len == 0)
+    {
+        return;
+    }
+    touchIdleBuffers();
+
+    ssize_t nwrote = 0;
+    size_t remaining = len;
+    bool faultError = false;
+    if (!asyncIo_ && !channel_->isWriting() && pendingBytes() == 0)
+    {
+        nwrote = ::write(channel_->fd(), payload->data(), len);
+        if (nwrote >= 0)
+        {
+            if (nwrote > 0)
+            {
+                touchIdleTimeout();
+            }
+            remaining = len - nwrote;
+            if (remaining == 0 && writeCompleteCallback_)
+            {
+                loop_->queueInLoop(
+                    std::bind(writeCompleteCallback_, shared_from_this())
+                );
+            }
+        }
+        else
+        {
+            nwrote = 0;
+            if (errno != EWOULDBLOCK)
+            {
+                LOG_ERROR("TcpConnection::sendPayloadInLoop \n");
+                if (errno == EPIPE || errno == ECONNRESET)
+                {
+                    faultError = true;
+                }
+            }
+        }
+    }
+
+    if (!faultError && remaining > 0)
+    {
+        checkHighWaterMark(remaining);
+        // outputQueue_排在outputBuffer_后面，直接入队顺序也是对的
+        OutputChunk chunk;
+        chunk.fd = -1;
+        chunk.offset = nwrote;
+        chunk.remaining = remaining;
+        chunk.payload = payload;
+        outputQueue_.push_back(std::move(chunk));
+        queuedBytes_ += remaining;
+        scheduleWrite();
+    }
+}
 /**
  * 发送数据，应用写的快，而内核发送数据慢，需要把待发送数据写入缓冲区，
  * 而且设置了水位回调
@@ -113,14 +294,36 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
         LOG_ERROR("disconnected, give up writing!");
         return;
     }
+    touchIdleBuffers();
+
+    //读写模式下没有待发送数据时直接拷一份交给io_uring，发送完成回调里再通知用户
+    if (asyncIo_ && !channel_->isWriting() && pendingBytes() == 0)
+    {
+        if (len == 0)
+        {
+            // 没有数据就不提交长度为0的send，和同步write(len=0)一样直接算发送完成
+            if (writeCompleteCallback_)
+            {
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+            }
+            return;
+        }
+        asyncSendBuf_.assign(static_cast<const char*>(data), len);
+        submitAsyncSend();
+        return;
+    }
     
     //刚开始我们注册的感兴趣的都是socket读事件，写事件刚开始没有注册过
     //表示channel第一次开始写数据，而且缓冲区没有待发送数据
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    if (!channel_->isWriting() && pendingBytes() == 0)
     {
         nwrote = ::write(channel_->fd(), data, len);
         if (nwrote >= 0)
         {
+            if (nwrote > 0)
+            {
+                touchIdleTimeout();
+            }
             remaining = len - nwrote;
             if (remaining == 0 && writeCompleteCallback_)
             {
@@ -157,27 +360,220 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
      */
     if (!faultError && remaining > 0)
     {
-        // 目前outputBuffer_中积攒的待发送的数据
-        size_t oldlen = outputBuffer_.readableBytes();
-        if (oldlen + remaining >= highWaterMark_
-            && oldlen < highWaterMark_
-            && highWaterMarkCallback_)
+        checkHighWaterMark(remaining);
+        // 剩余没发送完的数据写入outputBuffer_
+        appendOutput((char*)data + nwrote, remaining);
+        // 给Channel注册EPOLLOUT写事件，否则当内核的TCP发送缓冲区没有数据时，Poller不会给Channel通知，
+        // Channel就不会调用writeCallback_，即TcpConnection::handleWrite
+        scheduleWrite();
+    }
+}
+
+/**
+ * scatter-gather版本的sendInLoop，前面没有待发送数据时用一次writev把各段数据直接写到socket，
+ * 一次最多IOV_MAX段，写不完的部分按顺序拷贝进outputBuffer_，已经写出去的部分不拷贝
+ */
+void TcpConnection::sendInLoop(const Slice* slices, size_t count)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up writing!");
+        return;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        total += slices[i].len;
+    }
+    if (total == 0)
+    {
+        return;
+    }
+    touchIdleBuffers();
+
+    size_t nwrote = 0;
+    bool faultError = false;
+    if (asyncIo_ && !channel_->isWriting() && pendingBytes() == 0)
+    {
+        asyncSendBuf_.clear();
+        for (size_t i = 0; i < count; ++i)
         {
-            // 如果以前积攒的数据不足水位 && 以前积攒的加上本次需要写入outputBuffer_的数据大于水位 && 注册了highWaterMarkCallback_
-            // 调用highWaterMarkCallback_
-            loop_->queueInLoop(
-                std::bind(highWaterMarkCallback_, shared_from_this(), oldlen + remaining)
-            );
+            asyncSendBuf_.append(static_cast<const char*>(slices[i].data), slices[i].len);
         }
-        // 剩余没发送完的数据写入outputBuffer_
-        outputBuffer_.append((char*)data + nwrote, remaining);
-        if (!channel_->isWriting())
+        submitAsyncSend();
+        return;
+    }
+    if (!channel_->isWriting() && pendingBytes() == 0)
+    {
+        struct iovec vec[IOV_MAX];
+        int iovcnt = static_cast<int>(std::min(count, static_cast<size_t>(IOV_MAX)));
+        for (int i = 0; i < iovcnt; ++i)
+        {
+            vec[i].iov_base = const_cast<void*>(slices[i].data);
+            vec[i].iov_len = slices[i].len;
+        }
+        ssize_t n = ::writev(channel_->fd(), vec, iovcnt);
+        if (n >= 0)
+        {
+            if (n > 0)
+            {
+                touchIdleTimeout();
+            }
+            nwrote = n;
+            if (nwrote == total && writeCompleteCallback_)
+            {
+                loop_->queueInLoop(
+                    std::bind(writeCompleteCallback_, shared_from_this())
+                );
+            }
+        }
+        else if (errno != EWOULDBLOCK)
+        {
+            LOG_ERROR("TcpConnection::sendInLoop writev \n");
+            if (errno == EPIPE || errno == ECONNRESET)
+            {
+                faultError = true;
+            }
+        }
+    }
+
+    if (!faultError && nwrote < total)
+    {
+        checkHighWaterMark(total - nwrote);
+        // 跳过已经写出去的nwrote字节，后面的按顺序放进outputBuffer_
+        size_t skip = nwrote;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (skip >= slices[i].len)
+            {
+                skip -= slices[i].len;
+                continue;
+            }
+            appendOutput(static_cast<const char*>(slices[i].data) + skip, slices[i].len - skip);
+            skip = 0;
+        }
+        scheduleWrite();
+    }
+}
+
+void TcpConnection::checkHighWaterMark(size_t incoming)
+{
+    // 目前outputBuffer_和outputQueue_中积攒的待发送的数据
+    size_t oldlen = pendingBytes();
+    if (oldlen + incoming >= highWaterMark_
+        && oldlen < highWaterMark_
+        && highWaterMarkCallback_)
+    {
+        // 如果以前积攒的数据不足水位 && 以前积攒的加上本次需要写入outputBuffer_的数据大于水位 && 注册了highWaterMarkCallback_
+        // 调用highWaterMarkCallback_
+        loop_->queueInLoop(
+            std::bind(highWaterMarkCallback_, shared_from_this(), oldlen + incoming)
+        );
+    }
+}
+
+void TcpConnection::appendOutput(const char* data, size_t len)
+{
+    // 前面有文件或共享消息在排队的话只能排到它们后面，队尾不是普通数据块就新建一个
+    if (outputQueue_.empty())
+    {
+        outputBuffer_.append(data, len);
+        return;
+    }
+    if (outputQueue_.back().fd >= 0 || outputQueue_.back().payload)
+    {
+        OutputChunk chunk;
+        chunk.fd = -1;
+        chunk.offset = 0;
+        chunk.remaining = 0;
+        outputQueue_.push_back(std::move(chunk));
+    }
+    OutputChunk &tail = outputQueue_.back();
+    tail.data.append(data, len);
+    tail.remaining += len;
+    queuedBytes_ += len;
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t len)
+{
+    if (state_ != kConnected)
+    {
+        return;
+    }
+    // dup一份，用户调用完就可以close自己的fd，发完以后我们自己关
+    int filefd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (filefd < 0)
+    {
+        LOG_ERROR("TcpConnection::sendFile dup fd=%d err:%d \n", fd, errno);
+        return;
+    }
+    if (loop_->isInLoopThread())
+    {
+        sendFileInLoop(filefd, offset, len);
+    }
+    else
+    {
+        loop_->runInLoop(std::bind(
+            &TcpConnection::sendFileInLoop,
+            shared_from_this(),
+            filefd,
+            offset,
+            len
+            ));
+    }
+}
+
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t len)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR("disconnected, give up sending file!");
+        ::close(fd);
+        return;
+    }
+    touchIdleBuffers();
+
+    size_t remaining = len;
+    bool faultError = false;
+    // 前面没有排队的数据，直接sendfile，一次发完就不用排队了
+    if (!asyncIo_ && !channel_->isWriting() && pendingBytes() == 0)
+    {
+        ssize_t n = ::sendfile(channel_->fd(), fd, &offset, remaining);
+        if (n >= 0)
+        {
+            if (n > 0)
+            {
+                touchIdleTimeout();
+            }
+            remaining -= n;
+        }
+        else if (errno != EWOULDBLOCK)
+        {
+            LOG_ERROR("TcpConnection::sendFileInLoop \n");
+            faultError = true;
+        }
+    }
+
+    if (faultError || remaining == 0)
+    {
+        ::close(fd);
+        if (!faultError && writeCompleteCallback_)
         {
-            // 给Channel注册EPOLLOUT写事件，否则当内核的TCP发送缓冲区没有数据时，Poller不会给Channel通知，
-            // Channel就不会调用writeCallback_，即TcpConnection::handleWrite
-            channel_->enableWriting();
+            loop_->queueInLoop(
+                std::bind(writeCompleteCallback_, shared_from_this())
+            );
         }
+        return;
     }
+
+    checkHighWaterMark(remaining);
+    OutputChunk chunk;
+    chunk.fd = fd;
+    chunk.offset = offset;
+    chunk.remaining = remaining;
+    outputQueue_.push_back(std::move(chunk));
+    queuedBytes_ += remaining;
+    scheduleWrite();
 }
 
 //关闭连接
@@ -190,25 +586,81 @@ void TcpConnection::shutdown()
     }
 }
 
+void TcpConnection::forceClose()
+{
+    if(state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if(state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
+    }
+}
+
 void TcpConnection::shutdownInLoop()
 {
     // 有可能数据还没发送完就调用了shutdown，先等待数据发送完，发送完后handleWrite内会调用shutdownInLoop
-    if (!channel_->isWriting())//说明outputBuffer_中的数据已经发送完成
+    if (!channel_->isWriting() && !sendInFlight_)//说明outputBuffer_中的数据已经发送完成
     {
         socket_->shutdownWrite();//关闭写端
     }
 }
+void TcpConnection::setEdgeTriggered(bool on)
+{
+    channel_->setEdgeTriggered(on);
+}
+
+size_t TcpConnection::edgeBudget() const
+{
+    return readDrainBudget_ > 0 ? readDrainBudget_ : kEdgeTriggeredBudget;
+}
+
 //建立连接
 void TcpConnection::connectEstablished()
 {
     setState(kConnected);
+    if(loop_->socketBusyPoll() > 0)
+    {
+        socket_->setBusyPoll(loop_->socketBusyPoll());
+    }
+    if(idleTimeoutSeconds_ > 0)
+    {
+        loop_->timingWheel()->add(&idleEntry_, idleTimeoutSeconds_,
+            std::bind(&TcpConnection::handleIdleTimeout, this));
+    }
     channel_->tie(shared_from_this());
-    //向Poller注册channel的epollin事件
-    channel_->enableReading();
+    asyncIo_ = loop_->asyncIoEnabled();
+    if(asyncIo_)
+    {
+        channel_->setAsyncRecvCallBack(
+            std::bind(&TcpConnection::handleAsyncRecv, this, std::placeholders::_1, std::placeholders::_2)
+        );
+        channel_->setAsyncSendCallBack(
+            std::bind(&TcpConnection::handleAsyncSend, this, std::placeholders::_1)
+        );
+        //不注册EPOLLIN，直接提交recv，有数据时内核收进inputBuffer_再通知
+        startAsyncRecv();
+    }
+    else
+    {
+        //向Poller注册channel的epollin事件
+        channel_->enableReading();
+    }
     //新连接建立，执行回调
     connectionCallback_(shared_from_this());
 }
 
+int TcpConnection::incomingCpu() const
+{
+    return socket_->incomingCpu();
+}
+
 //销毁连接
 void TcpConnection::connectDestroyed()
 {
@@ -218,7 +670,13 @@ void TcpConnection::connectDestroyed()
         channel_->disableAll(); // 通过epoll_ctl把channel所有感兴趣的事件从poller中del掉
         connectionCallback_(shared_from_this());
     }
+    untrackIdleBuffers();
+    if(idleEntry_.linked())
+    {
+        loop_->timingWheel()->remove(&idleEntry_);
+    }
     channel_->remove(); //把channel从poller中删除
+    loop_->connectionRemoved();
 }
 
 // fd上有读事件到来时，Poller会通知Channel调用相应的回调函数，即handleRead。这个函数用于读取fd上的数据存入inputBuffer_
@@ -227,14 +685,41 @@ void TcpConnection::handleRead(Timestamp receiveTime)
     int savedErrno = 0;
     // 发生了读事件，从channel_的fd中读取数据，存到inputBuffer_
     ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
-    if(n > 0)
+    size_t total = n > 0 ? n : 0;
+    // 开启了readDrainBudget_就接着读，直到读到EAGAIN、对端关闭或者读满预算
+    // 边沿触发必须读到EAGAIN，没设置预算时用默认预算
+    const bool edge = channel_->edgeTriggered();
+    const size_t budget = edge ? edgeBudget() : readDrainBudget_;
+    while(n > 0 && total < budget)
     {
+        n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+        if(n > 0)
+        {
+            total += n;
+        }
+    }
+    if(total > 0)
+    {
+        touchIdleBuffers();
+        touchIdleTimeout();
         // 读取完成后，需要调用用户传入的回调操作，就是我们给TcpServer传入的on_message函数
         // 把当前TcpConnection对象给用户定义的on_message函数，是因为用户需要利用TcpConnection对象给客户端发数据，
         // inputBuffer_就是客户端发来的数据，也传入on_message函数给用户
         // shared_from_this就是获取了当前TcpConnection对象的一个shared_ptr
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
     }
+    if(n > 0 || (n < 0 && savedErrno == EWOULDBLOCK))
+    {
+        // 读满预算或者内核缓冲区读空了，等下一次读事件
+        // 一个字节都没读到的EAGAIN是多余的唤醒(比如io_uring的水平触发探测和数据同时到达)，也不是错误
+        // 边沿触发读满预算时不会再有新的读事件，排到本轮其他连接后面接着读
+        if(n > 0 && edge && state_ != kDisconnected)
+        {
+            loop_->queueInLoop(
+                std::bind(&TcpConnection::resumeRead, shared_from_this(), receiveTime)
+            );
+        }
+    }
     else if(n == 0)//客户端断开了
     {
         handleClose();
@@ -254,35 +739,74 @@ void TcpConnection::handleWrite()
 {
     if(channel_->isWriting())
     {
-        int saveErrno = 0;
-        // 往fd上写outputBuffer_可读区间的数据，写了n个字节，即发送数据
-        int n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
-        if(n > 0) //有数据发送成功
+        // 边沿触发要一直写到EAGAIN，水平触发写一轮就等下一次EPOLLOUT
+        const bool edge = channel_->edgeTriggered();
+        const size_t budget = edgeBudget();
+        size_t before = pendingBytes();
+        while(true)
         {
-            outputBuffer_.retrieve(n); // readerIndex_复位
-            if(outputBuffer_.readableBytes() == 0)
+            const size_t lastPending = pendingBytes();
+            int saveErrno = 0;
+            bool drained = false;
+            // 往fd上写outputBuffer_可读区间的数据，连同后面排队的普通数据一起writev，写了n个字节
+            ssize_t n = writeGather(&saveErrno, &drained);
+            if(n < 0)
             {
-                // outputBuffer_的可读区间为0，已经发送完了，将Channel封装的events置为不可写，底层还是调用的epoll_ctl
-                // Channel调用update remove ==> EventLoop updateChannel removeChannel ==> Poller updateChannel removeChannel
-                channel_->disableWriting();
-                if(writeCompleteCallback_)
+                if(saveErrno != EWOULDBLOCK)
                 {
-                    //唤醒loop对应的thread线程执行回调
-                    loop_->queueInLoop(
-                        std::bind(writeCompleteCallback_,shared_from_this())
-                    );
+                    errno = saveErrno;
+                    LOG_ERROR("TcpConnection::handleWrite");
                 }
-                if(state_ = kDisconnected)
+                return;
+            }
+            if(n > 0)
+            {
+                touchIdleBuffers();
+                touchIdleTimeout();
+            }
+            // 收集到的数据全写完了，队头如果是文件就接着sendfile
+            if(drained && !outputQueue_.empty())
+            {
+                if(!writeOutputQueue(&saveErrno))
                 {
-                    // 读完数据时，如果发现已经调用了shutdown方法，state_会被置为kDisconnecting，
-                    // 则会调用shutdownInLoop，在当前所属的loop里面删除当前TcpConnection对象
-                    shutdownInLoop();
+                    errno = saveErrno;
+                    LOG_ERROR("TcpConnection::handleWrite sendfile");
+                    return;
                 }
             }
+            // 水平触发写一轮就等下一次EPOLLOUT；边沿触发没碰到EAGAIN就接着写，
+            // 只写了一部分的时候下一次writev会碰到EAGAIN返回，收集到的写完了但outputBuffer_没空的时候接着写剩下的
+            if(!edge || pendingBytes() == 0 || saveErrno == EWOULDBLOCK
+                || pendingBytes() == lastPending)
+            {
+                break;
+            }
+            if(before - pendingBytes() >= budget)
+            {
+                loop_->queueInLoop(
+                    std::bind(&TcpConnection::resumeWrite, shared_from_this())
+                );
+                return;
+            }
         }
-        else
+        if(pendingBytes() == 0)
         {
-            LOG_ERROR("TcpConnection::handleWrite");
+            // outputBuffer_的可读区间为0，已经发送完了，将Channel封装的events置为不可写，底层还是调用的epoll_ctl
+            // Channel调用update remove ==> EventLoop updateChannel removeChannel ==> Poller updateChannel removeChannel
+            channel_->disableWriting();
+            if(writeCompleteCallback_)
+            {
+                //唤醒loop对应的thread线程执行回调
+                loop_->queueInLoop(
+                    std::bind(writeCompleteCallback_,shared_from_this())
+                );
+            }
+            if(state_ == kDisconnecting)
+            {
+                // 发完数据时，如果发现已经调用了shutdown方法，state_会被置为kDisconnecting，
+                // 则会调用shutdownInLoop，关闭写端
+                shutdownInLoop();
+            }
         }
     }
     else //对写事件不感兴趣,    要执行handleWrite，但是channel的fd的属性为不可写
@@ -290,6 +814,265 @@ void TcpConnection::handleWrite()
         LOG_ERROR("TcpConnection fd=%d is down, no more writing \n", channel_->fd());
     }
 }
+void TcpConnection::resumeRead(Timestamp receiveTime)
+{
+    if(state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleRead(receiveTime);
+    }
+}
+
+void TcpConnection::resumeWrite()
+{
+    if(state_ != kDisconnected && channel_->isWriting())
+    {
+        handleWrite();
+    }
+}
+
+ssize_t TcpConnection::writeGather(int* saveErrno, bool* drained)
+{
+    struct iovec vec[IOV_MAX];
+    int iovcnt = outputBuffer_.readableIovecs(vec, IOV_MAX);
+    for(const OutputChunk &chunk : outputQueue_)
+    {
+        // 文件只能用sendfile发，后面的数据也不能越过它
+        if(chunk.fd >= 0 || iovcnt == IOV_MAX)
+        {
+            break;
+        }
+        vec[iovcnt].iov_base = const_cast<char*>(chunk.peek());
+        vec[iovcnt].iov_len = chunk.remaining;
+        ++iovcnt;
+    }
+    size_t total = 0;
+    for(int i = 0; i < iovcnt; ++i)
+    {
+        total += vec[i].iov_len;
+    }
+    if(total == 0)
+    {
+        *drained = true;
+        return 0;
+    }
+
+    ssize_t n = ::writev(channel_->fd(), vec, iovcnt);
+    if(n < 0)
+    {
+        *saveErrno = errno;
+        return n;
+    }
+    // 先消费outputBuffer_，剩下的算到排队的数据上
+    size_t fromBuffer = std::min(static_cast<size_t>(n), outputBuffer_.readableBytes());
+    outputBuffer_.retrieve(fromBuffer);
+    size_t rest = n - fromBuffer;
+    while(rest > 0)
+    {
+        OutputChunk &chunk = outputQueue_.front();
+        size_t take = std::min(rest, chunk.remaining);
+        chunk.offset += take;
+        chunk.remaining -= take;
+        queuedBytes_ -= take;
+        rest -= take;
+        if(chunk.remaining == 0)
+        {
+            outputQueue_.pop_front();
+        }
+    }
+    // outputBuffer_最多只收集了IOV_MAX段，收集到的写完了缓冲区里也可能还有数据，文件要等它真的空了再发
+    *drained = static_cast<size_t>(n) == total && outputBuffer_.readableBytes() == 0;
+    return n;
+}
+
+bool TcpConnection::writeOutputQueue(int* saveErrno)
+{
+    while(!outputQueue_.empty())
+    {
+        OutputChunk &chunk = outputQueue_.front();
+        ssize_t n = 0;
+        if(chunk.fd >= 0)
+        {
+            n = ::sendfile(channel_->fd(), chunk.fd, &chunk.offset, chunk.remaining);
+        }
+        else
+        {
+            n = ::write(channel_->fd(), chunk.peek(), chunk.remaining);
+            if(n > 0)
+            {
+                chunk.offset += n;
+            }
+        }
+
+        if(n < 0)
+        {
+            if(errno == EWOULDBLOCK)
+            {
+                *saveErrno = EWOULDBLOCK;
+                break; // 内核发送缓冲区满了，等下一次EPOLLOUT
+            }
+            *saveErrno = errno;
+            return false;
+        }
+        if(n == 0 && chunk.fd >= 0)
+        {
+            // 文件比sendFile时说的短(被截断了)，剩下的发不出去了，丢掉
+            LOG_ERROR("TcpConnection::writeOutputQueue file fd=%d ended early \n", chunk.fd);
+            n = chunk.remaining;
+        }
+        touchIdleBuffers();
+        touchIdleTimeout();
+        chunk.remaining -= n;
+        queuedBytes_ -= n;
+        if(chunk.remaining > 0)
+        {
+            break;
+        }
+        if(chunk.fd >= 0)
+        {
+            ::close(chunk.fd);
+        }
+        outputQueue_.pop_front();
+    }
+    return true;
+}
+
+void TcpConnection::startAsyncRecv()
+{
+    inputBuffer_.ensureWritableBytes(Buffer::kInitialSize);
+    recvInFlight_ = true;
+    loop_->submitRecv(channel_.get(), inputBuffer_.beginWrite(), inputBuffer_.writableBytes());
+}
+
+void TcpConnection::handleAsyncRecv(ssize_t res, Timestamp receiveTime)
+{
+    recvInFlight_ = false;
+    if(state_ == kDisconnected)
+    {
+        return;
+    }
+    if(res > 0)
+    {
+        inputBuffer_.hasWritten(res);
+        touchIdleBuffers();
+        touchIdleTimeout();
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        if(state_ != kDisconnected && !recvInFlight_)
+        {
+            startAsyncRecv();
+        }
+    }
+    else if(res == 0)
+    {
+        handleClose();
+    }
+    else if(res == -EAGAIN || res == -EINTR)
+    {
+        startAsyncRecv();
+    }
+    else if(res != -ECANCELED)
+    {
+        // 没有注册EPOLLIN，收不到EPOLLHUP/EPOLLERR，recv出错就直接关闭连接
+        errno = static_cast<int>(-res);
+        LOG_ERROR("TcpConnection::handleAsyncRecv");
+        handleError();
+        handleClose();
+    }
+}
+
+void TcpConnection::startAsyncSend()
+{
+    // outputBuffer_在send完成之前可能扩容搬家，要发的数据先搬到asyncSendBuf_里
+    asyncSendBuf_.clear();
+    asyncSendOffset_ = 0;
+    struct iovec vec[IOV_MAX];
+    int iovcnt = outputBuffer_.readableIovecs(vec, IOV_MAX);
+    for(int i = 0; i < iovcnt; ++i)
+    {
+        asyncSendBuf_.append(static_cast<const char*>(vec[i].iov_base), vec[i].iov_len);
+    }
+    outputBuffer_.retrieve(asyncSendBuf_.size());
+    while(!outputQueue_.empty() && outputQueue_.front().fd < 0)
+    {
+        const OutputChunk &chunk = outputQueue_.front();
+        asyncSendBuf_.append(chunk.peek(), chunk.remaining);
+        queuedBytes_ -= chunk.remaining;
+        outputQueue_.pop_front();
+    }
+    submitAsyncSend();
+}
+
+void TcpConnection::submitAsyncSend()
+{
+    sendInFlight_ = true;
+    loop_->submitSend(channel_.get(), asyncSendBuf_.data() + asyncSendOffset_, asyncSendBuf_.size() - asyncSendOffset_);
+}
+
+void TcpConnection::handleAsyncSend(ssize_t res)
+{
+    sendInFlight_ = false;
+    if(state_ == kDisconnected || res == -ECANCELED)
+    {
+        return;
+    }
+    if(res == -EAGAIN || res == -EINTR)
+    {
+        submitAsyncSend();
+        return;
+    }
+    if(res < 0)
+    {
+        // 对端已经关闭了，recv那边会收到错误或者0，在那里关闭连接
+        errno = static_cast<int>(-res);
+        LOG_ERROR("TcpConnection::handleAsyncSend");
+        asyncSendBuf_.clear();
+        asyncSendOffset_ = 0;
+        return;
+    }
+    touchIdleBuffers();
+    touchIdleTimeout();
+    asyncSendOffset_ += res;
+    if(asyncSendOffset_ < asyncSendBuf_.size())
+    {
+        submitAsyncSend(); // 只发出去一部分，接着发剩下的
+        return;
+    }
+    asyncSendBuf_.clear();
+    asyncSendOffset_ = 0;
+    scheduleWrite();
+    if(pendingBytes() == 0)
+    {
+        if(writeCompleteCallback_)
+        {
+            loop_->queueInLoop(
+                std::bind(writeCompleteCallback_, shared_from_this())
+            );
+        }
+        if(state_ == kDisconnecting)
+        {
+            shutdownInLoop();
+        }
+    }
+}
+
+void TcpConnection::scheduleWrite()
+{
+    if(sendInFlight_ || channel_->isWriting())
+    {
+        return; // send完成或者EPOLLOUT到来时会接着发
+    }
+    bool dataFirst = outputBuffer_.readableBytes() > 0
+                    || (!outputQueue_.empty() && outputQueue_.front().fd < 0);
+    if(asyncIo_ && dataFirst)
+    {
+        startAsyncSend();
+    }
+    else if(pendingBytes() > 0)
+    {
+        // 文件还是用sendfile发，等EPOLLOUT
+        channel_->enableWriting();
+    }
+}
+
 //底层的poller通知channel调用它的closeCallback方法，最终就回调到TcpConnection::handleClose
 void TcpConnection::handleClose()
 {
@@ -318,4 +1101,89 @@ void TcpConnection::handleError()
         err = optval;
     }
     LOG_ERROR("TcpConnection::handleError name:%s - SO_ERROR:%d \n", name_.c_str(), err);
-}
\ No newline at end of file
+}
+// 时间轮到期的时候Entry已经摘掉了，connectDestroyed之后不会再回调到这里
+void TcpConnection::handleIdleTimeout()
+{
+    LOG_INFO("TcpConnection::handleIdleTimeout name:%s idle for %.1fs \n", name_.c_str(), idleTimeoutSeconds_);
+    if(state_ == kConnected && !idleForceClose_)
+    {
+        shutdown();
+        // 对端收到FIN以后一直不关，再过一个超时周期强制关闭
+        loop_->timingWheel()->add(&idleEntry_, idleTimeoutSeconds_,
+            std::bind(&TcpConnection::forceClose, this));
+    }
+    else
+    {
+        forceClose();
+    }
+}
+
+void TcpConnection::touchIdleBuffers()
+{
+    if(bufferIdleSeconds_ <= 0)
+    {
+        return;
+    }
+    lastActive_ = ::time(NULL);
+    std::list<TcpConnection*> *conns = &t_idleBuffers.lists[bufferIdleSeconds_];
+    if(idleList_ == conns)
+    {
+        conns->splice(conns->end(), *conns, idlePos_);
+    }
+    else
+    {
+        untrackIdleBuffers(); // 回收时间改过了，从原来的链表挪过来
+        idlePos_ = conns->insert(conns->end(), this);
+        idleList_ = conns;
+    }
+    if(!t_idleBuffers.registered)
+    {
+        loop_->addHousekeeping(&TcpConnection::sweepIdleBuffers);
+        t_idleBuffers.registered = true;
+    }
+}
+
+void TcpConnection::untrackIdleBuffers()
+{
+    if(idleList_ != nullptr)
+    {
+        idleList_->erase(idlePos_);
+        idleList_ = nullptr;
+    }
+}
+
+// 每条链表都按活跃时间排好序了，碰到第一个还没超时的连接就可以换下一条
+void TcpConnection::sweepIdleBuffers()
+{
+    time_t now = ::time(NULL);
+    BufferPool *pool = nullptr;
+    for(auto &entry : t_idleBuffers.lists)
+    {
+        std::list<TcpConnection*> &conns = entry.second;
+        while(!conns.empty())
+        {
+            TcpConnection *conn = conns.front();
+            if(now - conn->lastActive_ < entry.first)
+            {
+                break;
+            }
+            conns.pop_front();
+            conn->idleList_ = nullptr;
+            if(!conn->recvInFlight_) // 异步recv正在往inputBuffer_里收
+            {
+                conn->inputBuffer_.shrink(0);
+            }
+            conn->outputBuffer_.shrink(0);
+            if(!conn->sendInFlight_)
+            {
+                std::string().swap(conn->asyncSendBuf_);
+            }
+            pool = conn->loop_->bufferPool().get();
+        }
+    }
+    if(pool != nullptr)
+    {
+        pool->trim(); // 内存块还给内存池以后，还要把整页空闲的内存还给系统
+    }
+}
@@ -5,10 +5,18 @@
 #include "Callbacks.h"
 #include "Buffer.h"
 #include "Timestamp.h"
+#include "Slice.h"
+#include "Payload.h"
+#include "TimingWheel.h"
 
 #include <memory>
 #include <string>
 #include <atomic>
+#include <list>
+#include <deque>
+#include <vector>
+#include <time.h>
+#include <sys/types.h>
 
 class Channel;
 class EventLoop;
@@ -37,6 +45,22 @@ public:
 
     bool connected() const { return kConnected == state_; }
     bool disconnected() const { return kDisconnected == state_; }
+    //最近一次处理本连接收包的CPU(SO_INCOMING_CPU)，可以用来检查连接是否落在和收包CPU相同的loop上，取不到返回-1
+    int incomingCpu() const;
+
+    //用户可以在连接回调里面调整缓冲区，比如大响应的连接开启outputBuffer()->setChained(true)
+    Buffer* inputBuffer() { return &inputBuffer_; }
+    Buffer* outputBuffer() { return &outputBuffer_; }
+    /**
+     * inputBuffer_和outputBuffer_换成镜像环形内存(见Buffer::setMirrored)，持续收发数据流的连接
+     * 不再有搬移数据的开销。在连接回调里、缓冲区还没有数据的时候调用，有数据的缓冲区保持原样并返回false
+     */
+    bool setMirroredBuffers(bool on)
+    {
+        bool input = inputBuffer_.setMirrored(on);
+        bool output = outputBuffer_.setMirrored(on);
+        return input && output;
+    }
 
     //发送数据
     void send(const void* message, int len);
@@ -64,8 +88,59 @@ public:
     }
 
     void send(const std::string& buf);
+    //跨线程调用时把buf整个移动给loop线程，不拷贝数据
+    void send(std::string&& buf);
+    //scatter-gather发送：多段数据一次writev发出去，没写完的部分才拷贝进outputBuffer_
+    //在其他线程调用时slice指向的内存不能跨线程保留，会先拼接成一份拷贝再交给loop线程
+    void send(const std::vector<Slice>& slices);
+    /**
+     * 发送共享的不可变消息，排队时只保存引用，不拷贝进outputBuffer_，适合同一条消息广播给大量连接
+     * 可以在任意线程调用，跨线程只多一次引用计数
+     */
+    void send(const PayloadPtr& payload);
+    /**
+     * 零拷贝发送文件fd的[offset, offset+len)区间，排在之前还没发完的数据后面，用sendfile(2)直接从page cache发出去
+     * 内部会dup一份fd，调用返回以后用户就可以close自己的fd。发不完的部分等EPOLLOUT在handleWrite里接着发，
+     * 高水位和发送完成回调把文件剩余的字节也算在待发送数据里
+     */
+    void sendFile(int fd, off_t offset, size_t len);
     //关闭连接
     void shutdown();
+    //不等待数据发送完，直接关闭连接
+    void forceClose();
+
+    /**
+     * 连接超过seconds秒没有读写，就把inputBuffer_和outputBuffer_的内存还给内存池，0表示不回收
+     * 大量空闲长连接的场景下，每个连接的Buffer基本不占内存。需要在loop线程里设置
+     */
+    void setBufferIdleRelease(int seconds) { bufferIdleSeconds_ = seconds; }
+    /**
+     * 连接超过seconds秒没有读写(对端没发来数据，也没有等着发送的数据写出去)就断开，0表示不检查
+     * forceClose为false时先shutdown关闭写端等对端关闭，再过seconds秒对端还没关就强制关闭
+     * 超时由loop的TimingWheel管理，每次读写只多一次赋值。在连接建立之前设置
+     */
+    void setIdleTimeout(double seconds, bool forceClose = false)
+    {
+        idleTimeoutSeconds_ = seconds;
+        idleForceClose_ = forceClose;
+    }
+    /**
+     * 一次读事件里循环读，直到读到EAGAIN、对端关闭或者本次读满budget字节，再回调一次onMessage
+     * 0表示每次读事件只读一次(默认)。大块数据的接收方开启以后少走很多次epoll_wait，
+     * budget限制一个连接一次最多占用loop多久，读不完的留给下一次EPOLLIN
+     */
+    void setReadDrainBudget(size_t budget) { readDrainBudget_ = budget; }
+    /**
+     * socket改成边沿触发(见Channel::setEdgeTriggered)，handleRead/handleWrite一直读写到EAGAIN。
+     * 一次事件最多读写readDrainBudget_(没设置就是1MB)字节，剩下的排到本轮其他连接后面接着处理，
+     * 一个很忙的连接不会把loop占住。在连接建立之前或者loop线程里设置
+     */
+    void setEdgeTriggered(bool on);
+    /**
+     * loop用的是io_uring读写模式(EventLoop::kUringReadWritePoller)时，连接建立以后recv/send都交给io_uring异步执行，
+     * 不再等事件再read/write。recv直接收进inputBuffer_的可写区间，所以在onMessage之外不要改动inputBuffer_
+     */
+    bool asyncIo() const { return asyncIo_; }
 
     //建立连接
     void connectEstablished();
@@ -81,12 +156,52 @@ private:
     void handleWrite();
     void handleClose();
     void handleError();
-
+    //边沿触发时读写预算用完了，排到pendingFunctors里接着读写
+    void resumeRead(Timestamp receiveTime);
+    void resumeWrite();
+    size_t edgeBudget() const;
+    //io_uring读写模式下异步recv/send的完成回调，res是字节数或者-errno
+    void handleAsyncRecv(ssize_t res, Timestamp receiveTime);
+    void handleAsyncSend(ssize_t res);
+    void startAsyncRecv();
+    //把outputBuffer_和排在前面的普通数据搬进asyncSendBuf_，交给io_uring发送
+    void startAsyncSend();
+    void submitAsyncSend();
+    //有数据等着发：读写模式下提交异步send，队头是文件或者普通模式就注册EPOLLOUT等handleWrite
+    void scheduleWrite();
 
     
     void sendInLoop(const void* data, size_t len);
+    void sendInLoop(const Slice* slices, size_t count);
+    //跨线程send时用，bind会保存一份message的拷贝，保证loop线程执行时数据还在
+    void sendStringInLoop(const std::string& message);
+    void sendPayloadInLoop(const PayloadPtr& payload);
+    //没发完的数据放进outputBuffer_，前面有文件或共享消息在排队的话放到outputQueue_末尾
+    void appendOutput(const char* data, size_t len);
+    //待发送数据加上incoming以后第一次越过高水位，就通知用户
+    void checkHighWaterMark(size_t incoming);
+    //outputBuffer_和排在前面的普通数据用一次writev发出去，*drained表示收集到的数据全部写完了、outputBuffer_也空了
+    ssize_t writeGather(int* saveErrno, bool* drained);
+    void sendFileInLoop(int fd, off_t offset, size_t len);
+    //发送outputQueue_里排队的内容，直到发完或者内核发送缓冲区满了(*saveErrno置为EWOULDBLOCK)，出错返回false
+    bool writeOutputQueue(int* saveErrno);
+    //outputBuffer_、outputQueue_和异步send里还没发出去的字节数
+    size_t pendingBytes() const
+    {
+        return outputBuffer_.readableBytes() + queuedBytes_ + (asyncSendBuf_.size() - asyncSendOffset_);
+    }
     
     void shutdownInLoop();
+    void forceCloseInLoop();
+    //时间轮上的空闲超时到期
+    void handleIdleTimeout();
+    void touchIdleTimeout() { idleEntry_.touch(); }
+
+    //记录一次读写活动，把连接挪到本loop空闲链表的末尾
+    void touchIdleBuffers();
+    void untrackIdleBuffers();
+    //loop的定期维护操作，从空闲链表头开始回收超时连接的Buffer内存
+    static void sweepIdleBuffers();
 
 
     EventLoop *loop_; //这里绝对不是baseloop,因为TcpConnection都是在subloop里面管理的
@@ -112,4 +227,36 @@ private:
     Buffer inputBuffer_;// 用于服务器接收数据，handleRead就是写入inputBuffer_
     Buffer outputBuffer_;// 用于服务器发送数据，应用层需要发送的数据先存到outputBuffer_
 
+    /**
+     * 排在outputBuffer_后面的待发送内容。一旦有文件在排队，后面send的数据也只能跟在文件后面，
+     * 否则顺序就乱了。fd >= 0是文件区间，fd为-1是普通数据，payload不为空时数据在共享的payload里
+     */
+    struct OutputChunk
+    {
+        int fd;             //dup出来的文件fd，发完以后close
+        off_t offset;       //文件下一次sendfile的偏移，普通数据表示data里已经发送的长度
+        size_t remaining;   //还剩多少字节没发
+        std::string data;
+        PayloadPtr payload; //共享消息，发完出队时释放引用
+
+        const char* peek() const { return (payload ? payload->data() : data.data()) + offset; }
+    };
+    std::deque<OutputChunk> outputQueue_;
+    size_t queuedBytes_; //outputQueue_里还没发送的总字节数
+
+    int bufferIdleSeconds_; //空闲多久回收Buffer内存，0表示不回收
+    size_t readDrainBudget_; //一次读事件最多读多少字节，0表示只读一次
+    time_t lastActive_; //最近一次读写的时间
+    std::list<TcpConnection*> *idleList_; //在本loop哪条空闲链表里(按回收时间分)，nullptr表示不在
+    std::list<TcpConnection*>::iterator idlePos_; //在空闲链表中的位置，挪动是O(1)的
+    double idleTimeoutSeconds_; //空闲多久断开连接，0表示不检查
+    bool idleForceClose_;
+    TimingWheel::Entry idleEntry_; //在loop时间轮上的位置
+
+    bool asyncIo_; //io_uring读写模式
+    bool recvInFlight_;
+    bool sendInFlight_;
+    std::string asyncSendBuf_; //正在异步send的数据，send完成之前内容不能动
+    size_t asyncSendOffset_; //asyncSendBuf_里已经发出去的长度
+
 };
\ No newline at end of file
@@ -1,9 +1,13 @@
 #include "TcpServer.h"
 #include "Logger.h"
 #include "TcpConnection.h"
+#include "CpuAffinity.h"
 
+#include <algorithm>
 #include <functional>
 #include <strings.h>
+#include <fcntl.h>
+#include <semaphore.h>
 
 //定义成静态的，否则会和TcpConnection.cc中名字冲突
 static EventLoop* CheckLoopNotNull(EventLoop* loop)
@@ -23,19 +27,57 @@ TcpServer::TcpServer(EventLoop* loop,
                 :loop_(CheckLoopNotNull(loop))//不接受用户给loop传空指针
                 ,ipPort_(listenAddr.toIpPort())
                 ,name_(nameArg)
-                ,acceptor_(new Acceptor(loop_,listenAddr,option = kReusePort))
+                ,listenAddr_(listenAddr)
+                ,acceptor_(new Acceptor(loop_,listenAddr,option == kReusePort))
                 ,threadPool_(new EventLoopThreadPool(loop_,name_))
                 ,connectionCallback_()
                 ,messageCallback_()
-                ,nextConnId_(1)
                 ,started_(0)
+                ,nextConnId_(1)
+                ,bufferIdleSeconds_(0)
+                ,idleTimeoutSeconds_(0)
+                ,idleForceClose_(false)
+                ,readDrainBudget_(0)
+                ,edgeTriggered_(false)
+                ,busyPollWindowUs_(0)
+                ,socketBusyPollUs_(0)
+                ,acceptMode_(kSingleAcceptor)
+                ,cpuSteering_(false)
+                ,acceptModeBeforeSteering_(kSingleAcceptor)
 {
     // 有新用户连接时，会调用Acceptor::handleRead，然后handleRead调用TcpServer::newConnection，
     // 使用两个占位符，因为TcpServer::newConnection方法需要新用户的connfd以及新用户的ip port
     acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection,this,std::placeholders::_1,std::placeholders::_2));
 }
+//subloop上的Acceptor要在它自己的loop里析构
+static void destroyAcceptor(Acceptor *acceptor, sem_t *done)
+{
+    delete acceptor;
+    sem_post(done);
+}
+
 TcpServer::~TcpServer()
 {
+    /**
+     * 每个subloop上的Acceptor要在它自己的loop线程里析构(Channel只能在loop线程里删)，而且要等它析构完：
+     * 析构函数返回以后threadPool_马上让subloop退出，只投递不等的话回调可能没执行就被丢掉，listenfd和Channel都漏了
+     */
+    for(std::unique_ptr<Acceptor> &acceptor : loopAcceptors_)
+    {
+        EventLoop *loop = acceptor->getLoop();
+        if(loop->isInLoopThread())
+        {
+            acceptor.reset();
+            continue;
+        }
+        sem_t done;
+        sem_init(&done, false, 0);
+        loop->runInLoop(std::bind(&destroyAcceptor, acceptor.release(), &done));
+        sem_wait(&done);
+        sem_destroy(&done);
+    }
+    loopAcceptors_.clear();
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
     for (auto &item : connections_)
     {
         //这个局部的shared_ptr智能指针对象，出右括号，可以自动释放new出来的TcpConnection资源
@@ -55,27 +97,133 @@ void TcpServer::setThreadNum(int numThreads)
     threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setCpuAffinity(const std::string &cpus)
+{
+    if(cpus == "auto")
+    {
+        threadPool_->setAutoCpuAffinity();
+    }
+    else
+    {
+        threadPool_->setCpuAffinity(CpuAffinity::parseCpuList(cpus));
+    }
+}
+
+void TcpServer::setCpuSteering(bool on)
+{
+    if(on && !cpuSteering_)
+    {
+        acceptModeBeforeSteering_ = acceptMode_;
+        acceptMode_ = kReusePortPerLoop;
+    }
+    else if(!on && cpuSteering_)
+    {
+        acceptMode_ = acceptModeBeforeSteering_;
+    }
+    cpuSteering_ = on;
+}
+
 //开始服务器监听
 void TcpServer::start()
 {
     if(started_++ == 0)//防止一个TcpServer对象被start多次，只有第一次调用start才进入if
     {
+        if(cpuSteering_ && !threadPool_->hasCpuAffinity())
+        {
+            threadPool_->setAutoCpuAffinity();
+        }
         threadPool_->start(threadInitCallback_);//启动底层的loop线程池
+        if(busyPollWindowUs_ > 0)
+        {
+            //subloop已经在跑了，放到它们自己的线程里去设置
+            for(EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                ioLoop->runInLoop(std::bind(&EventLoop::setBusyPoll, ioLoop, busyPollWindowUs_, socketBusyPollUs_));
+            }
+        }
+        //有subloop的时候才让subloop自己accept
+        if(acceptMode_ != kSingleAcceptor && threadPool_->getAllLoops()[0] != loop_)
+        {
+            startLoopAcceptors();
+            return;
+        }
+        acceptor_->setEdgeTriggered(edgeTriggered_);
         loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get())); //启动listen监听新用户的连接
     }
 }
 
+void TcpServer::startLoopAcceptors()
+{
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    //baseloop上的Acceptor不再用。构造时可能没设置SO_REUSEPORT，先关掉才能让subloop的socket bind上；
+    //共享模式下subloop的fd都是从它复制出来的，最后再关，不影响监听socket
+    std::unique_ptr<Acceptor> baseAcceptor(std::move(acceptor_));
+    if(acceptMode_ == kReusePortPerLoop)
+    {
+        baseAcceptor.reset();
+    }
+    for(EventLoop *ioLoop : loops)
+    {
+        Acceptor *acceptor = nullptr;
+        if(acceptMode_ == kReusePortPerLoop)
+        {
+            //每个loop一个独立的socket，都要设置SO_REUSEPORT才能bind到同一个端口上
+            //在这里按顺序listen，SO_REUSEPORT组里第i个socket就是第i个subloop的，cBPF程序返回的下标才对得上
+            acceptor = new Acceptor(ioLoop, listenAddr_, true);
+            acceptor->listenSocket();
+        }
+        else
+        {
+            //复制出来的fd指向同一个监听socket，各自加到自己loop的epoll里
+            int listenfd = ::fcntl(baseAcceptor->listenFd(), F_DUPFD_CLOEXEC, 0);
+            if(listenfd < 0)
+            {
+                LOG_FATAL("%s:%s:%d dup listenfd err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+            }
+            acceptor = new Acceptor(ioLoop, listenfd);
+            acceptor->setExclusive(true);
+        }
+        acceptor->setEdgeTriggered(edgeTriggered_);
+        acceptor->setNewConnectionCallback(
+            std::bind(&TcpServer::createConnection, this, ioLoop, std::placeholders::_1, std::placeholders::_2));
+        loopAcceptors_.push_back(std::unique_ptr<Acceptor>(acceptor));
+        ioLoop->runInLoop(std::bind(&Acceptor::listen, acceptor));
+    }
+    if(cpuSteering_ && acceptMode_ == kReusePortPerLoop)
+    {
+        const std::vector<int> &cpus = threadPool_->loopCpus();
+        if(loopAcceptors_[0]->attachCpuSteering(cpus))
+        {
+            for(size_t i = 0; i < cpus.size(); ++i)
+            {
+                //几个loop绑在同一个CPU上的时候，只有第一个会分到连接
+                if(cpus[i] >= 0 && std::find(cpus.begin(), cpus.begin() + i, cpus[i]) == cpus.begin() + i)
+                {
+                    LOG_INFO("TcpServer::start [%s] - connections received on cpu %d go to loop %zu \n", name_.c_str(), cpus[i], i);
+                }
+            }
+        }
+    }
+    LOG_INFO("TcpServer::start [%s] - %zu loops accepting on %s (%s) \n", name_.c_str(), loops.size(), ipPort_.c_str(),
+        acceptMode_ == kReusePortPerLoop ? "SO_REUSEPORT" : "EPOLLEXCLUSIVE");
+}
+
 // 根据获取到connfd来封装TcpConnection对象
 // 一条新连接到来，Acceptor根据轮询算法选择一个subloop并唤醒，把和客户端通信的connfd封装成Channel分发给subloop
 // TcpServer要把newConnection设置给Acceptor，让Acceptor对象去调用，工作在mainLoop
 // connfd是用于和客户端通信的fd，peerAddr封装了客户端的ip port
 void TcpServer::newConnection(int sockfd,const InetAddress &peerAddr)
 {
-    //轮询算法，选择一个subLoop来管理channel
-    EventLoop* ioLoop = threadPool_->getNextLoop();
+    //按设置的分配策略(默认轮询)选择一个subLoop来管理channel
+    EventLoop* ioLoop = threadPool_->getLoopForConnection(peerAddr);
+    createConnection(ioLoop, sockfd, peerAddr);
+}
+
+//kSingleAcceptor时在baseloop里调用，subloop自己accept时在ioLoop里调用
+void TcpServer::createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
     char buf[64] = {0};
-    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
+    snprintf(buf, sizeof buf, "-%s#%d", ipPort_.c_str(), nextConnId_++);
     //newConnection名称
     std::string connName = name_ + buf;
 
@@ -97,13 +245,20 @@ void TcpServer::newConnection(int sockfd,const InetAddress &peerAddr)
     // 将connnfd封装成TcpConnection，TcpConnection有一个Channel的成员变量，这里就相当于把一个TcpConnection对象放入了一个subloop
     TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
 
-    connections_[connName] = conn;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        connections_[connName] = conn;
+    }
     // 下面的回调都是用户设置给TcpServer的，然后TcpServer => TcpConnection => Channel，Channel会把自己封装的fd和events注册到Poller，发生事件时Poller调用Channel的handleEvent方法处理
     // 就比如这个messageCallback_，用户把on_message（messageCallback_）传给TcpServer，TcpServer会调用TcpConnection::setMessageCallback，那么TcpConnection的成员messageCallback_就保存了on_message
     // TcpConnection会把handleRead设置到Channel的readCallBack_，而handleRead就包括了TcpConnection::messageCallback_（on_message）
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setBufferIdleRelease(bufferIdleSeconds_);
+    conn->setIdleTimeout(idleTimeoutSeconds_, idleForceClose_);
+    conn->setReadDrainBudget(readDrainBudget_);
+    conn->setEdgeTriggered(edgeTriggered_);
 
     //设置如何关闭连接的回调
     conn->setCloseCallback(
@@ -116,6 +271,12 @@ void TcpServer::newConnection(int sockfd,const InetAddress &peerAddr)
 //连接已断开，从connectionMap里移除
 void TcpServer::removeConnection(const TcpConnectionPtr &conn)
 {
+    //subloop自己accept的连接也在自己的loop里删，不用再唤醒baseloop
+    if(!loopAcceptors_.empty())
+    {
+        removeConnectionInLoop(conn);
+        return;
+    }
     loop_->runInLoop(
         std::bind(&TcpServer::removeConnectionInLoop, this, conn)
     );
@@ -125,7 +286,10 @@ void TcpServer::removeConnection(const TcpConnectionPtr &conn)
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
 {
     LOG_INFO("TcpServer::removeConnectionInLoop [%s] - connection %s \n", name_.c_str(), conn->name().c_str());
-    connections_.erase(conn->name());
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        connections_.erase(conn->name());
+    }
     EventLoop* ioLoop = conn->getLoop();
     ioLoop->queueInLoop(
         std::bind(&TcpConnection::connectDestroyed, conn)
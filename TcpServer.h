@@ -15,6 +15,8 @@
 #include <functional>
 #include <memory>
 #include <atomic>
+#include <mutex>
+#include <vector>
 #include <unordered_map>
 
 //对外的服务器编程使用的类
@@ -30,6 +32,14 @@ public:
         kReusePort,
     };
 
+    //谁来accept新连接
+    enum AcceptMode
+    {
+        kSingleAcceptor,    //baseloop上一个Acceptor，accept以后按分配策略交给subloop(默认)
+        kReusePortPerLoop,  //每个subloop一个设置了SO_REUSEPORT的listenfd，内核按四元组哈希选socket，哪个loop accept就在哪个loop上
+        kSharedExclusive,   //所有subloop用EPOLLEXCLUSIVE监听同一个listenfd，被唤醒的loop自己accept
+    };
+
     TcpServer(EventLoop* loop,
                 const InetAddress &listenAddr,
                 const std::string& nameArg,
@@ -40,14 +50,65 @@ public:
     void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+    //连接空闲seconds秒以后回收它的Buffer内存，见TcpConnection::setBufferIdleRelease
+    void setBufferIdleRelease(int seconds) { bufferIdleSeconds_ = seconds; }
+    //连接空闲seconds秒以后断开，见TcpConnection::setIdleTimeout，start之前设置
+    void setIdleTimeout(double seconds, bool forceClose = false)
+    {
+        idleTimeoutSeconds_ = seconds;
+        idleForceClose_ = forceClose;
+    }
+    //一次读事件最多读budget字节，见TcpConnection::setReadDrainBudget
+    void setReadDrainBudget(size_t budget) { readDrainBudget_ = budget; }
+    //listenfd和所有连接都用边沿触发，见TcpConnection::setEdgeTriggered，start之前设置
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+
+    //IO loop(没有subloop时是baseloop)打开忙轮询，见EventLoop::setBusyPoll，start之前设置
+    void setBusyPoll(int windowMicroseconds, int socketBusyPollMicroseconds = 0)
+    {
+        busyPollWindowUs_ = windowMicroseconds;
+        socketBusyPollUs_ = socketBusyPollMicroseconds;
+    }
 
     //设置底层subloop的个数
     void setThreadNum(int numThreads);
+    //subloop的IO复用实现，比如EventLoop::kUringReadWritePoller，baseloop由用户自己构造时指定
+    void setPollerType(EventLoop::PollerType type) { threadPool_->setPollerType(type); }
+    /**
+     * loop线程绑核，start之前设置，start要在baseloop线程里调用
+     * "auto"按物理核、NUMA节点分散，跳过超线程和isolcpus，见CpuAffinity::autoPlacement
+     * 或者CPU列表"0-3,8"，第一个给baseloop，后面依次给subloop，见EventLoopThreadPool::setCpuAffinity
+     * start所在的线程(baseloop线程，一般是main线程)会一直绑在第一个CPU上，它之后创建的线程也一样
+     */
+    void setCpuAffinity(const std::string &cpus);
+    /**
+     * 新连接分给哪个subloop，默认轮询；内置的有LeastConnectionsPlacement、LeastBusyPlacement、ConsistentHashPlacement，见LoopPlacement.h
+     * 在baseloop线程里或者loop()开始之前调用
+     */
+    void setPlacementPolicy(std::unique_ptr<LoopPlacementPolicy> policy) { threadPool_->setPlacementPolicy(std::move(policy)); }
+
+    /**
+     * 每个subloop自己accept，新连接不用再跨线程交给subloop(少一次runInLoop唤醒)，accept也不再集中在baseloop一个线程上
+     * 这两种模式下连接落在哪个loop由内核决定，setPlacementPolicy不起作用；没有subloop时和kSingleAcceptor一样
+     * start之前设置
+     */
+    void setAcceptMode(AcceptMode mode) { acceptMode_ = mode; }
+    /**
+     * 按收包CPU分连接：accept方式设成kReusePortPerLoop，再给SO_REUSEPORT组挂一个cBPF程序，
+     * 在CPU c上收到的连接交给绑在c上的subloop，连接的收包处理(网卡队列中断/RPS)和业务处理在同一个CPU上
+     * 没有用setCpuAffinity绑核的话按"auto"绑；网卡队列的中断亲和性/RPS要和loop绑的CPU对应，
+     * 可以用TcpConnection::incomingCpu检查。start之前设置，关掉时恢复打开之前的accept方式
+     */
+    void setCpuSteering(bool on);
 
     //开始服务器监听
     void start();
 private:
+    //每个subloop建一个Acceptor并在各自的loop里listen
+    void startLoopAcceptors();
     void newConnection(int sockfd,const InetAddress &peerAddr);
+    //在ioLoop上为sockfd建TcpConnection，baseloop分配的和subloop自己accept的都走这里
+    void createConnection(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
     void removeConnection(const TcpConnectionPtr &conn);
     void removeConnectionInLoop(const TcpConnectionPtr &conn);
 
@@ -57,6 +118,7 @@ private:
     EventLoop* loop_;//baseloop 用户自己定义的loop
     const std::string ipPort_;// 保存服务器的ip port
     const std::string name_;// 保存服务器的name
+    const InetAddress listenAddr_;
     std::unique_ptr<Acceptor> acceptor_;// 运行在mainloop的Acceptor，用于监听listenfd，等待新用户连接
     std::shared_ptr<EventLoopThreadPool> threadPool_;//事件循环线程池 one loop per thread
 
@@ -67,6 +129,19 @@ private:
     ThreadInitCallback threadInitCallback_;//loop线程初始化的回调
     std::atomic_int started_;
 
-    int nextConnId_;
+    std::atomic_int nextConnId_;
+    int bufferIdleSeconds_;
+    double idleTimeoutSeconds_;
+    bool idleForceClose_;
+    size_t readDrainBudget_;
+    bool edgeTriggered_;
+    int busyPollWindowUs_;
+    int socketBusyPollUs_;
+    AcceptMode acceptMode_;
+    bool cpuSteering_;
+    AcceptMode acceptModeBeforeSteering_; //setCpuSteering(true)之前的accept方式，关掉时恢复
+    std::vector<std::unique_ptr<Acceptor>> loopAcceptors_; //每个subloop一个，kSingleAcceptor时是空的
+    //subloop自己accept的时候，多个loop线程同时增删连接
+    std::mutex connectionsMutex_;
     ConnectionMap connections_;//保存所有的连接
 };
\ No newline at end of file
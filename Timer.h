@@ -0,0 +1,49 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+
+#include <atomic>
+
+//一个定时任务：到期时间(CLOCK_MONOTONIC上的时刻)、回调、重复间隔，只在TimerQueue里使用
+class Timer : noncopyable
+{
+public:
+    Timer(TimerCallback cb, Timestamp when, double interval)
+        :callback_(std::move(cb))
+        ,expiration_(when)
+        ,interval_(interval)
+        ,repeat_(interval > 0.0)
+        ,canceled_(false)
+        ,sequence_(++s_numCreated_)
+        ,heapIndex_(-1)
+    {}
+
+    void run() const { callback_(); }
+
+    Timestamp expiration() const { return expiration_; }
+    bool repeat() const { return repeat_; }
+    int64_t sequence() const { return sequence_; }
+
+    //重复的定时器从now开始算下一次到期时间
+    void restart(Timestamp now) { expiration_ = addTime(now, interval_); }
+    //已经到期、还没执行完的时候被取消：回调不再执行，也不再重复
+    void cancel() { canceled_ = true; repeat_ = false; }
+    bool canceled() const { return canceled_; }
+
+    //在TimerQueue小根堆里的下标，不在堆里是-1
+    int heapIndex() const { return heapIndex_; }
+    void set_heapIndex(int index) { heapIndex_ = index; }
+
+private:
+    const TimerCallback callback_;
+    Timestamp expiration_;
+    const double interval_;
+    bool repeat_;
+    bool canceled_;
+    const int64_t sequence_;    //全局唯一的编号，cancel的时候用它找定时器
+    int heapIndex_;
+
+    static std::atomic<int64_t> s_numCreated_;
+};
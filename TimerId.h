@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+
+//runAt/runAfter/runEvery返回给用户的定时器标识，只用来cancel
+//只记编号不记指针，定时器已经执行完或者取消过了，再cancel也是安全的
+class TimerId
+{
+public:
+    TimerId() : sequence_(0) {}
+    explicit TimerId(int64_t sequence) : sequence_(sequence) {}
+
+    friend class TimerQueue;
+private:
+    int64_t sequence_;
+};
@@ -0,0 +1,242 @@
+#include "TimerQueue.h"
+#include "Timer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+std::atomic<int64_t> Timer::s_numCreated_(0);
+
+int createTimerfd()
+{
+    int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(timerfd < 0)
+    {
+        LOG_FATAL("timerfd_create error:%d \n", errno);
+    }
+    return timerfd;
+}
+
+//定时器内部的时间都是CLOCK_MONOTONIC上的微秒数，和timerfd用同一个时钟，系统时间被调整也不影响
+static Timestamp monotonicNow()
+{
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return Timestamp(static_cast<int64_t>(ts.tv_sec) * Timestamp::kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+}
+
+TimerQueue::TimerQueue(EventLoop *loop)
+    :loop_(loop)
+    ,timerfd_(createTimerfd())
+    ,timerfdChannel_(loop, timerfd_)
+    ,callingExpiredTimers_(false)
+{
+    timerfdChannel_.setReadCallBack(std::bind(&TimerQueue::handleRead, this));
+    timerfdChannel_.setWatchName("TimerQueue");
+    timerfdChannel_.enableReading();
+}
+
+TimerQueue::~TimerQueue()
+{
+    timerfdChannel_.disableAll();
+    timerfdChannel_.remove();
+    ::close(timerfd_);
+    for(auto &item : timers_)
+    {
+        delete item.second;
+    }
+}
+
+TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when, double interval)
+{
+    //用户给的是墙上时间，按离现在还有多久换算到单调时钟上
+    Timestamp expiration(monotonicNow().microSecondsSinceEpoch()
+                         + when.microSecondsSinceEpoch() - Timestamp::now().microSecondsSinceEpoch());
+    Timer *timer = new Timer(std::move(cb), expiration, interval);
+    loop_->runInLoop(std::bind(&TimerQueue::addTimerInLoop, this, timer));
+    return TimerId(timer->sequence());
+}
+
+void TimerQueue::cancel(TimerId timerId)
+{
+    loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId.sequence_));
+}
+
+void TimerQueue::addTimerInLoop(Timer *timer)
+{
+    timers_[timer->sequence()] = timer;
+    heapPush(timer);
+    //新定时器成了最早到期的，timerfd要提前；正在执行回调的时候，执行完统一再设
+    if(timer->heapIndex() == 0 && !callingExpiredTimers_)
+    {
+        resetTimerfd(timer->expiration());
+    }
+}
+
+void TimerQueue::cancelInLoop(int64_t sequence)
+{
+    auto it = timers_.find(sequence);
+    if(it == timers_.end()) //已经执行完或者取消过了
+    {
+        return;
+    }
+    Timer *timer = it->second;
+    timers_.erase(it);
+    if(timer->heapIndex() >= 0)
+    {
+        heapRemove(timer);
+        delete timer;
+    }
+    else //在expired_里，handleRead执行完回调以后再释放
+    {
+        timer->cancel();
+    }
+    //取消的如果是堆顶，timerfd不用改，到时候醒来一次发现没有到期的定时器，再按新的堆顶设置
+}
+
+void TimerQueue::handleRead()
+{
+    uint64_t howmany;
+    ssize_t n = ::read(timerfd_, &howmany, sizeof howmany);
+    if(n != sizeof howmany && errno != EAGAIN)
+    {
+        LOG_ERROR("TimerQueue::handleRead() reads %ld bytes instead of 8 \n", n);
+    }
+
+    Timestamp now(monotonicNow());
+    while(!heap_.empty() && heap_[0].expiration <= now.microSecondsSinceEpoch())
+    {
+        Timer *timer = heap_[0].timer;
+        heapRemove(timer);
+        expired_.push_back(timer);
+    }
+
+    callingExpiredTimers_ = true;
+    for(Timer *timer : expired_)
+    {
+        if(!timer->canceled())
+        {
+            timer->run();
+        }
+    }
+    callingExpiredTimers_ = false;
+
+    for(Timer *timer : expired_)
+    {
+        if(timer->repeat())
+        {
+            timer->restart(now);
+            heapPush(timer);
+        }
+        else
+        {
+            timers_.erase(timer->sequence());
+            delete timer;
+        }
+    }
+    expired_.clear();
+
+    if(!heap_.empty())
+    {
+        resetTimerfd(heap_[0].timer->expiration());
+    }
+}
+
+void TimerQueue::heapPush(Timer *timer)
+{
+    HeapEntry entry = { timer->expiration().microSecondsSinceEpoch(), timer };
+    heap_.push_back(entry);
+    timer->set_heapIndex(static_cast<int>(heap_.size()) - 1);
+    siftUp(timer->heapIndex());
+}
+
+//拿最后一个元素填到timer的位置，再往上或者往下调整
+void TimerQueue::heapRemove(Timer *timer)
+{
+    int index = timer->heapIndex();
+    HeapEntry last = heap_.back();
+    heap_.pop_back();
+    timer->set_heapIndex(-1);
+    if(last.timer != timer)
+    {
+        heapSet(index, last);
+        siftUp(index);
+        siftDown(last.timer->heapIndex());
+    }
+}
+
+void TimerQueue::siftUp(int index)
+{
+    HeapEntry entry = heap_[index];
+    while(index > 0)
+    {
+        int parent = (index - 1) / kHeapArity;
+        if(heap_[parent].expiration <= entry.expiration)
+        {
+            break;
+        }
+        heapSet(index, heap_[parent]);
+        index = parent;
+    }
+    heapSet(index, entry);
+}
+
+void TimerQueue::siftDown(int index)
+{
+    int size = static_cast<int>(heap_.size());
+    HeapEntry entry = heap_[index];
+    while(true)
+    {
+        int first = index * kHeapArity + 1;
+        if(first >= size)
+        {
+            break;
+        }
+        //找几个孩子里最早到期的
+        int child = first;
+        int end = std::min(first + kHeapArity, size);
+        for(int i = first + 1; i < end; ++i)
+        {
+            if(heap_[i].expiration < heap_[child].expiration)
+            {
+                child = i;
+            }
+        }
+        if(entry.expiration <= heap_[child].expiration)
+        {
+            break;
+        }
+        heapSet(index, heap_[child]);
+        index = child;
+    }
+    heapSet(index, entry);
+}
+
+void TimerQueue::heapSet(int index, const HeapEntry &entry)
+{
+    heap_[index] = entry;
+    entry.timer->set_heapIndex(index);
+}
+
+//到期时间和timerfd都是CLOCK_MONOTONIC，按相对时间设置
+void TimerQueue::resetTimerfd(Timestamp expiration)
+{
+    int64_t microseconds = expiration.microSecondsSinceEpoch() - monotonicNow().microSecondsSinceEpoch();
+    if(microseconds < 1) //已经过期的也要设一个最小值，it_value全0是关掉timerfd
+    {
+        microseconds = 1;
+    }
+    itimerspec newValue;
+    ::memset(&newValue, 0, sizeof newValue);
+    newValue.it_value.tv_sec = static_cast<time_t>(microseconds / Timestamp::kMicroSecondsPerSecond);
+    newValue.it_value.tv_nsec = static_cast<long>(microseconds % Timestamp::kMicroSecondsPerSecond * 1000);
+    if(::timerfd_settime(timerfd_, 0, &newValue, NULL) < 0)
+    {
+        LOG_ERROR("timerfd_settime error:%d \n", errno);
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+#include "TimerId.h"
+
+#include <vector>
+#include <unordered_map>
+
+class EventLoop;
+class Timer;
+
+/**
+ * 每个EventLoop一个定时器队列，用timerfd把定时器接到Poller里，和其他fd一起等
+ * 定时器按到期时间放在4叉小根堆里，添加、取消都是O(log n)，timerfd总是设成堆顶的到期时间
+ * 堆里直接存到期时间，调整堆的时候比较不用去访问Timer对象，定时器多的时候少很多cache miss
+ * addTimer/cancel可以在任何线程调用，其他线程的调用通过runInLoop转到loop线程执行
+ * 到期时间在addTimer时从墙上时间换算成CLOCK_MONOTONIC，之后系统时间往前或往后调都不影响已经加进来的定时器
+ */
+class TimerQueue : noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop *loop);
+    ~TimerQueue();
+
+    //interval大于0就是每隔interval秒重复执行
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    void cancel(TimerId timerId);
+
+    //还没到期的定时器个数，只能在loop线程调用
+    size_t size() const { return heap_.size(); }
+
+private:
+    void addTimerInLoop(Timer *timer);
+    void cancelInLoop(int64_t sequence);
+    //timerfd可读，执行所有到期的定时器
+    void handleRead();
+
+    struct HeapEntry
+    {
+        int64_t expiration; //微秒
+        Timer *timer;
+    };
+    static const int kHeapArity = 4;
+
+    void heapPush(Timer *timer);
+    void heapRemove(Timer *timer);
+    void siftUp(int index);
+    void siftDown(int index);
+    void heapSet(int index, const HeapEntry &entry);
+
+    //把timerfd设成expiration到期
+    void resetTimerfd(Timestamp expiration);
+
+    EventLoop *loop_;
+    const int timerfd_;
+    Channel timerfdChannel_;
+
+    std::vector<HeapEntry> heap_;  //按到期时间排的小根堆
+    std::unordered_map<int64_t, Timer*> timers_; //编号=>定时器，包括堆里的和正在执行回调的
+    std::vector<Timer*> expired_;   //本轮到期、正在执行回调的定时器
+    bool callingExpiredTimers_;
+};
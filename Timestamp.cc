@@ -1,6 +1,7 @@
 #include "Timestamp.h"
 
 #include<time.h>
+#include<sys/time.h>
 
 Timestamp::Timestamp():microSecondsSinceEpoch_(0){}
 
@@ -9,12 +10,17 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
     {}
 Timestamp Timestamp::now()
 {
-    return Timestamp(time(NULL));   //获取当前时间
+    //time(NULL)只精确到秒，定时器要用微秒
+    timeval tv;
+    ::gettimeofday(&tv, NULL);
+    return Timestamp(static_cast<int64_t>(tv.tv_sec) * kMicroSecondsPerSecond + tv.tv_usec);
 }
 std::string Timestamp::toString()const
 {
     char buf[128] = {0};
-    tm *tm_time = localtime(&microSecondsSinceEpoch_);
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+    tm tm_result;
+    tm *tm_time = localtime_r(&seconds, &tm_result);
     snprintf(buf,128,"%4d/%02d/%02d %02d:%02d:%02d",
     tm_time->tm_year + 1900,
     tm_time->tm_mon + 1,
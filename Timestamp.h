@@ -2,8 +2,9 @@
 
 #include<iostream>
 #include<string>
+#include<stdint.h>
 
-//时间类
+//时间类，精确到微秒
 class Timestamp
 {
 public:
@@ -11,6 +12,35 @@ public:
     explicit Timestamp(int64_t microSecondsSinceEpoch);   //带参数的构造，带参数的构造函数都加了explicit关键字：避免隐式对象转换
     static Timestamp now(); //获取当前时间
     std::string toString() const;   //获取当前时间的年月日时分秒的输出
+
+    int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+    bool valid() const { return microSecondsSinceEpoch_ > 0; }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
 private:
     int64_t microSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs)
+{
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+//两个时间相差多少秒
+inline double timeDifference(Timestamp high, Timestamp low)
+{
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+//timestamp往后加seconds秒
+inline Timestamp addTime(Timestamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
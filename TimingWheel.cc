@@ -0,0 +1,107 @@
+#include "TimingWheel.h"
+#include "EventLoop.h"
+
+void TimingWheel::Entry::unlink()
+{
+    if(wheel_ == nullptr)
+    {
+        return;
+    }
+    prev_->next_ = next_;
+    next_->prev_ = prev_;
+    prev_ = next_ = this;
+    --wheel_->size_;
+    wheel_ = nullptr;
+}
+
+TimingWheel::TimingWheel(EventLoop *loop)
+    :loop_(loop)
+    ,slots_(kNumSlots)
+    ,now_(0)
+    ,size_(0)
+    ,ticking_(false)
+{
+}
+
+TimingWheel::~TimingWheel()
+{
+    if(ticking_)
+    {
+        loop_->cancel(tickTimer_);
+    }
+    //还挂在轮子上的Entry摘下来，它们析构时就不会再访问轮子
+    for(Entry &head : slots_)
+    {
+        while(head.next_ != &head)
+        {
+            head.next_->unlink();
+        }
+    }
+}
+
+void TimingWheel::add(Entry *entry, double timeoutSeconds, ExpireCallback cb)
+{
+    entry->unlink();
+    //向上取整，再多等一个tick：当前tick已经过去了一部分，保证空闲时间至少有timeoutSeconds
+    uint64_t ticks = static_cast<uint64_t>((timeoutSeconds * 1000 + kTickMs - 1) / kTickMs);
+    entry->timeoutTicks_ = (ticks > 0 ? ticks : 1) + 1;
+    entry->lastActive_ = now_;
+    entry->callback_ = std::move(cb);
+    link(entry, now_ + entry->timeoutTicks_);
+    if(!ticking_)
+    {
+        ticking_ = true;
+        tickTimer_ = loop_->runEvery(kTickMs / 1000.0, std::bind(&TimingWheel::tick, this));
+    }
+}
+
+void TimingWheel::link(Entry *entry, uint64_t expireTick)
+{
+    Entry &head = slots_[expireTick % kNumSlots];
+    entry->wheel_ = this;
+    entry->expireTick_ = expireTick;
+    entry->prev_ = head.prev_;
+    entry->next_ = &head;
+    head.prev_->next_ = entry;
+    head.prev_ = entry;
+    ++size_;
+}
+
+void TimingWheel::tick()
+{
+    ++now_;
+    Entry &head = slots_[now_ % kNumSlots];
+    if(head.next_ == &head)
+    {
+        return;
+    }
+    //整条链表先挪到pending上，处理过程中重新挂回来的Entry不会再被这一轮看到
+    //回调里摘掉别的Entry也没关系，侵入式链表摘节点不需要知道它在哪条链表上
+    Entry pending;
+    pending.next_ = head.next_;
+    pending.prev_ = head.prev_;
+    pending.next_->prev_ = &pending;
+    pending.prev_->next_ = &pending;
+    head.next_ = head.prev_ = &head;
+
+    while(pending.next_ != &pending)
+    {
+        Entry *entry = pending.next_;
+        uint64_t deadline = entry->lastActive_ + entry->timeoutTicks_;
+        entry->unlink();
+        if(entry->expireTick_ > now_) //还要再转几圈
+        {
+            link(entry, entry->expireTick_);
+        }
+        else if(deadline > now_) //中间touch过，按最近一次活动重新算
+        {
+            link(entry, deadline);
+        }
+        else
+        {
+            ExpireCallback cb;
+            cb.swap(entry->callback_);
+            cb();
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+class EventLoop;
+
+/**
+ * 每个EventLoop一个的哈希时间轮，用来管理大量连接的空闲超时，添加、删除、刷新都是O(1)
+ * 轮子有kNumSlots个槽，每个槽是一条侵入式双向链表，每个tick(1秒)转一格，超过一圈的超时记在到期tick里，
+ * 转到这个槽时还没到期的留在原地等下一圈
+ *
+ * touch只把当前tick记到Entry里，不挪动链表节点。转到Entry所在的槽时再按最近一次touch算真正的到期时间，
+ * 没到期就挪到新的槽里，所以一条连接一个超时周期内最多挪一次，不管收发了多少消息
+ * 到期时间精度是一个tick：空闲至少timeout，最多timeout加一个tick
+ *
+ * 只能在loop线程里使用
+ */
+class TimingWheel : noncopyable
+{
+public:
+    using ExpireCallback = std::function<void()>;
+
+    static const int kNumSlots = 512;
+    static const int kTickMs = 1000;
+
+    //被管理的对象自己持有一个Entry，析构时自动从时间轮里摘掉
+    class Entry : noncopyable
+    {
+    public:
+        Entry() : wheel_(nullptr), prev_(this), next_(this), lastActive_(0), timeoutTicks_(0), expireTick_(0) {}
+        ~Entry() { unlink(); }
+
+        bool linked() const { return wheel_ != nullptr; }
+        //记录一次活动，只是一次赋值，每条消息都可以调用
+        inline void touch();
+
+    private:
+        friend class TimingWheel;
+        void unlink();
+
+        TimingWheel *wheel_;
+        Entry *prev_;
+        Entry *next_;
+        uint64_t lastActive_;   //最近一次touch时的tick
+        uint64_t timeoutTicks_;
+        uint64_t expireTick_;   //按现在所在的槽算出来的到期tick
+        ExpireCallback callback_;
+    };
+
+    explicit TimingWheel(EventLoop *loop);
+    ~TimingWheel();
+
+    //entry空闲timeoutSeconds秒以后执行cb，cb执行之前entry已经摘掉了，需要的话可以在cb里重新add
+    void add(Entry *entry, double timeoutSeconds, ExpireCallback cb);
+    void remove(Entry *entry) { entry->unlink(); }
+
+    size_t size() const { return size_; }
+    uint64_t now() const { return now_; }
+
+private:
+    //每个tick转一格，处理这一格里的Entry
+    void tick();
+    void link(Entry *entry, uint64_t expireTick);
+
+    EventLoop *loop_;
+    std::vector<Entry> slots_;  //每个槽的链表头
+    uint64_t now_;              //已经转过的tick数
+    size_t size_;
+    bool ticking_;              //第一次add的时候才开始定时转动
+    TimerId tickTimer_;
+};
+
+inline void TimingWheel::Entry::touch()
+{
+    if(wheel_ != nullptr)
+    {
+        lastActive_ = wheel_->now_;
+    }
+}
@@ -0,0 +1,633 @@
+#include "UringPoller.h"
+#include "Channel.h"
+#include "Logger.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+//和EPollPoller一样，Channel的index_表示是否已经加到Poller里
+const int kNew = -1;
+const int kAdded = 1;
+
+namespace
+{
+const unsigned kSqEntries = 1024;
+const unsigned kCqEntries = 8192;
+//Channel的事件用的是EPOLL*，和poll的POLL*数值相同，去掉EPOLLET这类epoll专用的标志
+const int kPollMask = POLLIN | POLLPRI | POLLOUT | POLLRDHUP;
+//水平触发要靠探测补上的事件：数据没读完、发送缓冲区还有空间，epoll的水平触发都会每轮上报
+const int kLevelMask = POLLIN | POLLPRI | POLLOUT;
+
+int sysUringSetup(unsigned entries, struct io_uring_params *p)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int sysUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+}
+
+UringPoller::Slot::Slot()
+    :channel(nullptr)
+    ,gen(0)
+    ,armedEvents(0)
+    ,probeArmed(false)
+    ,probeWanted(false)
+    ,activeRound(0)
+    ,revents(0)
+    ,recvGen(0)
+    ,sendGen(0)
+{}
+
+UringPoller* UringPoller::create(EventLoop* loop, bool readWrite)
+{
+    std::unique_ptr<UringPoller> poller(new UringPoller(loop, readWrite));
+    if(!poller->init())
+    {
+        return nullptr;
+    }
+    return poller.release();
+}
+
+UringPoller::UringPoller(EventLoop* loop, bool readWrite)
+    :Poller(loop)
+    ,readWrite_(readWrite)
+    ,ringFd_(-1)
+    ,sqRing_(MAP_FAILED)
+    ,sqRingSize_(0)
+    ,cqRing_(MAP_FAILED)
+    ,cqRingSize_(0)
+    ,sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED))
+    ,sqesSize_(0)
+    ,sqLocalTail_(0)
+    ,toSubmit_(0)
+    ,round_(0)
+{}
+
+bool UringPoller::init()
+{
+    struct io_uring_params params;
+    ::memset(&params, 0, sizeof params);
+    //COOP_TASKRUN：完成事件在下次进内核时处理，不用IPI打断loop线程；SINGLE_ISSUER：只有loop线程提交
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL
+                | IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+    params.cq_entries = kCqEntries;
+    ringFd_ = sysUringSetup(kSqEntries, &params);
+    if(ringFd_ < 0 && errno == EINVAL)
+    {
+        //老内核不认识后面几个标志
+        ::memset(&params, 0, sizeof params);
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = kCqEntries;
+        ringFd_ = sysUringSetup(kSqEntries, &params);
+    }
+    if(ringFd_ < 0)
+    {
+        LOG_ERROR("UringPoller io_uring_setup error:%d \n", errno);
+        return false;
+    }
+    if(!(params.features & IORING_FEAT_EXT_ARG))
+    {
+        LOG_ERROR("UringPoller needs IORING_FEAT_EXT_ARG (linux 5.11+) \n");
+        return false;
+    }
+
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if(singleMmap)
+    {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if(sqRing_ == MAP_FAILED)
+    {
+        LOG_ERROR("UringPoller mmap sq ring error:%d \n", errno);
+        return false;
+    }
+    if(singleMmap)
+    {
+        cqRing_ = sqRing_;
+    }
+    else
+    {
+        cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if(cqRing_ == MAP_FAILED)
+        {
+            LOG_ERROR("UringPoller mmap cq ring error:%d \n", errno);
+            return false;
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if(sqes == MAP_FAILED)
+    {
+        LOG_ERROR("UringPoller mmap sqes error:%d \n", errno);
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char *sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqEntries_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqLocalTail_ = *sqTail_;
+
+    char *cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    if(!probeMultishotPoll())
+    {
+        LOG_ERROR("UringPoller needs multishot IORING_OP_POLL_ADD (linux 5.13+) \n");
+        return false;
+    }
+
+    LOG_INFO("UringPoller created fd=%d sq=%u cq=%u readWrite=%d \n", ringFd_, params.sq_entries, params.cq_entries, readWrite_);
+    return true;
+}
+
+/**
+ * 在一个已经可读的pipe上提交multishot poll：支持的内核完成事件带IORING_CQE_F_MORE，
+ * 5.11/5.12不认识IORING_POLL_ADD_MULTI，返回-EINVAL或者当成一次性poll(不带F_MORE)
+ * 探测用的请求都标成kOpIgnore，取消以后晚到的完成事件在reapCompletions里直接丢掉
+ */
+bool UringPoller::probeMultishotPoll()
+{
+    int fds[2];
+    if(::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        LOG_ERROR("UringPoller probe pipe error:%d \n", errno);
+        return false;
+    }
+    char c = 0;
+    ::write(fds[1], &c, 1);
+
+    const uint64_t probeData = encode(kOpIgnore, 0, fds[0]);
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fds[0];
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = probeData;
+    enter(1, 1000);
+
+    bool multishot = false;
+    unsigned head = *cqHead_;
+    if(head != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+    {
+        const struct io_uring_cqe &cqe = cqes_[head & cqMask_];
+        multishot = cqe.res > 0 && (cqe.flags & IORING_CQE_F_MORE);
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+    }
+    if(multishot)
+    {
+        sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = probeData;
+        sqe->user_data = encode(kOpIgnore, 0, fds[0]);
+        enter(0, 0);
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return multishot;
+}
+
+UringPoller::~UringPoller()
+{
+    if(ringFd_ >= 0 && sqes_ != MAP_FAILED)
+    {
+        //内核里还有recv/send的话先取消，等它们完成以后缓冲区才能释放
+        bool inflight = false;
+        for(size_t fd = 0; fd < slots_.size(); ++fd)
+        {
+            Slot &s = slots_[fd];
+            if(s.recvGuard || s.sendGuard)
+            {
+                inflight = true;
+                if(s.channel != nullptr)
+                {
+                    removeChannel(s.channel);
+                }
+            }
+        }
+        ChannelList ignored;
+        for(int i = 0; inflight && i < 100; ++i)
+        {
+            enter(1, 10);
+            reapCompletions(&ignored);
+            inflight = false;
+            for(const Slot &s : slots_)
+            {
+                inflight = inflight || s.recvGuard || s.sendGuard;
+            }
+        }
+    }
+    if(sqes_ != MAP_FAILED)
+    {
+        ::munmap(sqes_, sqesSize_);
+    }
+    if(cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+    {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    if(sqRing_ != MAP_FAILED)
+    {
+        ::munmap(sqRing_, sqRingSize_);
+    }
+    if(ringFd_ >= 0)
+    {
+        ::close(ringFd_);
+    }
+}
+
+UringPoller::Slot& UringPoller::slot(int fd)
+{
+    if(static_cast<size_t>(fd) >= slots_.size())
+    {
+        slots_.resize(std::max(static_cast<size_t>(fd) + 1, slots_.size() * 2));
+    }
+    return slots_[fd];
+}
+
+struct io_uring_sqe* UringPoller::getSqe()
+{
+    unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    if(sqLocalTail_ - head >= sqEntries_)
+    {
+        enter(0, 0);
+        head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if(sqLocalTail_ - head >= sqEntries_)
+        {
+            LOG_FATAL("UringPoller submission queue full \n");
+        }
+    }
+    unsigned index = sqLocalTail_ & sqMask_;
+    struct io_uring_sqe *sqe = &sqes_[index];
+    ::memset(sqe, 0, sizeof *sqe);
+    sqArray_[index] = index;
+    ++sqLocalTail_;
+    ++toSubmit_;
+    return sqe;
+}
+
+int UringPoller::enter(unsigned waitNr, int timeoutMs)
+{
+    __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    ::memset(&arg, 0, sizeof arg);
+    unsigned flags = 0;
+    void *argp = nullptr;
+    size_t argSize = 0;
+    if(waitNr > 0)
+    {
+        flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        if(timeoutMs >= 0)
+        {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+        }
+        arg.sigmask_sz = _NSIG / 8;
+        argp = &arg;
+        argSize = sizeof arg;
+    }
+    int ret = sysUringEnter(ringFd_, toSubmit_, waitNr, flags, argp, argSize);
+    int saveErrno = errno;
+    // 内核消费了多少SQE以head为准，等待超时返回-ETIME时也可能已经提交了
+    toSubmit_ = sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    errno = saveErrno;
+    return ret;
+}
+
+Timestamp UringPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    if(timeoutMs != 0) //忙轮询的时候一秒钟要转几十万次，只在会阻塞的poll上打
+    {
+        LOG_INFO("func=%s fd total count:%ld\n",__FUNCTION__,channels_.size());
+    }
+    releasedGuards_.clear();
+    ++round_;
+    armProbes();
+
+    int ret = 0;
+    unsigned ready = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) - *cqHead_;
+    if(ready == 0)
+    {
+        ret = enter(1, timeoutMs);
+    }
+    else if(toSubmit_ > 0)
+    {
+        ret = enter(0, 0); // 已经有完成事件了，只提交不等待
+    }
+    int saveErrno = errno;
+    Timestamp now(Timestamp::now());
+
+    size_t first = activeChannels->size();
+    reapCompletions(activeChannels);
+    if(activeChannels->size() > first)
+    {
+        LOG_INFO("%lu events happened \n", activeChannels->size() - first);
+    }
+    if(ret < 0 && saveErrno != ETIME && saveErrno != EINTR)
+    {
+        errno = saveErrno;
+        LOG_ERROR("UringPoller::poll() err!");
+    }
+    return now;
+}
+
+void UringPoller::reapCompletions(ChannelList *activeChannels)
+{
+    size_t first = activeChannels->size();
+    std::vector<int> rearm;
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for(; head != tail; ++head)
+    {
+        const struct io_uring_cqe &cqe = cqes_[head & cqMask_];
+        const uint64_t data = cqe.user_data;
+        const int res = cqe.res;
+        const OpType type = static_cast<OpType>(data >> 60);
+        const uint32_t gen = static_cast<uint32_t>(data >> 32) & 0x0fffffff;
+        const int fd = static_cast<int>(static_cast<uint32_t>(data));
+        if(type == kOpIgnore || static_cast<size_t>(fd) >= slots_.size())
+        {
+            continue;
+        }
+        Slot &s = slots_[fd];
+        switch(type)
+        {
+        case kOpPoll:
+        {
+            int revents = res;
+            if(gen != (s.gen & 0x0fffffff))
+            {
+                break; // 已经被替换掉的请求
+            }
+            if(!(cqe.flags & IORING_CQE_F_MORE))
+            {
+                // 内核结束了这个multishot请求，Channel还要事件的话重新提交
+                s.armedEvents = 0;
+                rearm.push_back(fd);
+            }
+            // 探测还在内核里的话，可读/可写事件交给探测上报。两个请求会被同一次唤醒触发，
+            // 完成事件可能落在前后两轮里，都上报的话第二次回调会读到EAGAIN
+            if(res > 0 && s.probeArmed)
+            {
+                revents = res & ~kLevelMask;
+            }
+            if(revents > 0 && s.channel != nullptr)
+            {
+                activate(s, activeChannels);
+                s.revents |= revents;
+                // 边沿触发的Channel本来就只要唤醒时的通知，不用探测
+                if((revents & kLevelMask) && (s.armedEvents & kLevelMask) && !s.probeWanted
+                    && !s.channel->edgeTriggered())
+                {
+                    s.probeWanted = true;
+                    probeFds_.push_back(fd);
+                }
+            }
+            else if(res < 0 && res != -ECANCELED)
+            {
+                LOG_ERROR("UringPoller poll fd=%d error:%d \n", fd, -res);
+            }
+            break;
+        }
+        case kOpProbe:
+            if(gen != (s.gen & 0x0fffffff))
+            {
+                break;
+            }
+            s.probeArmed = false;
+            if(res > 0 && s.channel != nullptr)
+            {
+                activate(s, activeChannels);
+                s.revents |= res;
+                if((res & kLevelMask) && !s.probeWanted && !s.channel->edgeTriggered())
+                {
+                    s.probeWanted = true;
+                    probeFds_.push_back(fd);
+                }
+            }
+            break;
+        case kOpRecv:
+            if(s.recvGuard && gen == (s.recvGen & 0x0fffffff))
+            {
+                releasedGuards_.push_back(std::move(s.recvGuard));
+                s.recvGuard.reset();
+                if(s.channel != nullptr)
+                {
+                    activate(s, activeChannels);
+                    s.channel->set_recvResult(res);
+                }
+            }
+            break;
+        case kOpSend:
+            if(s.sendGuard && gen == (s.sendGen & 0x0fffffff))
+            {
+                releasedGuards_.push_back(std::move(s.sendGuard));
+                s.sendGuard.reset();
+                if(s.channel != nullptr)
+                {
+                    activate(s, activeChannels);
+                    s.channel->set_sendResult(res);
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+    for(size_t i = first; i < activeChannels->size(); ++i)
+    {
+        Channel *channel = (*activeChannels)[i];
+        channel->set_events(slots_[channel->fd()].revents);
+    }
+    for(int fd : rearm)
+    {
+        Slot &s = slots_[fd];
+        if(s.channel != nullptr && s.armedEvents == 0)
+        {
+            int events = s.channel->events() & kPollMask;
+            if(events != 0)
+            {
+                disarmPoll(fd, s);
+                armPoll(fd, s, events);
+            }
+        }
+    }
+}
+
+//同一轮里同一个Channel可能有好几个完成事件，只放进activeChannels一次
+void UringPoller::activate(Slot &s, ChannelList *activeChannels)
+{
+    if(s.activeRound != round_)
+    {
+        s.activeRound = round_;
+        s.revents = 0;
+        activeChannels->push_back(s.channel);
+    }
+}
+
+//上一轮收到可读/可写事件的Channel，回调已经执行完了，再探测一次是否还有数据没读完、是否还能接着写
+void UringPoller::armProbes()
+{
+    for(int fd : probeFds_)
+    {
+        Slot &s = slots_[fd];
+        s.probeWanted = false;
+        if(s.channel == nullptr || s.probeArmed || !(s.armedEvents & kLevelMask))
+        {
+            continue;
+        }
+        struct io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = s.armedEvents & kLevelMask;
+        sqe->user_data = encode(kOpProbe, s.gen, fd);
+        s.probeArmed = true;
+    }
+    probeFds_.clear();
+}
+
+void UringPoller::armPoll(int fd, Slot &s, int events)
+{
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = encode(kOpPoll, s.gen, fd);
+    s.armedEvents = events;
+}
+
+//取消这个fd上的poll请求，代数加1，之后到达的旧完成事件都会被丢掉
+void UringPoller::disarmPoll(int fd, Slot &s)
+{
+    if(s.armedEvents != 0)
+    {
+        struct io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = encode(kOpPoll, s.gen, fd);
+        sqe->user_data = encode(kOpIgnore, 0, fd);
+    }
+    if(s.probeArmed)
+    {
+        struct io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = encode(kOpProbe, s.gen, fd);
+        sqe->user_data = encode(kOpIgnore, 0, fd);
+    }
+    s.armedEvents = 0;
+    s.probeArmed = false;
+    ++s.gen;
+}
+
+void UringPoller::updateChannel(Channel* channel)
+{
+    const int fd = channel->fd();
+    LOG_INFO("func=%s => fd=%d events=%d index=%d\n",__FUNCTION__,fd,channel->events(),channel->index());
+    Slot &s = slot(fd);
+    if(channel->index() == kNew)
+    {
+        channels_.set(fd, channel);
+        channel->set_index(kAdded);
+        s.channel = channel;
+    }
+    const int events = channel->events() & kPollMask;
+    if(events == s.armedEvents)
+    {
+        return;
+    }
+    disarmPoll(fd, s);
+    if(events != 0)
+    {
+        armPoll(fd, s, events);
+    }
+}
+
+void UringPoller::removeChannel(Channel* channel)
+{
+    const int fd = channel->fd();
+    channels_.erase(fd);
+    LOG_INFO("func=%s => fd=%d\n",__FUNCTION__,fd);
+
+    Slot &s = slot(fd);
+    disarmPoll(fd, s);
+    // 还在内核里的recv/send取消掉，完成事件到了才释放TcpConnection
+    if(s.recvGuard)
+    {
+        struct io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = encode(kOpRecv, s.recvGen, fd);
+        sqe->user_data = encode(kOpIgnore, 0, fd);
+    }
+    if(s.sendGuard)
+    {
+        struct io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = encode(kOpSend, s.sendGen, fd);
+        sqe->user_data = encode(kOpIgnore, 0, fd);
+    }
+    s.channel = nullptr;
+    channel->set_index(kNew);
+}
+
+void UringPoller::submitRecv(Channel* channel, char* buf, size_t len)
+{
+    const int fd = channel->fd();
+    Slot &s = slot(fd);
+    if(channel->index() == kNew)
+    {
+        // 读写模式的连接不注册EPOLLIN，第一次提交recv时加进来，完成事件才能找到Channel
+        channels_.set(fd, channel);
+        channel->set_index(kAdded);
+        s.channel = channel;
+    }
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = static_cast<uint32_t>(len);
+    sqe->user_data = encode(kOpRecv, ++s.recvGen, fd);
+    s.recvGuard = channel->tiedObject();
+}
+
+void UringPoller::submitSend(Channel* channel, const char* buf, size_t len)
+{
+    const int fd = channel->fd();
+    Slot &s = slot(fd);
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = static_cast<uint32_t>(len);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = encode(kOpSend, ++s.sendGen, fd);
+    s.sendGuard = channel->tiedObject();
+}
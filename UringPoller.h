@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Poller.h"
+#include "Timestamp.h"
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+/**
+ * io_uring实现的Poller，直接用io_uring_setup/io_uring_enter系统调用，不依赖liburing
+ *
+ * 每个Channel挂一个multishot poll请求，感兴趣的事件不变就一直有效，不需要每次重新注册，
+ * 改事件时先POLL_REMOVE旧请求再提交新请求。multishot poll只在fd被唤醒时产生完成事件，
+ * 相当于边沿触发，为了保持和epoll一样的水平触发语义，Channel收到可读/可写事件后，
+ * 下一轮会再提交一个一次性的poll探测，数据没读完或者还能写的话探测会立刻完成，边沿触发的Channel不需要探测
+ * 所有SQE都攒到下一次poll里，和等待完成事件一起用一次io_uring_enter提交
+ *
+ * 读写模式(readWrite)下，TcpConnection的recv/send也通过ring提交(submitRecv/submitSend)，
+ * 一轮循环里所有连接的读写和等待只需要一次io_uring_enter。请求在内核里的时候，
+ * Poller持有Channel绑定对象(TcpConnection)的引用，保证缓冲区在完成之前不会被释放
+ */
+class UringPoller : public Poller
+{
+public:
+    //初始化失败(内核不支持io_uring或者被禁用)返回nullptr，调用方退回epoll
+    static UringPoller* create(EventLoop* loop, bool readWrite);
+    ~UringPoller() override;
+
+    Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+    void updateChannel(Channel* channel) override;
+    void removeChannel(Channel* channel) override;
+
+    bool asyncIoEnabled() const override { return readWrite_; }
+    void submitRecv(Channel* channel, char* buf, size_t len) override;
+    void submitSend(Channel* channel, const char* buf, size_t len) override;
+
+private:
+    //user_data的高4位表示请求类型，中间28位是fd槽位的代数，低32位是fd
+    enum OpType
+    {
+        kOpIgnore = 0,  //POLL_REMOVE/ASYNC_CANCEL自己的完成事件，直接丢掉
+        kOpPoll = 1,    //multishot poll
+        kOpProbe = 2,   //一次性poll探测，模拟水平触发
+        kOpRecv = 3,
+        kOpSend = 4,
+    };
+
+    //每个fd一个槽位，fd是小整数，直接用vector下标
+    struct Slot
+    {
+        Slot();
+
+        Channel *channel;
+        uint32_t gen;           //每次重新提交poll请求或者删除Channel时加1，旧请求的完成事件按代数过滤掉
+        int armedEvents;        //当前multishot poll请求监听的事件，0表示没有请求在内核里
+        bool probeArmed;
+        bool probeWanted;       //下一轮要提交探测
+        uint64_t activeRound;   //最近一次放进activeChannels的轮次，同一轮多个完成事件合并成一次回调
+        int revents;
+        std::shared_ptr<void> recvGuard; //recv请求在内核里时持有TcpConnection
+        std::shared_ptr<void> sendGuard;
+        uint32_t recvGen;
+        uint32_t sendGen;
+    };
+
+    UringPoller(EventLoop* loop, bool readWrite);
+    bool init();
+
+    static uint64_t encode(OpType type, uint32_t gen, int fd)
+    {
+        return (static_cast<uint64_t>(type) << 60) | (static_cast<uint64_t>(gen & 0x0fffffff) << 32) | static_cast<uint32_t>(fd);
+    }
+
+    //Channel靠multishot poll(linux 5.13+)接收事件，EXT_ARG只说明内核是5.11+，这里实际提交一个试试
+    bool probeMultishotPoll();
+    Slot& slot(int fd);
+    //取一个空闲的SQE，SQ满了就先提交一次
+    struct io_uring_sqe* getSqe();
+    //把攒下的SQE提交给内核，waitNr>0时同时等待完成事件
+    int enter(unsigned waitNr, int timeoutMs);
+    void armPoll(int fd, Slot &s, int events);
+    void disarmPoll(int fd, Slot &s);
+    void armProbes();
+    void reapCompletions(ChannelList *activeChannels);
+    void activate(Slot &s, ChannelList *activeChannels);
+
+    const bool readWrite_;
+    int ringFd_;
+
+    //SQ/CQ是和内核共享的内存，head/tail这些字段指向mmap出来的区域
+    void *sqRing_;
+    size_t sqRingSize_;
+    void *cqRing_;
+    size_t cqRingSize_;
+    struct io_uring_sqe *sqes_;
+    size_t sqesSize_;
+
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    unsigned *sqArray_;
+    unsigned sqLocalTail_;  //本地已经填好、还没提交的尾部
+    unsigned toSubmit_;
+
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned cqMask_;
+    struct io_uring_cqe *cqes_;
+
+    std::vector<Slot> slots_;
+    std::vector<int> probeFds_;     //下一轮要探测的fd
+    std::vector<std::shared_ptr<void>> releasedGuards_; //本轮完成的请求释放的引用，下一轮再析构，避免回调前Channel被释放
+    uint64_t round_;
+};
@@ -0,0 +1,142 @@
+/**
+ * accept方式对比：4个subloop，客户端线程不停地connect、发1字节、等回显、close，
+ * 分别用baseloop一个Acceptor、每个subloop一个SO_REUSEPORT的listenfd、所有subloop用EPOLLEXCLUSIVE共享一个listenfd，
+ * 统计每秒建立的连接数和连接在各个subloop上的分布
+ *
+ * 用法：./bench_accept_mode [每种方式的短连接数=20000] [客户端线程数=4] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static const uint16_t kBasePort = 9970;
+static const int kLoops = 4;
+
+static std::atomic<EventLoop*> g_loops[kLoops];
+static std::atomic<int> g_numLoops(0);
+static std::atomic<int> g_perLoop[kLoops];
+
+static void onThreadInit(EventLoop *loop)
+{
+    g_loops[g_numLoops.fetch_add(1)] = loop;
+}
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+    if (!conn->connected())
+    {
+        return;
+    }
+    for (int i = 0; i < kLoops; ++i)
+    {
+        if (g_loops[i].load() == conn->getLoop())
+        {
+            g_perLoop[i].fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static int connectServer(uint16_t port)
+{
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        fprintf(stderr, "connect failed\n");
+        _exit(1);
+    }
+    return fd;
+}
+
+static void runClient(uint16_t port, std::atomic<int> *next, int total)
+{
+    char c = 'x';
+    while (next->fetch_add(1) < total)
+    {
+        int fd = connectServer(port);
+        if (::write(fd, &c, 1) != 1 || ::read(fd, &c, 1) != 1)
+        {
+            fprintf(stderr, "echo failed\n");
+            _exit(1);
+        }
+        ::close(fd);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int total = argc > 1 ? atoi(argv[1]) : 20000;
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    const TcpServer::AcceptMode modes[] = {TcpServer::kSingleAcceptor, TcpServer::kReusePortPerLoop, TcpServer::kSharedExclusive};
+    const char *names[] = {"single acceptor", "SO_REUSEPORT/loop", "EPOLLEXCLUSIVE"};
+
+    for (int m = 0; m < 3; ++m)
+    {
+        uint16_t port = static_cast<uint16_t>(kBasePort + m);
+        g_numLoops = 0;
+        for (int i = 0; i < kLoops; ++i)
+        {
+            g_loops[i] = nullptr;
+            g_perLoop[i] = 0;
+        }
+        std::atomic_bool started(false);
+        TcpServer::AcceptMode mode = modes[m];
+        std::thread server([&started, port, mode] {
+            EventLoop loop;
+            TcpServer tcpServer(&loop, InetAddress(port), "accept");
+            tcpServer.setConnectionCallback(onConnection);
+            tcpServer.setMessageCallback(onMessage);
+            tcpServer.setThreadInitcallback(onThreadInit);
+            tcpServer.setThreadNum(kLoops);
+            tcpServer.setAcceptMode(mode);
+            tcpServer.start();
+            started = true;
+            loop.loop();
+        });
+        server.detach();
+        while (!started.load())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::atomic<int> next(0);
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> clients;
+        for (int t = 0; t < threads; ++t)
+        {
+            clients.emplace_back(runClient, port, &next, total);
+        }
+        for (std::thread &t : clients)
+        {
+            t.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        fprintf(stderr, "%-18s %8.0f conn/s  per loop:", names[m], total / seconds);
+        for (int i = 0; i < kLoops; ++i)
+        {
+            fprintf(stderr, " %d", g_perLoop[i].load());
+        }
+        fprintf(stderr, "\n");
+    }
+    _exit(0);
+}
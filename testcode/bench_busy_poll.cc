@@ -0,0 +1,188 @@
+/**
+ * 忙轮询对延迟的影响，阻塞模式和忙轮询模式各跑一遍：
+ * 1. 回显服务器，一条连接ping-pong，每次请求之间停一小段时间，统计往返延迟p50/p99和服务端loop线程每条消息用的CPU时间
+ * 2. 另一个线程每隔一小段时间往服务端loop里post一个回调，统计从post到开始执行的延迟p50/p99，以及写了几次eventfd
+ * eventfd的write在这里包了一层计数，只统计post线程里的调用
+ *
+ * 用法：./bench_busy_poll [忙轮询窗口us=1000] [请求数=20000] [请求间隔us=20] [SO_BUSY_POLL us=0] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ * 忙轮询的loop会占满一个CPU，CPU比线程少的机器上它和客户端抢CPU，结果没有意义
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static const uint16_t kBasePort = 9976;
+static const size_t kMessageSize = 64;
+
+static thread_local bool t_producer = false;
+static std::atomic<uint64_t> g_wakeups(0);
+
+extern "C" ssize_t write(int fd, const void *buf, size_t count)
+{
+    typedef ssize_t (*WriteFunc)(int, const void*, size_t);
+    static WriteFunc realWrite = reinterpret_cast<WriteFunc>(::dlsym(RTLD_NEXT, "write"));
+    if (t_producer)
+    {
+        g_wakeups.fetch_add(1, std::memory_order_relaxed);
+    }
+    return realWrite(fd, buf, count);
+}
+
+static double nowMicros()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double threadCpuSeconds(clockid_t clock)
+{
+    timespec ts;
+    ::clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static void percentiles(std::vector<double> &samples, double *p50, double *p99)
+{
+    std::sort(samples.begin(), samples.end());
+    *p50 = samples[samples.size() / 2];
+    *p99 = samples[samples.size() * 99 / 100];
+}
+
+static void benchPingPong(const char *label, uint16_t port, int window, int socketBusyPoll, int requests, int gap)
+{
+    std::atomic<EventLoop*> loopPtr(nullptr);
+    std::atomic<pthread_t> serverThread(0);
+    std::thread server([&loopPtr, &serverThread, label, port, window, socketBusyPoll] {
+        EventLoop loop;
+        TcpServer tcpServer(&loop, InetAddress(port), label);
+        tcpServer.setConnectionCallback(onConnection);
+        tcpServer.setMessageCallback(onMessage);
+        tcpServer.setBusyPoll(window, socketBusyPoll);
+        tcpServer.start();
+        serverThread = ::pthread_self();
+        loopPtr = &loop;
+        loop.loop();
+    });
+    server.detach();
+    while (loopPtr.load() == nullptr)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EventLoop *loop = loopPtr.load();
+    clockid_t serverClock;
+    ::pthread_getcpuclockid(serverThread.load(), &serverClock);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    //1. ping-pong
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        fprintf(stderr, "connect failed\n");
+        _exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    char message[kMessageSize];
+    ::memset(message, 'x', sizeof message);
+    std::vector<double> rtt;
+    rtt.reserve(requests);
+    double cpuStart = threadCpuSeconds(serverClock);
+    for (int i = 0; i < requests; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(gap));
+        double sent = nowMicros();
+        if (::send(fd, message, sizeof message, 0) != static_cast<ssize_t>(sizeof message))
+        {
+            fprintf(stderr, "send failed\n");
+            _exit(1);
+        }
+        size_t got = 0;
+        while (got < sizeof message)
+        {
+            ssize_t n = ::recv(fd, message + got, sizeof message - got, 0);
+            if (n <= 0)
+            {
+                fprintf(stderr, "recv failed\n");
+                _exit(1);
+            }
+            got += n;
+        }
+        rtt.push_back(nowMicros() - sent);
+    }
+    double cpu = threadCpuSeconds(serverClock) - cpuStart;
+    ::close(fd);
+    double p50, p99;
+    percentiles(rtt, &p50, &p99);
+    fprintf(stderr, "%-10s echo rtt    p50 %7.1fus  p99 %7.1fus  server cpu %6.2f us/message\n",
+            label, p50, p99, cpu / requests * 1e6);
+
+    //2. 跨线程post
+    std::vector<double> latency;
+    latency.reserve(requests);
+    std::atomic<int> finished(0);
+    uint64_t wakeupsBefore = g_wakeups.load();
+    std::thread producer([&] {
+        t_producer = true;
+        for (int i = 0; i < requests; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(gap));
+            double posted = nowMicros();
+            loop->queueInLoop([&latency, &finished, posted] {
+                latency.push_back(nowMicros() - posted);
+                ++finished;
+            });
+        }
+    });
+    producer.join();
+    while (finished.load() < requests)
+    {
+        std::this_thread::yield();
+    }
+    uint64_t wakeups = g_wakeups.load() - wakeupsBefore;
+    percentiles(latency, &p50, &p99);
+    fprintf(stderr, "%-10s post->run   p50 %7.1fus  p99 %7.1fus  eventfd writes %.3f/post\n",
+            label, p50, p99, static_cast<double>(wakeups) / requests);
+    //忙轮询的loop留着会一直占CPU，测下一种模式之前退出
+    loop->quit();
+}
+
+int main(int argc, char *argv[])
+{
+    int window = argc > 1 ? atoi(argv[1]) : 1000;
+    int requests = argc > 2 ? atoi(argv[2]) : 20000;
+    int gap = argc > 3 ? atoi(argv[3]) : 20;
+    int socketBusyPoll = argc > 4 ? atoi(argv[4]) : 0;
+
+    benchPingPong("blocking", kBasePort, 0, 0, requests, gap);
+    benchPingPong("busy-poll", kBasePort + 1, window, socketBusyPoll, requests, gap);
+    _exit(0);
+}
@@ -0,0 +1,129 @@
+/**
+ * 短连接建立和拆除的开销：服务端先挂着一批空闲长连接(让Poller里的fd表足够大)，
+ * 然后客户端线程不停地connect、发1字节、等回显、close，统计每秒处理多少条连接，
+ * 以及服务端loop线程每条连接花了多少CPU时间(包括accept、注册Channel、读写、删除Channel)
+ * 比较不同版本的Poller fd表实现时，用同样的参数分别跑一遍
+ *
+ * 用法：./bench_conn_churn [短连接总数=20000] [客户端线程数=4] [空闲长连接数=5000] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static const uint16_t kPort = 9984;
+
+static std::atomic<int> g_connected(0);
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        g_connected.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static int connectServer()
+{
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        fprintf(stderr, "connect failed\n");
+        _exit(1);
+    }
+    return fd;
+}
+
+static double threadCpuSeconds(clockid_t clock)
+{
+    timespec ts;
+    ::clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    int total = argc > 1 ? atoi(argv[1]) : 20000;
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    int idle = argc > 3 ? atoi(argv[3]) : 5000;
+
+    std::atomic<pthread_t> serverThread(0);
+    std::thread server([&] {
+        EventLoop loop;
+        TcpServer tcpServer(&loop, InetAddress(kPort), "Churn");
+        tcpServer.setConnectionCallback(onConnection);
+        tcpServer.setMessageCallback(onMessage);
+        tcpServer.start();
+        serverThread = ::pthread_self();
+        loop.loop();
+    });
+    server.detach();
+    while (serverThread.load() == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    clockid_t serverClock;
+    ::pthread_getcpuclockid(serverThread.load(), &serverClock);
+
+    std::vector<int> idleFds;
+    for (int i = 0; i < idle; ++i)
+    {
+        idleFds.push_back(connectServer());
+    }
+    while (g_connected.load() < idle)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::atomic<int> next(0);
+    double cpuStart = threadCpuSeconds(serverClock);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (int t = 0; t < threads; ++t)
+    {
+        clients.emplace_back([&] {
+            char c = 'x';
+            while (next.fetch_add(1) < total)
+            {
+                int fd = connectServer();
+                if (::write(fd, &c, 1) != 1 || ::read(fd, &c, 1) != 1)
+                {
+                    fprintf(stderr, "echo failed\n");
+                    _exit(1);
+                }
+                ::close(fd);
+            }
+        });
+    }
+    for (std::thread &t : clients)
+    {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cpu = threadCpuSeconds(serverClock) - cpuStart;
+    fprintf(stderr, "%d connections (%d idle kept open): %8.0f conn/s  server cpu %6.2f us/conn\n",
+            total, idle, total / seconds, cpu / total * 1e6);
+    // 空闲连接不关，测完直接退出
+    _exit(0);
+}
@@ -0,0 +1,149 @@
+/**
+ * 按收包CPU分连接：每个允许使用的CPU上一个subloop(少于2个CPU时开2个)，先按SO_REUSEPORT的四元组哈希，再打开setCpuSteering，
+ * 客户端线程依次绑到每个CPU上建短连接、发1字节等回显，服务端在消息回调里比较连接的SO_INCOMING_CPU和处理它的loop线程所在的CPU，
+ * 统计两者相同的比例和每条连接的往返耗时
+ *
+ * loopback没有开RPS时，SYN和数据在发送方所在的CPU上处理，客户端绑在哪个CPU就是在哪个CPU上收包；
+ * 模拟网卡队列按流分散到各个CPU可以打开lo的RPS(需要root)：
+ *     echo ff > /sys/class/net/lo/queues/rx-0/rps_cpus
+ *
+ * 用法：./bench_cpu_steering [每个CPU的短连接数=2000] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static const uint16_t kBasePort = 9975;
+
+static std::atomic<int> g_total(0);
+static std::atomic<int> g_local(0);
+static std::atomic<int> g_unknown(0);
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    int incoming = conn->incomingCpu();
+    g_total.fetch_add(1, std::memory_order_relaxed);
+    if (incoming < 0)
+    {
+        g_unknown.fetch_add(1, std::memory_order_relaxed);
+    }
+    else if (incoming == ::sched_getcpu())
+    {
+        g_local.fetch_add(1, std::memory_order_relaxed);
+    }
+    conn->send(buf->retrieveAllAsString());
+}
+
+static int connectServer(uint16_t port)
+{
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        fprintf(stderr, "connect failed\n");
+        _exit(1);
+    }
+    return fd;
+}
+
+static void runClient(uint16_t port, int cpu, int connections)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    ::sched_setaffinity(0, sizeof set, &set);
+    char c = 'x';
+    for (int i = 0; i < connections; ++i)
+    {
+        int fd = connectServer(port);
+        if (::write(fd, &c, 1) != 1 || ::read(fd, &c, 1) != 1)
+        {
+            fprintf(stderr, "echo failed\n");
+            _exit(1);
+        }
+        ::close(fd);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int perCpu = argc > 1 ? atoi(argv[1]) : 2000;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    ::sched_getaffinity(0, sizeof allowed, &allowed);
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    int loops = std::max(static_cast<int>(cpus.size()), 2);
+    const char *names[] = {"reuseport hash", "cpu steering"};
+
+    for (int steering = 0; steering < 2; ++steering)
+    {
+        uint16_t port = static_cast<uint16_t>(kBasePort + steering);
+        std::atomic_bool started(false);
+        std::thread server([&started, port, steering, loops] {
+            EventLoop loop;
+            TcpServer tcpServer(&loop, InetAddress(port), "steering");
+            tcpServer.setConnectionCallback(onConnection);
+            tcpServer.setMessageCallback(onMessage);
+            tcpServer.setThreadNum(loops);
+            tcpServer.setCpuAffinity("auto");
+            tcpServer.setAcceptMode(TcpServer::kReusePortPerLoop);
+            tcpServer.setCpuSteering(steering != 0);
+            tcpServer.start();
+            started = true;
+            loop.loop();
+        });
+        server.detach();
+        while (!started.load())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        g_total = 0;
+        g_local = 0;
+        g_unknown = 0;
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> clients;
+        for (int cpu : cpus)
+        {
+            clients.emplace_back(runClient, port, cpu, perCpu);
+        }
+        for (std::thread &t : clients)
+        {
+            t.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        int total = g_total.load();
+        fprintf(stderr, "%-15s %zu cpus %d loops: incoming cpu == loop cpu %5.1f%% (%d/%d, %d unknown)  %6.1f us/conn\n",
+                names[steering], cpus.size(), loops, total > 0 ? 100.0 * g_local.load() / total : 0.0,
+                g_local.load(), total, g_unknown.load(), seconds / total * 1e6 * cpus.size());
+    }
+    _exit(0);
+}
@@ -0,0 +1,227 @@
+/**
+ * 回显服务器对比epoll、io_uring poll、io_uring读写三种Poller：客户端开若干条连接，
+ * 每条连接循环发64字节等回显(ping-pong)，统计服务端线程平均每个请求用了多少次系统调用，
+ * 以及客户端看到的往返延迟p50/p99
+ * 系统调用在这里包了一层计数，只统计服务端loop线程里的调用，libmymuduo.so通过PLT调用时会走到这里
+ *
+ * 用法：./bench_echo_poller [连接数=16] [每条连接请求数=20000] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static const uint16_t kBasePort = 9990;
+static const size_t kMessageSize = 64;
+
+static thread_local bool t_serverThread = false;
+static std::atomic<uint64_t> g_syscalls(0);
+
+static void countSyscall()
+{
+    if (t_serverThread)
+    {
+        g_syscalls.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template <typename Func>
+static Func realFunc(const char *name)
+{
+    return reinterpret_cast<Func>(::dlsym(RTLD_NEXT, name));
+}
+
+extern "C" ssize_t read(int fd, void *buf, size_t count)
+{
+    static auto real = realFunc<ssize_t (*)(int, void*, size_t)>("read");
+    countSyscall();
+    return real(fd, buf, count);
+}
+
+extern "C" ssize_t write(int fd, const void *buf, size_t count)
+{
+    static auto real = realFunc<ssize_t (*)(int, const void*, size_t)>("write");
+    countSyscall();
+    return real(fd, buf, count);
+}
+
+extern "C" ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    static auto real = realFunc<ssize_t (*)(int, const struct iovec*, int)>("readv");
+    countSyscall();
+    return real(fd, iov, iovcnt);
+}
+
+extern "C" ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    static auto real = realFunc<ssize_t (*)(int, const struct iovec*, int)>("writev");
+    countSyscall();
+    return real(fd, iov, iovcnt);
+}
+
+extern "C" int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+{
+    static auto real = realFunc<int (*)(int, struct epoll_event*, int, int)>("epoll_wait");
+    countSyscall();
+    return real(epfd, events, maxevents, timeout);
+}
+
+extern "C" int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+    static auto real = realFunc<int (*)(int, int, int, struct epoll_event*)>("epoll_ctl");
+    countSyscall();
+    return real(epfd, op, fd, event);
+}
+
+//UringPoller用syscall(2)调io_uring_enter
+extern "C" long syscall(long number, ...)
+{
+    static auto real = realFunc<long (*)(long, ...)>("syscall");
+    va_list ap;
+    va_start(ap, number);
+    long a[6];
+    for (int i = 0; i < 6; ++i)
+    {
+        a[i] = va_arg(ap, long);
+    }
+    va_end(ap);
+    countSyscall();
+    return real(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+//一条连接上连续做requests次请求-回显，记录每次的往返时间(微秒)
+static void runClient(uint16_t port, int requests, std::vector<double> *rtts)
+{
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        fprintf(stderr, "connect failed\n");
+        return;
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+    char message[kMessageSize];
+    char reply[kMessageSize];
+    ::memset(message, 'x', sizeof message);
+    rtts->reserve(requests);
+    for (int i = 0; i < requests; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (::send(fd, message, sizeof message, 0) != static_cast<ssize_t>(sizeof message))
+        {
+            fprintf(stderr, "send failed\n");
+            break;
+        }
+        size_t got = 0;
+        while (got < sizeof reply)
+        {
+            ssize_t n = ::recv(fd, reply + got, sizeof reply - got, 0);
+            if (n <= 0)
+            {
+                fprintf(stderr, "recv failed\n");
+                ::close(fd);
+                return;
+            }
+            got += n;
+        }
+        rtts->push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    ::close(fd);
+}
+
+static void runBackend(const char *label, EventLoop::PollerType type, uint16_t port, int connections, int requests)
+{
+    std::atomic<EventLoop*> serverLoop(nullptr);
+    std::thread server([&serverLoop, label, type, port] {
+        t_serverThread = true;
+        EventLoop loop(type);
+        TcpServer tcpServer(&loop, InetAddress(port), label);
+        tcpServer.setConnectionCallback(onConnection);
+        tcpServer.setMessageCallback(onMessage);
+        tcpServer.start();
+        serverLoop = &loop;
+        loop.loop();
+    });
+    while (serverLoop.load() == nullptr)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    server.detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<std::vector<double>> rtts(connections);
+    uint64_t before = g_syscalls.load();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (int i = 0; i < connections; ++i)
+    {
+        clients.emplace_back(runClient, port, requests, &rtts[i]);
+    }
+    for (std::thread &t : clients)
+    {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t syscalls = g_syscalls.load() - before;
+
+    std::vector<double> all;
+    for (const std::vector<double> &v : rtts)
+    {
+        all.insert(all.end(), v.begin(), v.end());
+    }
+    std::sort(all.begin(), all.end());
+    if (all.empty())
+    {
+        fprintf(stderr, "%-10s no requests completed\n", label);
+        _exit(1);
+    }
+    double p50 = all[all.size() / 2];
+    double p99 = all[all.size() * 99 / 100];
+    fprintf(stderr, "%-10s syscalls/request %6.2f  p50 %7.1fus  p99 %7.1fus  %9.0f req/s\n",
+            label, static_cast<double>(syscalls) / all.size(), p50, p99, all.size() / seconds);
+    // 服务端loop留着不退出，测完直接_exit，不测连接拆除的过程
+}
+
+int main(int argc, char *argv[])
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 16;
+    int requests = argc > 2 ? atoi(argv[2]) : 20000;
+
+    runBackend("epoll", EventLoop::kEpollPoller, kBasePort, connections, requests);
+    runBackend("uring", EventLoop::kUringPoller, kBasePort + 1, connections, requests);
+    runBackend("uring-rw", EventLoop::kUringReadWritePoller, kBasePort + 2, connections, requests);
+    _exit(0);
+}
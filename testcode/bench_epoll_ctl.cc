@@ -0,0 +1,89 @@
+/**
+ * epoll_ctl合并效果：一个socketpair的Channel，每一轮loop里先打开EPOLLOUT再关掉(相当于一个响应
+ * 在同一轮里填满又发完outputBuffer_)，另外再模拟同一轮里多次修改感兴趣事件，
+ * 统计每一轮调用了多少次epoll_ctl，以及每一轮的耗时
+ * epoll_ctl在这里包了一层计数，libmymuduo.so通过PLT调用时会走到这里
+ *
+ * 用法：./bench_epoll_ctl [轮数=200000] [每轮修改次数=1] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Channel.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+static std::atomic<uint64_t> g_epollCtl(0);
+
+extern "C" int epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
+{
+    typedef int (*EpollCtlFunc)(int, int, int, struct epoll_event*);
+    static EpollCtlFunc realEpollCtl = reinterpret_cast<EpollCtlFunc>(::dlsym(RTLD_NEXT, "epoll_ctl"));
+    g_epollCtl.fetch_add(1, std::memory_order_relaxed);
+    return realEpollCtl(epfd, op, fd, event);
+}
+
+struct Toggler
+{
+    EventLoop *loop;
+    Channel *channel;
+    int rounds;
+    int togglesPerRound;
+    int done;
+
+    //每一轮打开再关掉写事件，然后排到下一轮继续
+    void run()
+    {
+        for (int i = 0; i < togglesPerRound; ++i)
+        {
+            channel->enableWriting();
+            channel->disableWriting();
+        }
+        if (++done < rounds)
+        {
+            loop->queueInLoop(std::bind(&Toggler::run, this));
+        }
+        else
+        {
+            loop->quit();
+        }
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 200000;
+    int toggles = argc > 2 ? atoi(argv[2]) : 1;
+
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+        perror("socketpair");
+        return 1;
+    }
+
+    EventLoop loop;
+    Channel channel(&loop, fds[0]);
+    channel.enableReading();
+
+    Toggler toggler = { &loop, &channel, rounds, toggles, 0 };
+    loop.queueInLoop(std::bind(&Toggler::run, &toggler));
+
+    uint64_t before = g_epollCtl.load();
+    auto start = std::chrono::steady_clock::now();
+    loop.loop();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%d rounds x %d enable/disable: epoll_ctl/round %6.3f  %8.2f us/round\n",
+            rounds, toggles, static_cast<double>(g_epollCtl.load() - before) / rounds, seconds / rounds * 1e6);
+
+    channel.disableAll();
+    channel.remove();
+    return 0;
+}
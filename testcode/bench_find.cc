@@ -0,0 +1,181 @@
+/**
+ * Buffer分隔符查找测试：用HTTP请求头、Redis命令、日志行三种负载，
+ * 分别用应用里常见的std::search写法和Buffer::findCRLF/findEOL的各套实现把所有行切一遍，
+ * 输出每种实现的吞吐量(GB/s)，同时检查各套实现找到的行数和std::search一致
+ *
+ * 用法：./bench_find [每种负载的字节数=8388608] [重复次数=20]
+ */
+#include <mymuduo/Buffer.h>
+#include <mymuduo/ByteSearch.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char kCRLF[] = "\r\n";
+
+static std::string makeHttp(size_t bytes)
+{
+    const char *request =
+        "GET /api/v1/items?id=12345&fields=name,price HTTP/1.1\r\n"
+        "Host: shop.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark; cart=3\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+    std::string s;
+    while (s.size() < bytes)
+    {
+        s += request;
+    }
+    return s;
+}
+
+static std::string makeRedis(size_t bytes)
+{
+    std::string s;
+    char line[128];
+    for (int i = 0; s.size() < bytes; ++i)
+    {
+        snprintf(line, sizeof line, "*3\r\n$3\r\nSET\r\n$10\r\nkey:%06d\r\n$8\r\nval%05d\r\n", i % 1000000, i % 100000);
+        s += line;
+    }
+    return s;
+}
+
+static std::string makeLog(size_t bytes)
+{
+    std::string s;
+    std::string payload(300, 'x');
+    char line[512];
+    for (int i = 0; s.size() < bytes; ++i)
+    {
+        snprintf(line, sizeof line, "2024-05-01 12:00:%02d.%06d INFO  [worker-%d] request done id=%d cost=%dus %s\r\n",
+                 i % 60, i % 1000000, i % 8, i, i % 977, payload.c_str() + (i % 200));
+        s += line;
+    }
+    return s;
+}
+
+//应用层原来的写法：std::search逐字节找"\r\n"
+static size_t countSearch(const Buffer &buf)
+{
+    size_t lines = 0;
+    const char *begin = buf.peek();
+    const char *end = begin + buf.readableBytes();
+    const char *p = begin;
+    while (true)
+    {
+        const char *crlf = std::search(p, end, kCRLF, kCRLF + 2);
+        if (crlf == end)
+        {
+            break;
+        }
+        ++lines;
+        p = crlf + 2;
+    }
+    return lines;
+}
+
+static size_t countCRLF(const Buffer &buf)
+{
+    size_t lines = 0;
+    size_t offset = 0;
+    const char *crlf = nullptr;
+    while ((crlf = buf.findCRLF(offset)) != nullptr)
+    {
+        ++lines;
+        offset = crlf + 2 - buf.peek();
+    }
+    return lines;
+}
+
+static size_t countEOL(const Buffer &buf)
+{
+    size_t lines = 0;
+    size_t offset = 0;
+    const char *eol = nullptr;
+    while ((eol = buf.findEOL(offset)) != nullptr)
+    {
+        ++lines;
+        offset = eol + 1 - buf.peek();
+    }
+    return lines;
+}
+
+static size_t countMemchr(const Buffer &buf)
+{
+    size_t lines = 0;
+    const char *p = buf.peek();
+    const char *end = p + buf.readableBytes();
+    const char *eol = nullptr;
+    while ((eol = static_cast<const char*>(::memchr(p, '\n', end - p))) != nullptr)
+    {
+        ++lines;
+        p = eol + 1;
+    }
+    return lines;
+}
+
+static void measure(const char *label, size_t (*count)(const Buffer&), const Buffer &buf, int rounds, size_t expect)
+{
+    size_t lines = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i)
+    {
+        lines = count(buf);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double gbps = static_cast<double>(buf.readableBytes()) * rounds / seconds / 1e9;
+    printf("  %-22s %8.2f GB/s  lines %zu%s\n", label, gbps, lines, lines == expect ? "" : "  MISMATCH");
+}
+
+static void runPayload(const char *name, const std::string &data, int rounds)
+{
+    Buffer buf;
+    buf.append(data.data(), data.size());
+    size_t expect = countSearch(buf);
+    printf("%s: %zu bytes, %zu lines, avg line %zu bytes\n", name, data.size(), expect, data.size() / std::max<size_t>(expect, 1));
+
+    measure("std::search CRLF", countSearch, buf, rounds, expect);
+    const ByteSearch::Isa isas[] = { ByteSearch::kScalar, ByteSearch::kSSE2, ByteSearch::kAVX2 };
+    for (ByteSearch::Isa isa : isas)
+    {
+        if (!ByteSearch::setIsa(isa))
+        {
+            continue;
+        }
+        std::string label = std::string("findCRLF ") + ByteSearch::isaName(isa);
+        measure(label.c_str(), countCRLF, buf, rounds, expect);
+    }
+    measure("memchr EOL", countMemchr, buf, rounds, expect);
+    for (ByteSearch::Isa isa : isas)
+    {
+        if (!ByteSearch::setIsa(isa))
+        {
+            continue;
+        }
+        std::string label = std::string("findEOL ") + ByteSearch::isaName(isa);
+        measure(label.c_str(), countEOL, buf, rounds, expect);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t bytes = argc > 1 ? atol(argv[1]) : 8 * 1024 * 1024;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+
+    ByteSearch::Isa best = ByteSearch::activeIsa();
+    printf("runtime selected: %s\n", ByteSearch::isaName(best));
+    runPayload("http headers", makeHttp(bytes), rounds);
+    runPayload("redis commands", makeRedis(bytes), rounds);
+    runPayload("log lines", makeLog(bytes), rounds);
+    ByteSearch::setIsa(best);
+    return 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * 空闲连接内存测试：建立N条连接，每条收发一次数据让Buffer分配内存，
+ * 然后什么都不做，等空闲回收以后再看一次RSS，输出每条空闲连接占用的常驻内存
+ *
+ * 用法：./bench_idle_memory [连接数=10000] [空闲回收秒数=2，0表示不回收] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Logger.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static const uint16_t kPort = 9981;
+
+static long residentBytes()
+{
+    long pages = 0, rss = 0;
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (fp)
+    {
+        if (fscanf(fp, "%ld %ld", &pages, &rss) != 2)
+        {
+            rss = 0;
+        }
+        fclose(fp);
+    }
+    return rss * sysconf(_SC_PAGESIZE);
+}
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static void runClients(EventLoop *loop, int numConns, int idleSeconds)
+{
+    std::vector<int> fds;
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    long before = residentBytes();
+    for (int i = 0; i < numConns; ++i)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+        {
+            fprintf(stderr, "connect failed at %d\n", i);
+            break;
+        }
+        fds.push_back(fd);
+    }
+    // 每条连接收发一次，服务端的inputBuffer_和outputBuffer_都会分配内存
+    char buf[16];
+    for (int fd : fds)
+    {
+        ::write(fd, "ping", 4);
+    }
+    for (int fd : fds)
+    {
+        ::read(fd, buf, sizeof buf);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    long active = residentBytes();
+
+    std::this_thread::sleep_for(std::chrono::seconds(idleSeconds + 2));
+    long idle = residentBytes();
+
+    size_t n = fds.empty() ? 1 : fds.size();
+    fprintf(stderr, "connections: %zu  idle release: %ds\n", fds.size(), idleSeconds);
+    fprintf(stderr, "resident bytes per connection after first message: %ld\n", (active - before) / (long)n);
+    fprintf(stderr, "resident bytes per connection after idle period:   %ld\n", (idle - before) / (long)n);
+
+    // 客户端fd不关，直接退出进程，避免测的是连接拆除的过程
+    loop->quit();
+}
+
+int main(int argc, char *argv[])
+{
+    int numConns = argc > 1 ? atoi(argv[1]) : 10000;
+    int idleSeconds = argc > 2 ? atoi(argv[2]) : 2;
+
+    rlimit rl;
+    ::getrlimit(RLIMIT_NOFILE, &rl);
+    rl.rlim_cur = rl.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &rl);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "IdleMemory");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.setBufferIdleRelease(idleSeconds);
+    server.setThreadNum(2);
+    server.start();
+
+    std::thread client(runClients, &loop, numConns, idleSeconds);
+    loop.loop();
+    client.join();
+    return 0;
+}
@@ -0,0 +1,191 @@
+/**
+ * 空闲超时的开销：
+ * 1. 100万个Entry挂在时间轮上，随机touch，统计每次touch的耗时；对比每条消息把TimerQueue里的超时定时器
+ *    cancel再runAfter重新挂一次(堆定时器的做法)
+ * 2. 回显服务器开/关空闲超时各跑一遍，客户端若干条连接ping-pong，统计服务端loop线程每条消息用的CPU时间
+ *
+ * 用法：./bench_idle_timeout [Entry个数=1000000] [连接数=16] [每条连接请求数=20000] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/TimingWheel.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static const uint16_t kBasePort = 9986;
+static const size_t kMessageSize = 64;
+
+static double nowSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double threadCpuSeconds(clockid_t clock)
+{
+    timespec ts;
+    ::clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void noop()
+{
+}
+
+static void benchTouch(int count)
+{
+    EventLoop loop;
+    TimingWheel *wheel = loop.timingWheel();
+    std::vector<TimingWheel::Entry> entries(count);
+    for (TimingWheel::Entry &entry : entries)
+    {
+        wheel->add(&entry, 60.0, noop);
+    }
+    std::vector<int> order(count);
+    srand(1);
+    for (int &index : order)
+    {
+        index = rand() % count;
+    }
+
+    const int kRounds = 10;
+    double start = nowSeconds();
+    for (int round = 0; round < kRounds; ++round)
+    {
+        for (int index : order)
+        {
+            entries[index].touch();
+        }
+    }
+    double touchNs = (nowSeconds() - start) / (static_cast<double>(count) * kRounds) * 1e9;
+
+    //堆定时器：每条消息取消旧的超时定时器，再挂一个新的
+    std::vector<TimerId> timers(count);
+    for (TimerId &id : timers)
+    {
+        id = loop.runAfter(60.0, noop);
+    }
+    start = nowSeconds();
+    for (int index : order)
+    {
+        loop.cancel(timers[index]);
+        timers[index] = loop.runAfter(60.0, noop);
+    }
+    double heapNs = (nowSeconds() - start) / count * 1e9;
+
+    fprintf(stderr, "%d entries: wheel touch %6.1f ns/message  heap cancel+runAfter %7.1f ns/message\n",
+            count, touchNs, heapNs);
+    for (TimerId &id : timers)
+    {
+        loop.cancel(id);
+    }
+}
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static void runClient(uint16_t port, int requests)
+{
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        fprintf(stderr, "connect failed\n");
+        _exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    char message[kMessageSize];
+    ::memset(message, 'x', sizeof message);
+    for (int i = 0; i < requests; ++i)
+    {
+        size_t got = 0;
+        if (::send(fd, message, sizeof message, 0) != static_cast<ssize_t>(sizeof message))
+        {
+            fprintf(stderr, "send failed\n");
+            _exit(1);
+        }
+        while (got < sizeof message)
+        {
+            ssize_t n = ::recv(fd, message + got, sizeof message - got, 0);
+            if (n <= 0)
+            {
+                fprintf(stderr, "recv failed\n");
+                _exit(1);
+            }
+            got += n;
+        }
+    }
+    ::close(fd);
+}
+
+static void benchEcho(const char *label, double idleTimeout, uint16_t port, int connections, int requests)
+{
+    std::atomic<pthread_t> serverThread(0);
+    std::thread server([&serverThread, label, idleTimeout, port] {
+        EventLoop loop;
+        TcpServer tcpServer(&loop, InetAddress(port), label);
+        tcpServer.setConnectionCallback(onConnection);
+        tcpServer.setMessageCallback(onMessage);
+        tcpServer.setIdleTimeout(idleTimeout);
+        tcpServer.start();
+        serverThread = ::pthread_self();
+        loop.loop();
+    });
+    server.detach();
+    while (serverThread.load() == 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    clockid_t serverClock;
+    ::pthread_getcpuclockid(serverThread.load(), &serverClock);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    double cpuStart = threadCpuSeconds(serverClock);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < connections; ++i)
+    {
+        clients.emplace_back(runClient, port, requests);
+    }
+    for (std::thread &t : clients)
+    {
+        t.join();
+    }
+    double cpu = threadCpuSeconds(serverClock) - cpuStart;
+    fprintf(stderr, "%-16s server cpu %6.2f us/message\n", label, cpu / (static_cast<double>(connections) * requests) * 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 1000000;
+    int connections = argc > 2 ? atoi(argv[2]) : 16;
+    int requests = argc > 3 ? atoi(argv[3]) : 20000;
+
+    benchTouch(count);
+    benchEcho("no idle timeout", 0, kBasePort, connections, requests);
+    benchEcho("idle timeout 60s", 60, kBasePort + 1, connections, requests);
+    // 服务端loop留着不退出，测完直接_exit
+    _exit(0);
+}
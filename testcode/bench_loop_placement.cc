@@ -0,0 +1,207 @@
+/**
+ * 新连接分配策略：4个subloop，先连上2条重连接(每个请求服务端烧heavyUs微秒CPU)，跑一会儿让loop的负载统计稳定下来，
+ * 再每隔30ms连一条轻连接(64字节ping-pong)，轻连接一边连一边开始发，统计所有轻连接请求的往返延迟p50/p99
+ * 每个客户端连接绑不同的127.0.0.x源地址，一致性哈希按IP分布
+ *
+ * 用法：./bench_loop_placement [轻连接数=8] [每条轻连接请求数=2000] [heavyUs=2000] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/LoopPlacement.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static const uint16_t kBasePort = 9960;
+static const size_t kMessageSize = 64;
+static const int kLoops = 4;
+static const int kHeavy = 2;
+static int g_heavyUs = 2000;
+
+static int64_t nowNs()
+{
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+}
+
+//'H'开头的请求在loop线程里烧CPU
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    std::string message = buf->retrieveAllAsString();
+    if (message[0] == 'H')
+    {
+        int64_t end = nowNs() + g_heavyUs * 1000LL;
+        while (nowNs() < end)
+        {
+        }
+    }
+    conn->send(message);
+}
+
+static int connectServer(uint16_t port, int client)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in local;
+    ::memset(&local, 0, sizeof local);
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(0x7f000001 + client);
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (fd < 0 || ::bind(fd, (sockaddr*)&local, sizeof local) < 0
+        || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        fprintf(stderr, "connect failed\n");
+        _exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return fd;
+}
+
+static void request(int fd, char *message, size_t len)
+{
+    if (::send(fd, message, len, 0) != static_cast<ssize_t>(len))
+    {
+        fprintf(stderr, "send failed\n");
+        _exit(1);
+    }
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = ::recv(fd, message + got, len - got, 0);
+        if (n <= 0)
+        {
+            fprintf(stderr, "recv failed\n");
+            _exit(1);
+        }
+        got += n;
+    }
+}
+
+static void runHeavy(uint16_t port, int client, const std::atomic_bool *stop)
+{
+    int fd = connectServer(port, client);
+    char message[kMessageSize];
+    ::memset(message, 'H', sizeof message);
+    while (!stop->load())
+    {
+        request(fd, message, sizeof message);
+    }
+    ::close(fd);
+}
+
+static void runLight(uint16_t port, int client, int requests, std::vector<int64_t> *rtts)
+{
+    int fd = connectServer(port, client);
+    char message[kMessageSize];
+    rtts->reserve(requests);
+    for (int i = 0; i < requests; ++i)
+    {
+        ::memset(message, 'x', sizeof message);
+        int64_t start = nowNs();
+        request(fd, message, sizeof message);
+        rtts->push_back(nowNs() - start);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    ::close(fd);
+}
+
+static std::unique_ptr<LoopPlacementPolicy> makePolicy(int index)
+{
+    switch (index)
+    {
+    case 0: return std::unique_ptr<LoopPlacementPolicy>(new RoundRobinPlacement);
+    case 1: return std::unique_ptr<LoopPlacementPolicy>(new LeastConnectionsPlacement);
+    case 2: return std::unique_ptr<LoopPlacementPolicy>(new LeastBusyPlacement);
+    default: return std::unique_ptr<LoopPlacementPolicy>(new ConsistentHashPlacement);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int lights = argc > 1 ? atoi(argv[1]) : 8;
+    int requests = argc > 2 ? atoi(argv[2]) : 2000;
+    g_heavyUs = argc > 3 ? atoi(argv[3]) : 2000;
+    const char *names[] = {"round-robin", "least-connections", "least-busy", "consistent-hash"};
+
+    for (int p = 0; p < 4; ++p)
+    {
+        uint16_t port = static_cast<uint16_t>(kBasePort + p);
+        std::atomic<EventLoop*> loopPtr(nullptr);
+        std::thread server([&loopPtr, port, p] {
+            EventLoop loop;
+            TcpServer tcpServer(&loop, InetAddress(port), "placement");
+            tcpServer.setConnectionCallback(onConnection);
+            tcpServer.setMessageCallback(onMessage);
+            tcpServer.setThreadNum(kLoops);
+            tcpServer.setPlacementPolicy(makePolicy(p));
+            tcpServer.start();
+            loopPtr = &loop;
+            loop.loop();
+        });
+        server.detach();
+        while (loopPtr.load() == nullptr)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        std::atomic_bool stop(false);
+        std::vector<std::thread> heavy;
+        for (int i = 0; i < kHeavy; ++i)
+        {
+            heavy.emplace_back(runHeavy, port, i, &stop);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+        std::vector<std::vector<int64_t>> rtts(lights);
+        std::vector<std::thread> clients;
+        for (int i = 0; i < lights; ++i)
+        {
+            clients.emplace_back(runLight, port, kHeavy + i, requests, &rtts[i]);
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        }
+        for (std::thread &t : clients)
+        {
+            t.join();
+        }
+        stop = true;
+        for (std::thread &t : heavy)
+        {
+            t.join();
+        }
+
+        std::vector<int64_t> all;
+        for (const std::vector<int64_t> &r : rtts)
+        {
+            all.insert(all.end(), r.begin(), r.end());
+        }
+        std::sort(all.begin(), all.end());
+        fprintf(stderr, "%-18s light rtt p50 %7.1f us  p99 %8.1f us\n", names[p],
+                all[all.size() / 2] / 1e3, all[all.size() * 99 / 100] / 1e3);
+    }
+    _exit(0);
+}
@@ -0,0 +1,162 @@
+/**
+ * EventLoop每轮耗时统计的开销：回显服务器上若干条连接ping-pong，统计关/开交替跑几轮，
+ * 取每种情况服务端loop线程每条消息CPU时间的最小值比较，最后打印一份统计结果
+ * 编译成-DMUDUO_LOOP_PROFILING=OFF的库再跑一遍，可以和完全没有统计代码的情况比较
+ *
+ * 用法：./bench_loop_profile [连接数=16] [每条连接请求数=5000] [轮数=3] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static const uint16_t kPort = 9966;
+static const size_t kMessageSize = 64;
+
+static double threadCpuSeconds(clockid_t clock)
+{
+    timespec ts;
+    ::clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    conn->send(buf->retrieveAllAsString());
+}
+
+static void runClient(int requests)
+{
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        fprintf(stderr, "connect failed\n");
+        _exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    char message[kMessageSize];
+    ::memset(message, 'x', sizeof message);
+    for (int i = 0; i < requests; ++i)
+    {
+        size_t got = 0;
+        if (::send(fd, message, sizeof message, 0) != static_cast<ssize_t>(sizeof message))
+        {
+            fprintf(stderr, "send failed\n");
+            _exit(1);
+        }
+        while (got < sizeof message)
+        {
+            ssize_t n = ::recv(fd, message + got, sizeof message - got, 0);
+            if (n <= 0)
+            {
+                fprintf(stderr, "recv failed\n");
+                _exit(1);
+            }
+            got += n;
+        }
+    }
+    ::close(fd);
+}
+
+static double runRound(clockid_t serverClock, int connections, int requests)
+{
+    double cpuStart = threadCpuSeconds(serverClock);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < connections; ++i)
+    {
+        clients.emplace_back(runClient, requests);
+    }
+    for (std::thread &t : clients)
+    {
+        t.join();
+    }
+    return (threadCpuSeconds(serverClock) - cpuStart) / (static_cast<double>(connections) * requests) * 1e6;
+}
+
+static void printHistogram(const char *name, const LoopProfiler::Histogram &h, const char *unit)
+{
+    fprintf(stderr, "  %-24s p50 <=%6llu%s  p99 <=%6llu%s  max bucket <=%6llu%s\n", name,
+            static_cast<unsigned long long>(h.percentile(0.5)), unit,
+            static_cast<unsigned long long>(h.percentile(0.99)), unit,
+            static_cast<unsigned long long>(h.percentile(1.0)), unit);
+}
+
+int main(int argc, char *argv[])
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 16;
+    int requests = argc > 2 ? atoi(argv[2]) : 5000;
+    int rounds = argc > 3 ? atoi(argv[3]) : 3;
+
+    std::atomic<EventLoop*> loopPtr(nullptr);
+    std::atomic<pthread_t> serverThread(0);
+    std::thread server([&loopPtr, &serverThread] {
+        EventLoop loop;
+        TcpServer tcpServer(&loop, InetAddress(kPort), "profile");
+        tcpServer.setConnectionCallback(onConnection);
+        tcpServer.setMessageCallback(onMessage);
+        tcpServer.start();
+        serverThread = ::pthread_self();
+        loopPtr = &loop;
+        loop.loop();
+    });
+    server.detach();
+    while (loopPtr.load() == nullptr)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EventLoop *loop = loopPtr.load();
+    clockid_t serverClock;
+    ::pthread_getcpuclockid(serverThread.load(), &serverClock);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    double off = 1e9;
+    double on = 1e9;
+    for (int round = 0; round < rounds; ++round)
+    {
+        loop->setProfiling(false);
+        off = std::min(off, runRound(serverClock, connections, requests));
+        loop->setProfiling(true);
+        on = std::min(on, runRound(serverClock, connections, requests));
+    }
+    fprintf(stderr, "server cpu profiling off %6.2f us/message  on %6.2f us/message  overhead %+.2f%%\n",
+            off, on, (on - off) / off * 100);
+
+    LoopProfiler::Stats s = loop->profileStats();
+    double total = static_cast<double>(s.pollNs + s.dispatchNs + s.functorNs);
+    fprintf(stderr, "%llu iterations: poll %.1f%%  dispatch %.1f%%  functors %.1f%%\n",
+            static_cast<unsigned long long>(s.iterations),
+            s.pollNs / total * 100, s.dispatchNs / total * 100, s.functorNs / total * 100);
+    fprintf(stderr, "  active channels %.2f/iteration (max %llu)  functors %.2f/iteration (max %llu)\n",
+            static_cast<double>(s.activeChannels) / s.iterations, static_cast<unsigned long long>(s.maxActiveChannels),
+            static_cast<double>(s.functors) / s.iterations, static_cast<unsigned long long>(s.maxFunctors));
+    printHistogram("poll", s.pollUs, "us");
+    printHistogram("dispatch", s.dispatchUs, "us");
+    printHistogram("functors", s.functorUs, "us");
+    printHistogram("active channels", s.activeChannelsPerIteration, "");
+    printHistogram("functors per iteration", s.functorsPerIteration, "");
+    _exit(0);
+}
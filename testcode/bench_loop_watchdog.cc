@@ -0,0 +1,196 @@
+/**
+ * loop卡死检测：
+ * 1. 开销：回显服务器上若干条连接ping-pong，没被看守/被看守交替跑几轮，取服务端loop线程每条消息CPU时间的最小值比较
+ * 2. 检测：一条连接发几次"stall"，服务端onMessage里睡stallMs毫秒，看门狗阈值100ms，
+ *    卡住时把loop、连接名字、回调报告到日志(stdout)，调用栈打到stderr，最后打印卡住次数和时长分布
+ *
+ * 用法：./bench_loop_watchdog [连接数=16] [每条连接请求数=5000] [轮数=3] [stallMs=300] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/LoopWatchdog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+static const uint16_t kPort = 9956;
+static const size_t kMessageSize = 64;
+static int g_stallMs = 300;
+
+static double threadCpuSeconds(clockid_t clock)
+{
+    timespec ts;
+    ::clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+}
+
+//一个慢得离谱的业务回调
+static void slowHandler()
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(g_stallMs));
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    std::string message = buf->retrieveAllAsString();
+    if (message.compare(0, 5, "stall") == 0)
+    {
+        slowHandler();
+    }
+    conn->send(message);
+}
+
+static int connectServer()
+{
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        fprintf(stderr, "connect failed\n");
+        _exit(1);
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return fd;
+}
+
+static void request(int fd, char *message, size_t len)
+{
+    if (::send(fd, message, len, 0) != static_cast<ssize_t>(len))
+    {
+        fprintf(stderr, "send failed\n");
+        _exit(1);
+    }
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = ::recv(fd, message + got, len - got, 0);
+        if (n <= 0)
+        {
+            fprintf(stderr, "recv failed\n");
+            _exit(1);
+        }
+        got += n;
+    }
+}
+
+static void runClient(int requests)
+{
+    int fd = connectServer();
+    char message[kMessageSize];
+    ::memset(message, 'x', sizeof message);
+    for (int i = 0; i < requests; ++i)
+    {
+        request(fd, message, sizeof message);
+    }
+    ::close(fd);
+}
+
+static double runRound(clockid_t serverClock, int connections, int requests)
+{
+    double cpuStart = threadCpuSeconds(serverClock);
+    std::vector<std::thread> clients;
+    for (int i = 0; i < connections; ++i)
+    {
+        clients.emplace_back(runClient, requests);
+    }
+    for (std::thread &t : clients)
+    {
+        t.join();
+    }
+    return (threadCpuSeconds(serverClock) - cpuStart) / (static_cast<double>(connections) * requests) * 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    int connections = argc > 1 ? atoi(argv[1]) : 16;
+    int requests = argc > 2 ? atoi(argv[2]) : 5000;
+    int rounds = argc > 3 ? atoi(argv[3]) : 3;
+    g_stallMs = argc > 4 ? atoi(argv[4]) : 300;
+
+    std::atomic<EventLoop*> loopPtr(nullptr);
+    std::atomic<pthread_t> serverThread(0);
+    std::thread server([&loopPtr, &serverThread] {
+        EventLoop loop;
+        TcpServer tcpServer(&loop, InetAddress(kPort), "watchdog");
+        tcpServer.setConnectionCallback(onConnection);
+        tcpServer.setMessageCallback(onMessage);
+        tcpServer.start();
+        serverThread = ::pthread_self();
+        loopPtr = &loop;
+        loop.loop();
+    });
+    server.detach();
+    while (loopPtr.load() == nullptr)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EventLoop *loop = loopPtr.load();
+    clockid_t serverClock;
+    ::pthread_getcpuclockid(serverThread.load(), &serverClock);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    //1. 开销，看门狗析构以后loop就不再被看守
+    double unwatched = 1e9;
+    double watched = 1e9;
+    for (int round = 0; round < rounds; ++round)
+    {
+        unwatched = std::min(unwatched, runRound(serverClock, connections, requests));
+        LoopWatchdog watchdog(0.1);
+        watchdog.watch(loop);
+        watchdog.start();
+        watched = std::min(watched, runRound(serverClock, connections, requests));
+    }
+    fprintf(stderr, "server cpu unwatched %6.2f us/message  watched %6.2f us/message  overhead %+.2f%%\n",
+            unwatched, watched, (watched - unwatched) / unwatched * 100);
+
+    //2. 检测
+    LoopWatchdog watchdog(0.1);
+    watchdog.enableStackSampling(SIGUSR2);
+    watchdog.watch(loop);
+    watchdog.start();
+    int fd = connectServer();
+    char message[kMessageSize];
+    const int kStalls = 3;
+    for (int i = 0; i < kStalls; ++i)
+    {
+        ::memset(message, 'x', sizeof message);
+        ::memcpy(message, "stall", 5);
+        request(fd, message, sizeof message);
+        ::memset(message, 'x', sizeof message);
+        request(fd, message, sizeof message);
+    }
+    ::close(fd);
+    //等看门狗看到最后一次卡住结束
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    LoopWatchdog::Stats s = watchdog.stats(loop);
+    fprintf(stderr, "%d stalls of %d ms: detected %llu, recorded %llu, duration p50 <=%llu ms max bucket <=%llu ms\n",
+            kStalls, g_stallMs, static_cast<unsigned long long>(s.stalls),
+            static_cast<unsigned long long>(s.stallMs.total()),
+            static_cast<unsigned long long>(s.stallMs.percentile(0.5)),
+            static_cast<unsigned long long>(s.stallMs.percentile(1.0)));
+    _exit(0);
+}
@@ -0,0 +1,119 @@
+/**
+ * 跨线程queueInLoop的开销：
+ * 1. 吞吐：若干个生产者线程同时往同一个loop里post空回调，统计每秒执行多少个回调，以及平均每个post写了几次eventfd
+ * 2. 延迟：一个生产者每隔一小段时间post一个回调，统计从post到loop线程开始执行的时间p50/p99
+ * eventfd的write在这里包了一层计数，只统计生产者线程里的调用，libmymuduo.so通过PLT调用时会走到这里
+ *
+ * 用法：./bench_queue_in_loop [生产者线程数=4] [每个线程post次数=200000] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/EventLoop.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dlfcn.h>
+#include <unistd.h>
+
+static thread_local bool t_producer = false;
+static std::atomic<uint64_t> g_wakeups(0);
+
+extern "C" ssize_t write(int fd, const void *buf, size_t count)
+{
+    typedef ssize_t (*WriteFunc)(int, const void*, size_t);
+    static WriteFunc realWrite = reinterpret_cast<WriteFunc>(::dlsym(RTLD_NEXT, "write"));
+    if (t_producer)
+    {
+        g_wakeups.fetch_add(1, std::memory_order_relaxed);
+    }
+    return realWrite(fd, buf, count);
+}
+
+static double nowMicros()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char *argv[])
+{
+    int producers = argc > 1 ? atoi(argv[1]) : 4;
+    int posts = argc > 2 ? atoi(argv[2]) : 200000;
+
+    std::atomic<EventLoop*> loopPtr(nullptr);
+    std::thread consumer([&loopPtr] {
+        EventLoop loop;
+        loopPtr = &loop;
+        loop.loop();
+    });
+    consumer.detach();
+    while (loopPtr.load() == nullptr)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EventLoop *loop = loopPtr.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    //1. 吞吐
+    uint64_t executed = 0;  //只在loop线程里访问
+    std::atomic<bool> done(false);
+    const uint64_t total = static_cast<uint64_t>(producers) * posts;
+    double start = nowMicros();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p] {
+            t_producer = true;
+            for (int i = 0; i < posts; ++i)
+            {
+                loop->queueInLoop([&executed, &done, total] {
+                    if (++executed == total)
+                    {
+                        done = true;
+                    }
+                });
+            }
+        });
+    }
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    while (!done.load())
+    {
+        std::this_thread::yield();
+    }
+    double seconds = (nowMicros() - start) / 1e6;
+    fprintf(stderr, "%d producers x %d posts: %8.0f posts/s  eventfd writes %llu (%.4f/post)\n",
+            producers, posts, total / seconds, static_cast<unsigned long long>(g_wakeups.load()),
+            static_cast<double>(g_wakeups.load()) / total);
+
+    //2. 延迟
+    const int kSamples = 20000;
+    std::vector<double> latency;
+    latency.reserve(kSamples);
+    std::atomic<int> finished(0);
+    std::thread producer([&] {
+        for (int i = 0; i < kSamples; ++i)
+        {
+            double posted = nowMicros();
+            loop->queueInLoop([&latency, &finished, posted] {
+                latency.push_back(nowMicros() - posted);
+                ++finished;
+            });
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+        }
+    });
+    producer.join();
+    while (finished.load() < kSamples)
+    {
+        std::this_thread::yield();
+    }
+    std::sort(latency.begin(), latency.end());
+    fprintf(stderr, "post->run latency p50 %6.1fus  p99 %6.1fus\n",
+            latency[latency.size() / 2], latency[latency.size() * 99 / 100]);
+    _exit(0);
+}
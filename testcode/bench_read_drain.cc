@@ -0,0 +1,130 @@
+/**
+ * 大块数据接收测试：客户端往一条连接上连续写N MB，服务端每次读事件只读一次和一直读到EAGAIN各测一遍，
+ * 输出每MB数据用了多少次readv、多少次epoll_wait，以及吞吐量
+ * readv和epoll_wait在这里包了一层计数，libmymuduo.so通过PLT调用时会走到这里
+ *
+ * 用法：./bench_read_drain [MB数=512] [读预算字节数=1048576] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Logger.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static const uint16_t kPort = 9982;
+
+static std::atomic<uint64_t> g_readvCalls(0);
+static std::atomic<uint64_t> g_epollCalls(0);
+static std::atomic<uint64_t> g_received(0);
+static std::atomic<size_t> g_budget(0);
+
+extern "C" ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    typedef ssize_t (*ReadvFunc)(int, const struct iovec*, int);
+    static ReadvFunc realReadv = reinterpret_cast<ReadvFunc>(::dlsym(RTLD_NEXT, "readv"));
+    g_readvCalls.fetch_add(1, std::memory_order_relaxed);
+    return realReadv(fd, iov, iovcnt);
+}
+
+extern "C" int epoll_wait(int epfd, struct epoll_event *events, int maxevents, int timeout)
+{
+    typedef int (*EpollWaitFunc)(int, struct epoll_event*, int, int);
+    static EpollWaitFunc realEpollWait = reinterpret_cast<EpollWaitFunc>(::dlsym(RTLD_NEXT, "epoll_wait"));
+    g_epollCalls.fetch_add(1, std::memory_order_relaxed);
+    return realEpollWait(epfd, events, maxevents, timeout);
+}
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        conn->setReadDrainBudget(g_budget.load());
+    }
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    g_received.fetch_add(buf->readableBytes(), std::memory_order_relaxed);
+    buf->retrieveAll();
+}
+
+static void runOnce(const char *label, size_t budget, size_t megabytes)
+{
+    g_budget = budget;
+    g_received = 0;
+
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        fprintf(stderr, "connect failed\n");
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::string chunk(256 * 1024, 'x');
+    const uint64_t total = static_cast<uint64_t>(megabytes) << 20;
+    uint64_t readvBefore = g_readvCalls.load();
+    uint64_t epollBefore = g_epollCalls.load();
+    auto start = std::chrono::steady_clock::now();
+
+    uint64_t sent = 0;
+    while (sent < total)
+    {
+        ssize_t n = ::write(fd, chunk.data(), chunk.size());
+        if (n <= 0)
+        {
+            fprintf(stderr, "write failed\n");
+            return;
+        }
+        sent += n;
+    }
+    while (g_received.load() < total)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double readvPerMB = static_cast<double>(g_readvCalls.load() - readvBefore) / megabytes;
+    double epollPerMB = static_cast<double>(g_epollCalls.load() - epollBefore) / megabytes;
+    fprintf(stderr, "%-16s readv/MB %8.2f  epoll_wait/MB %8.2f  syscalls/MB %8.2f  %8.1f MB/s\n",
+            label, readvPerMB, epollPerMB, readvPerMB + epollPerMB, megabytes / seconds);
+    // 客户端fd不关，测完直接退出，避免测的是连接拆除的过程
+}
+
+int main(int argc, char *argv[])
+{
+    size_t megabytes = argc > 1 ? atoi(argv[1]) : 512;
+    size_t budget = argc > 2 ? atol(argv[2]) : 1024 * 1024;
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "ReadDrain");
+    server.setConnectionCallback(onConnection);
+    server.setMessageCallback(onMessage);
+    server.start();
+
+    std::thread client([&] {
+        runOnce("read once", 0, megabytes);
+        runOnce("drain to EAGAIN", budget, megabytes);
+        loop.quit();
+    });
+    loop.loop();
+    client.join();
+    return 0;
+}
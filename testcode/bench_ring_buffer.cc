@@ -0,0 +1,91 @@
+/**
+ * Buffer镜像环形内存和普通连续内存的对比：模拟一条持续收数据的连接，
+ * 每次append一段数据，解析器按固定长度的帧取走，可读数据积压到backlog以后才开始消费，
+ * 消费到一半再接着收。普通内存在writable不够时要把剩下的数据搬到前面，环形内存只移动下标
+ * 输出两种内存的吞吐量，并比较两边取走的数据校验和
+ *
+ * 用法：./bench_ring_buffer [总MB数=4096]
+ */
+#include <mymuduo/Buffer.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct Result
+{
+    double seconds;
+    uint64_t checksum;
+    size_t capacity;
+};
+
+static Result run(bool mirrored, size_t totalBytes, size_t backlog, size_t chunkSize, size_t frameSize)
+{
+    std::string chunk(chunkSize, 0);
+    for (size_t i = 0; i < chunk.size(); ++i)
+    {
+        chunk[i] = static_cast<char>(i * 131 + 7);
+    }
+
+    Buffer buf;
+    if (mirrored && !buf.setMirrored(true))
+    {
+        fprintf(stderr, "setMirrored failed\n");
+    }
+
+    uint64_t checksum = 0;
+    size_t appended = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (appended < totalBytes)
+    {
+        buf.append(chunk.data(), chunk.size());
+        appended += chunk.size();
+        if (buf.readableBytes() < backlog)
+        {
+            continue;
+        }
+        // 解析器一次处理一批完整的帧，剩下不完整的留着
+        while (buf.readableBytes() >= backlog / 2 + frameSize)
+        {
+            const char *frame = buf.peek();
+            checksum = checksum * 31 + static_cast<unsigned char>(frame[0]) + static_cast<unsigned char>(frame[frameSize - 1]);
+            buf.retrieve(frameSize);
+        }
+    }
+    Result r;
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    r.checksum = checksum;
+    r.capacity = buf.internalCapacity();
+    return r;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t totalBytes = static_cast<size_t>(argc > 1 ? atoi(argv[1]) : 4096) << 20;
+
+    struct Case
+    {
+        const char *name;
+        size_t backlog;
+        size_t chunkSize;
+        size_t frameSize;
+    };
+    const Case cases[] = {
+        { "small backlog 8K, 4K reads, 1500B frames", 8 * 1024, 4096, 1500 },
+        { "backlog 64K, 16K reads, 1500B frames", 64 * 1024, 16 * 1024, 1500 },
+        { "backlog 1M, 64K reads, 4000B frames", 1024 * 1024, 64 * 1024, 4000 },
+    };
+
+    for (const Case &c : cases)
+    {
+        Result vec = run(false, totalBytes, c.backlog, c.chunkSize, c.frameSize);
+        Result ring = run(true, totalBytes, c.backlog, c.chunkSize, c.frameSize);
+        printf("%s\n", c.name);
+        printf("  vector   %8.2f GB/s  capacity %8zu\n", totalBytes / vec.seconds / 1e9, vec.capacity);
+        printf("  mirrored %8.2f GB/s  capacity %8zu  %s\n", totalBytes / ring.seconds / 1e9, ring.capacity,
+               vec.checksum == ring.checksum ? "checksum ok" : "CHECKSUM MISMATCH");
+    }
+    return 0;
+}
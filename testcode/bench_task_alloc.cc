@@ -0,0 +1,222 @@
+/**
+ * 跨线程投递回调和跨线程send时的内存分配次数：替换全局operator new计数(所有线程)，
+ * 主线程往另一个loop线程里投递，统计平均每次投递/每次send一共分配了几次内存
+ * 1. queueInLoop(bind(成员函数, shared_ptr, int))
+ * 2. send(PayloadPtr)
+ * 3. send(std::string&&)，消息本身提前构造好，不算在里面
+ * 4. send(const std::string&)，要拷贝一份消息，至少一次
+ *
+ * 用法：./bench_task_alloc [每项次数=100000] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static const uint16_t kPort = 9985;
+
+static std::atomic<uint64_t> g_allocs(0);
+
+/**
+ * 普通和数组、抛异常和nothrow的new/delete全部换成计数的malloc/free，
+ * 不管库里用的是哪个版本，分配和释放都配对在malloc/free上
+ * delete不让内联：内联以后GCC看到operator new的返回值交给free，会报-Wmismatched-new-delete
+ */
+static void* countedAlloc(size_t size)
+{
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    return ::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(size_t size)
+{
+    void *p = countedAlloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    void *p = countedAlloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return countedAlloc(size);
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+    ::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p) noexcept
+{
+    ::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept
+{
+    ::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, size_t) noexcept
+{
+    ::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, const std::nothrow_t&) noexcept
+{
+    ::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void *p, const std::nothrow_t&) noexcept
+{
+    ::free(p);
+}
+
+struct Counter
+{
+    uint64_t sum = 0;
+    void add(int n) { sum += n; }
+};
+
+static std::atomic<TcpConnectionPtr*> g_conn(nullptr);
+
+static void onConnection(const TcpConnectionPtr &conn)
+{
+    if (conn->connected())
+    {
+        g_conn = new TcpConnectionPtr(conn);
+    }
+}
+
+static void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp)
+{
+    buf->retrieveAll();
+}
+
+//等loop把之前投递的都执行完
+static void drain(EventLoop *loop)
+{
+    std::atomic<bool> done(false);
+    loop->queueInLoop([&done] { done = true; });
+    while (!done.load())
+    {
+        std::this_thread::yield();
+    }
+}
+
+template <typename Func>
+static void measure(const char *label, EventLoop *loop, int count, Func post)
+{
+    //先跑一轮预热，让节点缓存、Buffer内存池都准备好
+    for (int i = 0; i < count; ++i)
+    {
+        post(i);
+    }
+    drain(loop);
+    uint64_t before = g_allocs.load();
+    for (int i = 0; i < count; ++i)
+    {
+        post(i);
+    }
+    drain(loop);
+    fprintf(stderr, "%-32s %6.3f allocations/op\n", label, static_cast<double>(g_allocs.load() - before) / count);
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 100000;
+
+    std::atomic<EventLoop*> loopPtr(nullptr);
+    std::thread server([&loopPtr] {
+        EventLoop loop;
+        TcpServer tcpServer(&loop, InetAddress(kPort), "TaskAlloc");
+        tcpServer.setConnectionCallback(onConnection);
+        tcpServer.setMessageCallback(onMessage);
+        tcpServer.start();
+        loopPtr = &loop;
+        loop.loop();
+    });
+    server.detach();
+    while (loopPtr.load() == nullptr)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EventLoop *loop = loopPtr.load();
+
+    //客户端只管把收到的数据读掉，服务端的send每次都能直接写完
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof addr) < 0)
+    {
+        fprintf(stderr, "connect failed\n");
+        return 1;
+    }
+    std::thread reader([fd] {
+        char buf[65536];
+        while (::read(fd, buf, sizeof buf) > 0)
+        {
+        }
+    });
+    reader.detach();
+    while (g_conn.load() == nullptr)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    TcpConnectionPtr conn = *g_conn.load();
+
+    std::shared_ptr<Counter> counter(new Counter);
+    measure("queueInLoop(bind(shared_ptr))", loop, count, [&](int i) {
+        loop->queueInLoop(std::bind(&Counter::add, counter, i));
+    });
+
+    PayloadPtr payload = Payload::create(std::string(100, 'p'));
+    measure("send(PayloadPtr)", loop, count, [&](int) {
+        conn->send(payload);
+    });
+
+    //预热和计数两轮各用一批
+    std::vector<std::string> messages(2 * count, std::string(100, 'm'));
+    size_t next = 0;
+    measure("send(std::string&&)", loop, count, [&](int) {
+        conn->send(std::move(messages[next++]));
+    });
+
+    std::string message(100, 'c');
+    measure("send(const std::string&)", loop, count, [&](int) {
+        conn->send(message);
+    });
+    _exit(0);
+}
@@ -0,0 +1,94 @@
+/**
+ * 定时器队列的开销：loop线程里先挂上N个还没到期的定时器(默认100万)，统计每个runAfter、cancel的平均耗时，
+ * 再挂N个很快到期的定时器，统计每个到期回调的平均开销，最后从另一个线程runAfter，统计跨线程添加的耗时
+ * 以及短定时器的实际触发误差
+ *
+ * 用法：./bench_timer_queue [定时器个数=1000000] > /dev/null
+ * 结果输出到stderr，库本身的日志在stdout
+ */
+#include <mymuduo/EventLoop.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static double nowSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    EventLoop loop;
+    int fired = 0;
+
+    //1. 挂上count个1小时以后才到期的定时器，到期时间打散，插入不总是在堆尾
+    std::vector<TimerId> ids;
+    ids.reserve(count);
+    srand(1);
+    double start = nowSeconds();
+    for (int i = 0; i < count; ++i)
+    {
+        ids.push_back(loop.runAfter(3600.0 + rand() % 3600, [&fired] { ++fired; }));
+    }
+    double addSeconds = nowSeconds() - start;
+
+    //2. 全部取消，顺序也打散
+    std::random_shuffle(ids.begin(), ids.end());
+    start = nowSeconds();
+    for (const TimerId &id : ids)
+    {
+        loop.cancel(id);
+    }
+    double cancelSeconds = nowSeconds() - start;
+
+    //3. count个定时器在接下来的1秒内陆续到期，统计从第一个到期到全部执行完loop线程花的时间
+    for (int i = 0; i < count; ++i)
+    {
+        loop.runAfter(0.5 + (rand() % 500000) / 1e6, [&fired] { ++fired; });
+    }
+    loop.runAfter(1.1, [&loop] { loop.quit(); });
+    start = nowSeconds();
+    loop.loop();
+    double loopSeconds = nowSeconds() - start;
+
+    fprintf(stderr, "%d timers: runAfter %6.3f us  cancel %6.3f us  fired %d in %.3fs (expected ~1.1s)\n",
+            count, addSeconds / count * 1e6, cancelSeconds / count * 1e6, fired, loopSeconds);
+
+    //4. 另一个线程添加1ms的定时器，统计跨线程添加的耗时和触发误差
+    const int kRemote = 1000;
+    std::vector<double> lateness;
+    //回调里不要再做大块的malloc：上面释放掉的100万个Timer还在glibc的fastbin里，
+    //第一次大块malloc会把它们整理一遍，loop线程要停几百毫秒，测出来的就不是定时器本身的误差了
+    lateness.reserve(kRemote);
+    std::atomic<int> remaining(kRemote);
+    double remoteAdd = 0;
+    std::thread producer([&] {
+        for (int i = 0; i < kRemote; ++i)
+        {
+            double scheduled = nowSeconds();
+            loop.runAfter(0.001, [&lateness, &remaining, &loop, scheduled] {
+                lateness.push_back((nowSeconds() - scheduled - 0.001) * 1e6);
+                if (--remaining == 0)
+                {
+                    loop.quit();
+                }
+            });
+            remoteAdd += nowSeconds() - scheduled;
+            usleep(500);
+        }
+    });
+    loop.loop();
+    producer.join();
+    std::sort(lateness.begin(), lateness.end());
+    fprintf(stderr, "cross-thread runAfter %6.3f us  1ms timer late by p50 %.0fus p99 %.0fus\n",
+            remoteAdd / kRemote * 1e6, lateness[lateness.size() / 2], lateness[lateness.size() * 99 / 100]);
+    _exit(0);
+}
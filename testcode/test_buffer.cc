@@ -0,0 +1,172 @@
+/**
+ * Buffer的正确性测试，失败时返回非0
+ * 分段模式：读数据(peek/peekBytes/peekInt/retrieveAsString/find)不会合并数据块，跨块的数据也能读对；
+ * readFd在尾部数据块还有空间时先填满它，放不下的部分追加成新数据块，数据顺序不乱；
+ * 拷贝/移动以后数据不变；用内存池的Buffer在别的线程里接着写、在内存池析构以后析构都不出错
+ *
+ * 用法：./test_buffer > /dev/null
+ */
+#include <mymuduo/Buffer.h>
+#include <mymuduo/BufferPool.h>
+
+#include "test_check.h"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+//第i个字节是i % 251，错位一个字节都能发现
+static std::string pattern(size_t len, size_t start = 0)
+{
+    std::string s(len, '\0');
+    for (size_t i = 0; i < len; ++i)
+    {
+        s[i] = static_cast<char>((start + i) % 251);
+    }
+    return s;
+}
+
+static void testChainedReadersDoNotLinearize()
+{
+    Buffer buf;
+    buf.setChained(true);
+    const size_t total = 3 * Buffer::kBlockSize + 100;
+    std::string data = pattern(total);
+    buf.append(data.data(), data.size());
+    CHECK_EQ(buf.readableBytes(), total);
+
+    const size_t capacity = buf.internalCapacity();
+    const size_t first = buf.contiguousBytes();
+    CHECK(first < total);
+    CHECK_EQ(::memcmp(buf.peek(), data.data(), first), 0);
+
+    //跨过第一段末尾的读取
+    char bytes[16];
+    buf.peekBytes(bytes, sizeof bytes, first - 8);
+    CHECK_EQ(::memcmp(bytes, data.data() + first - 8, sizeof bytes), 0);
+    (void)buf.peekInt64();
+    CHECK(buf.findCRLF() == nullptr || buf.findCRLF() < buf.peek() + first);
+    //读都不应该改变内部布局
+    CHECK_EQ(buf.internalCapacity(), capacity);
+    CHECK_EQ(buf.contiguousBytes(), first);
+
+    //取走到第一段末尾前4个字节，这时的int32跨两段
+    buf.retrieve(first - 4);
+    int32_t be32 = 0;
+    ::memcpy(&be32, data.data() + first - 4, sizeof be32);
+    CHECK_EQ(buf.peekInt32(), static_cast<int32_t>(be32toh(be32)));
+    CHECK_EQ(buf.internalCapacity(), capacity);
+
+    //跨好几个数据块的retrieveAsString
+    std::string s = buf.retrieveAsString(2 * Buffer::kBlockSize);
+    CHECK(s == data.substr(first - 4, 2 * Buffer::kBlockSize));
+    CHECK_EQ(buf.readableBytes(), total - (first - 4) - 2 * Buffer::kBlockSize);
+
+    //显式合并以后是连续的
+    size_t rest = buf.readableBytes();
+    buf.linearize();
+    CHECK_EQ(buf.contiguousBytes(), rest);
+    CHECK_EQ(::memcmp(buf.peek(), data.data() + total - rest, rest), 0);
+}
+
+static void testChainedReadFd()
+{
+    int fds[2];
+    CHECK_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    int sndbuf = 1 << 20;
+    ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf);
+
+    Buffer buf;
+    buf.setChained(true);
+    std::string expected;
+    size_t written = 0;
+    //每次写的量和64K对不齐，尾部数据块每次剩下的空间都不一样
+    const size_t sizes[] = {100, 70000, 5000, 65536, 130000, 1, 64 * 1024 - 1};
+    for (size_t len : sizes)
+    {
+        std::string chunk = pattern(len, written);
+        written += len;
+        expected += chunk;
+        CHECK_EQ(::write(fds[0], chunk.data(), chunk.size()), static_cast<ssize_t>(chunk.size()));
+        size_t got = 0;
+        while (got < len)
+        {
+            int savedErrno = 0;
+            ssize_t n = buf.readFd(fds[1], &savedErrno);
+            CHECK(n > 0);
+            got += n;
+        }
+    }
+    CHECK_EQ(buf.readableBytes(), expected.size());
+    CHECK(buf.retrieveAllAsString() == expected);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+static void testCopyAndMove()
+{
+    Buffer buf;
+    buf.setChained(true);
+    std::string data = pattern(2 * Buffer::kBlockSize + 10);
+    buf.append(data.data(), data.size());
+    buf.retrieve(3);
+
+    Buffer copy(buf);
+    CHECK(copy.chained());
+    CHECK(copy.retrieveAllAsString() == data.substr(3));
+    CHECK_EQ(buf.readableBytes(), data.size() - 3);
+
+    Buffer moved(std::move(buf));
+    CHECK_EQ(buf.readableBytes(), 0u);
+    CHECK_EQ(buf.internalCapacity(), 0u);
+    buf.append("abc", 3); //移走以后还能接着用
+    CHECK(buf.retrieveAllAsString() == "abc");
+
+    Buffer assigned;
+    assigned = moved;
+    CHECK(assigned.retrieveAllAsString() == data.substr(3));
+    assigned = std::move(moved);
+    CHECK(assigned.retrieveAllAsString() == data.substr(3));
+}
+
+static void testPoolOffThread()
+{
+    std::shared_ptr<BufferPool> pool(new BufferPool());
+    std::unique_ptr<Buffer> buf(new Buffer(Buffer::kInitialSize, pool));
+    buf->setChained(true);
+    std::string data = pattern(Buffer::kBlockSize + 500);
+    buf->append(data.data(), data.size());
+    CHECK(pool->stats().classes[BufferPool::kNumClasses - 1].inUse > 0); //64K的数据块是从内存池拿的
+
+    //不是内存池的线程：换成malloc的内存以后继续写，数据不变
+    std::thread t([&buf, &data] {
+        std::string more = pattern(3 * Buffer::kBlockSize, data.size());
+        buf->append(more.data(), more.size());
+        buf->appendInt32(7);
+    });
+    t.join();
+    std::string all = data + pattern(3 * Buffer::kBlockSize, data.size());
+    CHECK(buf->retrieveAsString(all.size()) == all);
+    CHECK_EQ(buf->readInt32(), 7);
+
+    //内存池的拥有者放手以后，Buffer还持有它
+    Buffer late(Buffer::kInitialSize, pool);
+    late.append(data.data(), data.size());
+    pool.reset();
+    CHECK(late.retrieveAllAsString() == data);
+}
+
+int main()
+{
+    testChainedReadersDoNotLinearize();
+    testChainedReadFd();
+    testCopyAndMove();
+    testPoolOffThread();
+    fprintf(stderr, "test_buffer passed\n");
+    return 0;
+}
@@ -0,0 +1,108 @@
+/**
+ * 分段模式的outputBuffer_数据块超过IOV_MAX时，后面排队的文件不能插到缓冲区数据前面，失败时返回非0
+ * 一次writev最多只收集IOV_MAX段，收集到的都写完了不代表outputBuffer_空了；
+ * 排队以后把服务端的发送缓冲区调得足够大，让一次writev能把收集到的段全写完，
+ * 这时outputBuffer_里剩下的数据必须先发，然后才是文件和后面的数据
+ * 调大发送缓冲区要用SO_SNDBUFFORCE(需要CAP_NET_ADMIN)，设不了的时候跳过
+ *
+ * 用法：./test_chained_send_file > /dev/null
+ */
+#include <mymuduo/TcpConnection.h>
+
+#include "test_net.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const uint16_t kBasePort = 9955;
+//发不出去的部分要超过IOV_MAX个64K的数据块
+static const size_t kHeadSize = 80 * 1024 * 1024;
+static const size_t kFileSize = 256 * 1024;
+
+//同一个进程里的连接：按两端的地址找服务端这一侧的fd
+static int findSocket(const InetAddress &local, const InetAddress &peer)
+{
+    for (int fd = 3; fd < 1024; ++fd)
+    {
+        sockaddr_in l, p;
+        socklen_t llen = sizeof l, plen = sizeof p;
+        if (::getsockname(fd, (sockaddr*)&l, &llen) == 0 && ::getpeername(fd, (sockaddr*)&p, &plen) == 0
+            && l.sin_family == AF_INET && l.sin_port == local.getSockAddr()->sin_port
+            && p.sin_port == peer.getSockAddr()->sin_port)
+        {
+            return fd;
+        }
+    }
+    return -1;
+}
+
+//返回false表示设不了SO_SNDBUFFORCE，跳过了
+static bool runCase(uint16_t port, bool edgeTriggered)
+{
+    char path[] = "/tmp/test_chained_send_file.XXXXXX";
+    int fileFd = ::mkstemp(path);
+    CHECK(fileFd >= 0);
+    ::unlink(path);
+    const std::string file = pattern(kFileSize, 7);
+    writeAll(fileFd, file);
+
+    const std::string head = pattern(kHeadSize);
+    const std::string tail = pattern(5000, 3);
+    std::atomic<size_t> buffered(0);
+    std::atomic<int> forced(-1);
+
+    TestServer server(port, [&](TcpServer &s) {
+        s.setEdgeTriggered(edgeTriggered);
+        s.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+            if (!conn->connected())
+            {
+                return;
+            }
+            //客户端先不读，head大部分进outputBuffer_，文件和tail排在后面
+            conn->outputBuffer()->setChained(true);
+            conn->send(head);
+            conn->sendFile(fileFd, 0, kFileSize);
+            ::close(fileFd);
+            conn->send(tail);
+            conn->shutdown();
+            buffered = conn->outputBuffer()->readableBytes();
+            //下一次EPOLLOUT时，一次writev就能写完收集到的IOV_MAX段
+            int sndbuf = 256 * 1024 * 1024;
+            int fd = findSocket(conn->localAddress(), conn->peerAddress());
+            forced = (fd >= 0 && ::setsockopt(fd, SOL_SOCKET, SO_SNDBUFFORCE, &sndbuf, sizeof sndbuf) == 0) ? 1 : 0;
+        });
+    });
+
+    int fd = connectTo(port, 64 * 1024);
+    CHECK(waitFor([&forced] { return forced.load() >= 0; }));
+    if (forced.load() == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    CHECK(buffered.load() > static_cast<size_t>(IOV_MAX) * Buffer::kBlockSize);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::string received = readToEnd(fd);
+    ::close(fd);
+
+    CHECK_EQ(received.size(), kHeadSize + kFileSize + tail.size());
+    CHECK(received.compare(0, kHeadSize, head) == 0);
+    CHECK(received.compare(kHeadSize, kFileSize, file) == 0);
+    CHECK(received.compare(kHeadSize + kFileSize, tail.size(), tail) == 0);
+    return true;
+}
+
+int main()
+{
+    //边沿触发时收集到的段写完了还要接着写，不能等一个不会再来的EPOLLOUT
+    if (!runCase(kBasePort, false) || !runCase(kBasePort + 1, true))
+    {
+        fprintf(stderr, "test_chained_send_file skipped: SO_SNDBUFFORCE not permitted\n");
+        return 0;
+    }
+    fprintf(stderr, "test_chained_send_file passed\n");
+    return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+/**
+ * testcode/test_*.cc共用的断言：条件不成立时打印位置和表达式，返回非0退出，ctest据此判断失败
+ * 不用assert，Release编译(-DNDEBUG)下也要生效
+ */
+#include <stdio.h>
+#include <unistd.h>
+
+#define CHECK(cond) \
+    do \
+    { \
+        if (!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            _exit(1); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) CHECK((a) == (b))
@@ -0,0 +1,184 @@
+/**
+ * LengthHeaderCodec和Buffer整数读写的正确性测试，失败时返回非0
+ * appendInt/peekInt/prependInt按网络字节序(大端)读写；
+ * 长度头和消息体被拆成好几次发过来、一次发过来好几帧，都按帧切对；
+ * 长度超过maxFrameSize的帧不回调，服务端关闭连接
+ *
+ * 用法：./test_length_codec > /dev/null
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/LengthHeaderCodec.h>
+
+#include "test_check.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static const uint16_t kPort = 9950;
+static const size_t kMaxFrameSize = 1024;
+
+static void testIntByteOrder()
+{
+    Buffer buf;
+    buf.appendInt32(0x01020304);
+    buf.appendInt16(0x0506);
+    buf.appendInt64(0x0708090a0b0c0d0eLL);
+    buf.appendInt8(0x0f);
+    const unsigned char expected[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    CHECK_EQ(buf.readableBytes(), sizeof expected);
+    CHECK_EQ(::memcmp(buf.peek(), expected, sizeof expected), 0);
+
+    CHECK_EQ(buf.peekInt32(), 0x01020304);
+    CHECK_EQ(buf.readableBytes(), sizeof expected); //peek不取走
+    CHECK_EQ(buf.readInt32(), 0x01020304);
+    CHECK_EQ(buf.readInt16(), 0x0506);
+    CHECK_EQ(buf.readInt64(), 0x0708090a0b0c0d0eLL);
+    CHECK_EQ(buf.readInt8(), 0x0f);
+    CHECK_EQ(buf.readableBytes(), 0u);
+
+    //先写消息体再在前面补长度头
+    buf.append("body", 4);
+    buf.prependInt32(4);
+    const unsigned char header[] = {0, 0, 0, 4};
+    CHECK_EQ(::memcmp(buf.peek(), header, sizeof header), 0);
+    CHECK_EQ(buf.readInt32(), 4);
+    CHECK(buf.retrieveAllAsString() == "body");
+
+    //负数按补码原样往返
+    buf.appendInt32(-2);
+    CHECK_EQ(buf.peekInt32(), -2);
+    CHECK_EQ(static_cast<unsigned char>(*buf.peek()), 0xffu);
+}
+
+static int connectServer()
+{
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    CHECK(fd >= 0);
+    CHECK_EQ(::connect(fd, (sockaddr*)&addr, sizeof addr), 0);
+    timeval tv = {5, 0}; //服务端出错时不要一直卡住
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    return fd;
+}
+
+static void writeAll(int fd, const std::string &data)
+{
+    CHECK_EQ(::write(fd, data.data(), data.size()), static_cast<ssize_t>(data.size()));
+}
+
+static std::string frame(const std::string &body)
+{
+    Buffer buf;
+    buf.append(body.data(), body.size());
+    buf.prependInt32(static_cast<int32_t>(body.size()));
+    return buf.retrieveAllAsString();
+}
+
+//读一个回显回来的帧，返回消息体
+static std::string readFrame(int fd)
+{
+    char header[4];
+    size_t got = 0;
+    while (got < sizeof header)
+    {
+        ssize_t n = ::read(fd, header + got, sizeof header - got);
+        CHECK(n > 0);
+        got += n;
+    }
+    Buffer buf;
+    buf.append(header, sizeof header);
+    std::string body(buf.readInt32(), '\0');
+    got = 0;
+    while (got < body.size())
+    {
+        ssize_t n = ::read(fd, &body[got], body.size() - got);
+        CHECK(n > 0);
+        got += n;
+    }
+    return body;
+}
+
+static void waitABit()
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+}
+
+static void testSplitFrames()
+{
+    int fd = connectServer();
+    std::string first = frame("hello");
+    std::string second = frame(std::string(300, 'x'));
+    std::string third = frame("");
+    //长度头拆开，消息体拆开，最后一次里带着第一帧的尾巴和后面两个完整的帧
+    writeAll(fd, first.substr(0, 2));
+    waitABit();
+    writeAll(fd, first.substr(2, 4));
+    waitABit();
+    writeAll(fd, first.substr(6) + second + third);
+    CHECK(readFrame(fd) == "hello");
+    CHECK(readFrame(fd) == std::string(300, 'x'));
+    CHECK(readFrame(fd) == "");
+    ::close(fd);
+}
+
+static void testMaxFrameSize(const std::atomic<int> *frames)
+{
+    int before = frames->load();
+    int fd = connectServer();
+    std::string oversized = frame(std::string(kMaxFrameSize + 1, 'y'));
+    writeAll(fd, oversized);
+    char c;
+    CHECK_EQ(::read(fd, &c, 1), 0); //服务端丢掉数据并关闭连接
+    CHECK_EQ(frames->load(), before);
+    ::close(fd);
+}
+
+int main()
+{
+    testIntByteOrder();
+
+    std::atomic<EventLoop*> loopPtr(nullptr);
+    std::atomic<int> frames(0);
+    std::thread server([&loopPtr, &frames] {
+        EventLoop loop;
+        TcpServer tcpServer(&loop, InetAddress(kPort), "codec");
+        LengthHeaderCodec *codecPtr = nullptr;
+        LengthHeaderCodec codec([&codecPtr, &frames](const TcpConnectionPtr &conn, const Slice &message, Timestamp) {
+            frames.fetch_add(1);
+            codecPtr->send(conn, message.data, message.len);
+        }, kMaxFrameSize);
+        codecPtr = &codec;
+        tcpServer.setConnectionCallback([](const TcpConnectionPtr&) {});
+        tcpServer.setMessageCallback(std::bind(&LengthHeaderCodec::onMessage, &codec,
+            std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        tcpServer.start();
+        loopPtr = &loop;
+        loop.loop();
+    });
+    while (loopPtr.load() == nullptr)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    testSplitFrames();
+    CHECK_EQ(frames.load(), 3);
+    testMaxFrameSize(&frames);
+
+    loopPtr.load()->quit();
+    server.join();
+    fprintf(stderr, "test_length_codec passed\n");
+    return 0;
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+/**
+ * testcode/test_*.cc里需要真实连接的测试共用：服务端在单独的线程里跑EventLoop+TcpServer，
+ * 客户端用阻塞socket读写，读超时5秒，服务端没按预期发数据时测试失败退出，不会一直卡住
+ */
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoop.h>
+
+#include "test_check.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+//第i个字节是(start + i) % 251，错位一个字节都能发现
+inline std::string pattern(size_t len, size_t start = 0)
+{
+    std::string s(len, '\0');
+    for (size_t i = 0; i < len; ++i)
+    {
+        s[i] = static_cast<char>((start + i) % 251);
+    }
+    return s;
+}
+
+/**
+ * 构造时在新线程里建EventLoop和TcpServer，默认的连接回调什么都不做、消息回调丢掉数据，
+ * setup里再按测试需要设置，之后start并开始loop；析构时让loop退出并等线程结束
+ */
+class TestServer
+{
+public:
+    TestServer(uint16_t port, const std::function<void(TcpServer&)> &setup)
+        :loop_(nullptr)
+    {
+        thread_ = std::thread([this, port, setup] {
+            EventLoop loop;
+            TcpServer server(&loop, InetAddress(port), "test");
+            server.setConnectionCallback([](const TcpConnectionPtr&) {});
+            server.setMessageCallback([](const TcpConnectionPtr&, Buffer *buf, Timestamp) { buf->retrieveAll(); });
+            setup(server);
+            server.start();
+            loop_ = &loop;
+            loop.loop();
+        });
+        while (loop_.load() == nullptr)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    ~TestServer()
+    {
+        loop_.load()->quit();
+        thread_.join();
+    }
+
+    EventLoop* loop() const { return loop_.load(); }
+
+private:
+    std::atomic<EventLoop*> loop_;
+    std::thread thread_;
+};
+
+//rcvbuf大于0时在connect之前把接收缓冲区调小，服务端更容易写不完、要排队
+inline int connectTo(uint16_t port, int rcvbuf = 0)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    CHECK(fd >= 0);
+    if (rcvbuf > 0)
+    {
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+    }
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    CHECK_EQ(::connect(fd, (sockaddr*)&addr, sizeof addr), 0);
+    timeval tv = {5, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    return fd;
+}
+
+inline void writeAll(int fd, const std::string &data)
+{
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        ssize_t n = ::write(fd, data.data() + sent, data.size() - sent);
+        CHECK(n > 0);
+        sent += n;
+    }
+}
+
+inline std::string readExactly(int fd, size_t len)
+{
+    std::string data(len, '\0');
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = ::read(fd, &data[got], len - got);
+        CHECK(n > 0);
+        got += n;
+    }
+    return data;
+}
+
+//一直读到对端关闭
+inline std::string readToEnd(int fd)
+{
+    std::string data;
+    char buf[65536];
+    while (true)
+    {
+        ssize_t n = ::read(fd, buf, sizeof buf);
+        CHECK(n >= 0);
+        if (n == 0)
+        {
+            return data;
+        }
+        data.append(buf, n);
+    }
+}
+
+//等cond成立，最多等timeoutMs毫秒，返回最后一次的结果
+inline bool waitFor(const std::function<bool()> &cond, int timeoutMs = 5000)
+{
+    for (int waited = 0; waited < timeoutMs && !cond(); waited += 10)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return cond();
+}
@@ -0,0 +1,53 @@
+/**
+ * Payload共享消息引用计数的正确性测试，失败时返回非0
+ * 同一个Payload发给两个连接，发送方自己放掉引用以后，排队中的连接还持有它；
+ * 一个连接读完全部数据、另一个连接不读直接断开，两种情况下连接都会放掉引用，最后Payload被释放；
+ * 读到的数据和Payload内容一致
+ *
+ * 用法：./test_payload > /dev/null
+ */
+#include <mymuduo/TcpConnection.h>
+#include <mymuduo/Payload.h>
+
+#include "test_net.h"
+
+#include <memory>
+#include <stdio.h>
+#include <unistd.h>
+
+static const uint16_t kPort = 9953;
+static const size_t kPayloadSize = 8 * 1024 * 1024;
+
+int main()
+{
+    const std::string data = pattern(kPayloadSize);
+    PayloadPtr payload = Payload::create(std::string(data));
+    std::weak_ptr<const Payload> weak(payload);
+    std::atomic<int> sends(0);
+
+    TestServer server(kPort, [&](TcpServer &s) {
+        s.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+            if (conn->connected())
+            {
+                conn->send(payload);
+                sends.fetch_add(1);
+            }
+        });
+    });
+
+    //两个客户端都先不读，8M写不完，连接只能排队持有引用
+    int reader = connectTo(kPort, 64 * 1024);
+    int quitter = connectTo(kPort, 64 * 1024);
+    CHECK(waitFor([&sends] { return sends.load() == 2; }));
+    payload.reset();
+    CHECK(!weak.expired());
+
+    ::close(quitter); //不读就断开，排队的引用随连接一起释放
+    std::string received = readExactly(reader, kPayloadSize);
+    CHECK(received == data);
+    CHECK(waitFor([&weak] { return weak.expired(); }));
+    ::close(reader);
+
+    fprintf(stderr, "test_payload passed\n");
+    return 0;
+}
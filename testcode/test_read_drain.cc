@@ -0,0 +1,51 @@
+/**
+ * 边沿触发下读写预算用完以后接着处理的正确性测试，失败时返回非0
+ * 连接是边沿触发、每次读事件预算很小，客户端一次灌进去几MB以后就不再发：
+ * 预算用完时内核里还有数据，不会再有新的边沿，必须靠排到本轮后面的resumeRead接着读完，
+ * 回显的数据要一个字节不少、顺序不乱；水平触发加同样的预算作对照
+ *
+ * 用法：./test_read_drain > /dev/null
+ */
+#include <mymuduo/TcpConnection.h>
+
+#include "test_net.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+static const uint16_t kBasePort = 9954;
+static const size_t kTotal = 4 * 1024 * 1024;
+static const size_t kBudget = 4096;
+
+static void runEcho(uint16_t port, bool edgeTriggered)
+{
+    std::atomic<int> messages(0);
+    TestServer server(port, [&](TcpServer &s) {
+        s.setEdgeTriggered(edgeTriggered);
+        s.setReadDrainBudget(kBudget);
+        s.setMessageCallback([&messages](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            messages.fetch_add(1);
+            conn->send(buf->retrieveAllAsString());
+        });
+    });
+
+    const std::string data = pattern(kTotal);
+    int fd = connectTo(port);
+    //一边写一边收回显，写完以后客户端不再发任何数据
+    std::thread writer([fd, &data] { writeAll(fd, data); });
+    std::string received = readExactly(fd, kTotal);
+    writer.join();
+    ::close(fd);
+
+    CHECK(received == data);
+    //预算比一轮readv小，每次读事件只读一轮(缓冲区可写部分加64K栈上空间)，4M肯定分成了很多次
+    CHECK(messages.load() > static_cast<int>(kTotal / (256 * 1024)));
+}
+
+int main()
+{
+    runEcho(kBasePort, true);
+    runEcho(kBasePort + 1, false);
+    fprintf(stderr, "test_read_drain passed\n");
+    return 0;
+}
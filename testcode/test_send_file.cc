@@ -0,0 +1,63 @@
+/**
+ * TcpConnection::sendFile的正确性测试，失败时返回非0
+ * 前面还有没发完的数据时，文件内容排在它们后面，后面send的数据又排在文件后面，字节顺序和调用顺序一致；
+ * 文件区间从offset开始；sendFile返回以后用户close自己的fd不影响发送；shutdown等排队的文件发完才关写端
+ *
+ * 用法：./test_send_file > /dev/null
+ */
+#include <mymuduo/TcpConnection.h>
+
+#include "test_net.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static const uint16_t kPort = 9951;
+static const size_t kHeadSize = 4 * 1024 * 1024;
+static const size_t kFileSize = 3 * 1024 * 1024;
+static const off_t kFileOffset = 1000;
+
+int main()
+{
+    char path[] = "/tmp/test_send_file.XXXXXX";
+    int fileFd = ::mkstemp(path);
+    CHECK(fileFd >= 0);
+    ::unlink(path);
+    const std::string file = pattern(kFileSize, 7);
+    writeAll(fileFd, file);
+
+    const std::string head = pattern(kHeadSize);
+    const std::string tail = pattern(5000, 3);
+    std::atomic<bool> queued(false);
+
+    TestServer server(kPort, [&](TcpServer &s) {
+        s.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+            if (!conn->connected())
+            {
+                return;
+            }
+            //客户端先不读，head写不完，后面的文件和数据都要排队
+            conn->setHighWaterMarkCallback([&queued](const TcpConnectionPtr&, size_t) { queued = true; }, 1);
+            conn->send(head);
+            conn->sendFile(fileFd, kFileOffset, kFileSize - kFileOffset);
+            conn->send(std::string("middle"));
+            conn->sendFile(fileFd, 0, 100);
+            ::close(fileFd); //sendFile内部dup过，这里关掉不影响
+            conn->send(tail);
+            conn->shutdown();
+        });
+    });
+
+    int fd = connectTo(kPort, 64 * 1024);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::string received = readToEnd(fd);
+    ::close(fd);
+
+    CHECK(queued.load());
+    std::string expected = head + file.substr(kFileOffset) + "middle" + file.substr(0, 100) + tail;
+    CHECK_EQ(received.size(), expected.size());
+    CHECK(received == expected);
+    fprintf(stderr, "test_send_file passed\n");
+    return 0;
+}
@@ -0,0 +1,55 @@
+/**
+ * 定时器在同一轮到期里被取消的正确性测试，失败时返回非0
+ * 同一时刻到期的两个定时器互相取消，只有先执行的那个跑；重复定时器在回调里取消自己只跑一次；
+ * 同一轮里被别的回调取消的重复定时器不会再放回堆里，之后再也不执行，队列最后是空的
+ *
+ * 用法：./test_timer_cancel > /dev/null
+ */
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/TimerQueue.h>
+
+#include "test_check.h"
+
+#include <stdio.h>
+
+int main()
+{
+    EventLoop loop;
+    //单独建一个队列，能在loop线程里直接看还剩几个定时器
+    TimerQueue queue(&loop);
+    Timestamp when = addTime(Timestamp::now(), 0.05);
+
+    //同一时刻到期的一次性定时器，谁先执行谁取消另一个
+    int onceRuns = 0;
+    TimerId onceA, onceB;
+    onceA = queue.addTimer([&] { ++onceRuns; queue.cancel(onceB); }, when, 0.0);
+    onceB = queue.addTimer([&] { ++onceRuns; queue.cancel(onceA); }, when, 0.0);
+
+    //同一时刻第一次到期的重复定时器，谁先执行谁取消另一个，被取消的不能重新排进堆里
+    int repeatARuns = 0, repeatBRuns = 0;
+    TimerId repeatA, repeatB;
+    repeatA = queue.addTimer([&] { ++repeatARuns; queue.cancel(repeatB); }, when, 0.01);
+    repeatB = queue.addTimer([&] { ++repeatBRuns; queue.cancel(repeatA); }, when, 0.01);
+
+    //重复定时器在自己的回调里取消自己
+    int selfRuns = 0;
+    TimerId self;
+    self = queue.addTimer([&] { ++selfRuns; queue.cancel(self); }, when, 0.01);
+
+    //等足够多个重复间隔，再检查
+    size_t remaining = 1;
+    loop.runAfter(0.3, [&] {
+        remaining = queue.size();
+        loop.quit();
+    });
+    loop.loop();
+
+    CHECK_EQ(onceRuns, 1);
+    //先执行的那个还在重复，被取消的一次都没执行
+    CHECK((repeatARuns > 1 && repeatBRuns == 0) || (repeatARuns == 0 && repeatBRuns > 1));
+    CHECK_EQ(selfRuns, 1);
+    //队列里只剩那个没被取消的重复定时器
+    CHECK_EQ(remaining, 1u);
+    fprintf(stderr, "test_timer_cancel passed\n");
+    return 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * TcpConnection::send(const std::vector<Slice>&)写不完时剩余部分的正确性测试，失败时返回非0
+ * 客户端先不读，第一次writev只写出去一部分，断点落在某一段的中间，
+ * 剩下的部分(包括超过IOV_MAX、这次没放进writev的段)按顺序进outputBuffer_，和后面send的数据一起收到时不错位不重复；
+ * 已经有数据排队时再send一组Slice，整组排在后面；其他线程调用的send(slices)也排在正确的位置
+ *
+ * 用法：./test_writev_remainder > /dev/null
+ */
+#include <mymuduo/TcpConnection.h>
+#include <mymuduo/Slice.h>
+
+#include "test_net.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static const uint16_t kPort = 9952;
+
+//把data切成长短不一的段，段数超过IOV_MAX
+static std::vector<Slice> split(const std::string &data)
+{
+    std::vector<Slice> slices;
+    size_t pos = 0;
+    for (size_t i = 0; pos < data.size(); ++i)
+    {
+        size_t len = std::min(data.size() - pos, i * 37 % 9000 + 1);
+        slices.push_back(Slice(data.data() + pos, len));
+        pos += len;
+    }
+    return slices;
+}
+
+int main()
+{
+    const std::string first = pattern(8 * 1024 * 1024);
+    const std::string second = pattern(300 * 1024, 11);
+    const std::string third = pattern(100 * 1024, 5);
+    CHECK(split(first).size() > IOV_MAX);
+
+    std::atomic<bool> queued(false);
+    std::atomic<bool> sent(false);
+    TcpConnectionPtr saved;
+    TestServer server(kPort, [&](TcpServer &s) {
+        s.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+            if (!conn->connected())
+            {
+                return;
+            }
+            conn->setHighWaterMarkCallback([&queued](const TcpConnectionPtr&, size_t) { queued = true; }, 1);
+            conn->send(split(first));
+            conn->send(std::string("after"));
+            conn->send(split(second));
+            saved = conn;
+            sent = true;
+        });
+    });
+
+    int fd = connectTo(kPort, 64 * 1024);
+    CHECK(waitFor([&sent] { return sent.load(); }));
+    //loop线程以外调用，slice先拼成一份拷贝再交给loop线程
+    saved->send(split(third));
+    saved->getLoop()->runInLoop([&saved] { saved->shutdown(); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::string received = readToEnd(fd);
+    ::close(fd);
+
+    CHECK(queued.load()); //第一次writev确实没写完
+    std::string expected = first + "after" + second + third;
+    CHECK_EQ(received.size(), expected.size());
+    CHECK(received == expected);
+    //连接在loop线程里释放
+    std::atomic<bool> released(false);
+    server.loop()->runInLoop([&saved, &released] { saved.reset(); released = true; });
+    CHECK(waitFor([&released] { return released.load(); }));
+    fprintf(stderr, "test_writev_remainder passed\n");
+    return 0;
+}